@@ -1,70 +1,162 @@
 ﻿#include "BVH.h"
 #include <iostream>
 
-// 比较函数：用于 std::sort
-bool box_compare(const Object* a, const Object* b, int axis) {
-	AABB box_a = a->get_bounding_box();
-	AABB box_b = b->get_bounding_box();
-	return box_a.min[axis] < box_b.min[axis];
+namespace {
+	struct Bin {
+		AABB box;
+		int count = 0;
+	};
+
+	inline int bin_index(float c, float lo, float scale, int bins) {
+		int b = (int)((c - lo) * scale);
+		return std::clamp(b, 0, bins - 1);
+	}
 }
 
-bool box_x_compare(const Object* a, const Object* b) { return box_compare(a, b, 0); }
-bool box_y_compare(const Object* a, const Object* b) { return box_compare(a, b, 1); }
-bool box_z_compare(const Object* a, const Object* b) { return box_compare(a, b, 2); }
+BVHNode::BVHNode(std::vector<Object*>& objects)
+	: BVHNode(objects, Settings())
+{
+}
 
-// 递归构造
-BVHNode::BVHNode(std::vector<Object*>& src_objects, size_t start, size_t end) {
-	// 1. 随机选取一个轴，或者更高级的做法是选包围盒最长的轴
-	// 这里为了简单，我们随机选一个轴，或者轮流选
-	int axis = rand() % 3;
+BVHNode::BVHNode(std::vector<Object*>& objects, const Settings& settings) {
+	if (objects.empty()) return;
 
-	// 更好的做法：计算当前这一堆物体的总包围盒，看哪个轴最长
-	// 但为了代码简洁，随机轴在简单场景下也够用了
+	// 1. 预先取出包围盒和重心 (虚函数调用只做一次)
+	std::vector<BuildRef> refs(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i) {
+		refs[i].box = objects[i]->get_bounding_box();
+		refs[i].centroid = refs[i].box.center();
+		refs[i].index = (uint32_t)i;
+	}
 
-	auto comparator = (axis == 0) ? box_x_compare :
-		(axis == 1) ? box_y_compare :
-		box_z_compare;
+	// 2. 递归构建，根节点的内容搬进 this
+	BVHNode* root = build(refs, 0, refs.size(), 0, settings, objects);
+	left = root->left;
+	right = root->right;
+	box = root->box;
+	split_axis = root->split_axis;
+	primitives = std::move(root->primitives);
+	root->left = root->right = nullptr;
+	delete root;
+
+	// 3. 调用方的数组按树的叶子顺序重排
+	std::vector<Object*> original(objects);
+	for (size_t i = 0; i < refs.size(); ++i) objects[i] = original[refs[i].index];
+}
 
-	size_t object_span = end - start;
+BVHNode::~BVHNode() {
+	delete left;
+	delete right;
+}
 
-	if (object_span == 1) {
-		// 只有一个物体，左右孩子都指向它
-		left = right = src_objects[start];
-	}
-	else if (object_span == 2) {
-		// 只有两个物体，排序后分别赋值
-		if (comparator(src_objects[start], src_objects[start + 1])) {
-			left = src_objects[start];
-			right = src_objects[start + 1];
+bool BVHNode::sah_split(std::vector<BuildRef>& refs, size_t start, size_t end, const AABB& box,
+	const AABB& centroid_box, const Settings& settings, size_t& mid, int& axis) {
+	const size_t count = end - start;
+	if (count == 1) return false;
+
+	// 1. 三个轴分别分桶，扫描求每个桶边界的 SAH 代价
+	const int bins = std::clamp(settings.bins, 2, 64);
+	float best_cost = FLT_MAX;
+	int best_axis = -1, best_split = 0;
+	Bin bin[64];
+	float right_area[64];
+	int right_count[64];
+	for (int a = 0; a < 3; ++a) {
+		float lo = centroid_box.min[a], hi = centroid_box.max[a];
+		if (hi - lo <= 0.0f) continue; // 所有重心在这个轴上重合，无法切分
+		float scale = bins / (hi - lo);
+
+		for (int b = 0; b < bins; ++b) bin[b] = Bin();
+		for (size_t i = start; i < end; ++i) {
+			Bin& target = bin[bin_index(refs[i].centroid[a], lo, scale, bins)];
+			target.count++;
+			target.box.expand(refs[i].box);
+		}
+
+		// 从右往左累积：切在桶 s 之前时，右边是 [s, bins)
+		AABB acc;
+		int acc_count = 0;
+		for (int s = bins - 1; s > 0; --s) {
+			acc.expand(bin[s].box);
+			acc_count += bin[s].count;
+			right_area[s] = acc_count ? acc.surface_area() : 0.0f;
+			right_count[s] = acc_count;
 		}
-		else {
-			left = src_objects[start + 1];
-			right = src_objects[start];
+		acc = AABB();
+		acc_count = 0;
+		for (int s = 1; s < bins; ++s) {
+			acc.expand(bin[s - 1].box);
+			acc_count += bin[s - 1].count;
+			if (acc_count == 0 || right_count[s] == 0) continue;
+			float cost = acc.surface_area() * acc_count + right_area[s] * right_count[s];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = a;
+				best_split = s;
+			}
 		}
 	}
-	else {
-		// 2. 核心：排序
-		std::sort(src_objects.begin() + start, src_objects.begin() + end, comparator);
 
-		// 3. 对半切分
-		size_t mid = start + object_span / 2;
-		left = new BVHNode(src_objects, start, mid);
-		right = new BVHNode(src_objects, mid, end);
+	// 2. 和做成叶子比较 (代价都按节点表面积归一化)
+	float area = box.surface_area();
+	float leaf_cost = count * settings.intersection_cost;
+	float split_cost = best_axis < 0 ? FLT_MAX
+		: settings.traversal_cost + (area > 0.0f ? best_cost / area : 1.0f) * settings.intersection_cost;
+	if (count <= (size_t)settings.max_leaf_size && leaf_cost <= split_cost) return false;
+
+	// 3. 切分；重心完全重合时没法按空间切，只能对半分
+	if (best_axis >= 0) {
+		float lo = centroid_box.min[best_axis];
+		float scale = bins / (centroid_box.max[best_axis] - lo);
+		auto it = std::stable_partition(refs.begin() + start, refs.begin() + end, [&](const BuildRef& ref) {
+			return bin_index(ref.centroid[best_axis], lo, scale, bins) < best_split;
+		});
+		mid = it - refs.begin();
+		axis = best_axis;
 	}
+	else {
+		mid = start + count / 2;
+		axis = box.max_extent_axis();
+	}
+	return true;
+}
 
-	// 4. 计算当前节点的总包围盒
-	AABB box_left = left->get_bounding_box();
-	AABB box_right = right->get_bounding_box();
-
-	box = AABB(); // 初始化空盒子
-	box.expand(box_left);
-	box.expand(box_right);
+bool BVHNode::median_split(std::vector<BuildRef>& refs, size_t start, size_t end, const AABB& centroid_box,
+	const Settings& settings, size_t& mid, int& axis) {
+	const size_t count = end - start;
+	if (count <= (size_t)std::max(settings.max_leaf_size, 1)) return false;
+
+	axis = centroid_box.max_extent_axis();
+	mid = start + count / 2;
+	std::nth_element(refs.begin() + start, refs.begin() + mid, refs.begin() + end, [&](const BuildRef& a, const BuildRef& b) {
+		return a.centroid[axis] < b.centroid[axis];
+	});
+	return true;
 }
 
-// 根构造函数
-BVHNode::BVHNode(std::vector<Object*>& objects)
-	: BVHNode(objects, 0, objects.size())
-{
+// 递归构建 [start, end)
+BVHNode* BVHNode::build(std::vector<BuildRef>& refs, size_t start, size_t end, int depth, const Settings& settings,
+	const std::vector<Object*>& objects) {
+	BVHNode* node = new BVHNode();
+	AABB centroid_box;
+	for (size_t i = start; i < end; ++i) {
+		node->box.expand(refs[i].box);
+		centroid_box.expand(refs[i].centroid);
+	}
+
+	size_t mid;
+	const bool split = depth_limited(depth, end - start)
+		? median_split(refs, start, end, centroid_box, settings, mid, node->split_axis)
+		: sah_split(refs, start, end, node->box, centroid_box, settings, mid, node->split_axis);
+	if (!split) {
+		node->primitives.reserve(end - start);
+		for (size_t i = start; i < end; ++i) node->primitives.push_back(objects[refs[i].index]);
+		return node;
+	}
+
+	node->left = build(refs, start, mid, depth + 1, settings, objects);
+	node->right = build(refs, mid, end, depth + 1, settings, objects);
+	return node;
 }
 
 // 核心求交逻辑
@@ -73,14 +165,21 @@ bool BVHNode::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) co
 	if (!box.intersect(r, tmin, tmax))
 		return false;
 
-	// 2. 如果击中了大盒子，递归检查左右孩子
-	bool hit_left = left->intersect(r, tmin, tmax, rec);
+	// 2. 叶子：逐个图元求交，每次击中都把 tmax 收紧到更近的交点
+	if (is_leaf()) {
+		bool hit = false;
+		for (const Object* obj : primitives) {
+			if (obj->intersect(r, tmin, tmax, rec)) {
+				hit = true;
+				tmax = rec.t;
+			}
+		}
+		return hit;
+	}
 
-	// 注意：如果左边击中了，tmax 应该更新为 rec.t，这样右边只需要找更近的交点
-	// 这里的逻辑稍微有点 trick，为了代码简单，我们传递原始 tmax 或更新后的
+	// 3. 内部节点：左边击中后，右边只需要找更近的交点
+	bool hit_left = left->intersect(r, tmin, tmax, rec);
 	float t_for_right = hit_left ? rec.t : tmax;
-
-	// 这里的 rec 引用会被传递下去。如果右边也击中且更近，rec 会被右边覆盖
 	bool hit_right = right->intersect(r, tmin, t_for_right, rec);
 
 	return hit_left || hit_right;
@@ -88,4 +187,24 @@ bool BVHNode::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) co
 
 AABB BVHNode::get_bounding_box() const {
 	return box;
-}
\ No newline at end of file
+}
+
+// 每个节点按表面积加权：内部节点 A * traversal_cost，叶子 A * N * intersection_cost
+float BVHNode::sah_sum(const Settings& settings) const {
+	float area = box.surface_area();
+	if (is_leaf()) return area * primitives.size() * settings.intersection_cost;
+	return area * settings.traversal_cost + left->sah_sum(settings) + right->sah_sum(settings);
+}
+
+float BVHNode::sah_cost(const Settings& settings) const {
+	float area = box.surface_area();
+	return area > 0.0f ? sah_sum(settings) / area : 0.0f;
+}
+
+float BVHNode::sah_cost() const {
+	return sah_cost(Settings());
+}
+
+size_t BVHNode::node_count() const {
+	return is_leaf() ? 1 : 1 + left->node_count() + right->node_count();
+}
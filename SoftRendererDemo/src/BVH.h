@@ -1,20 +1,79 @@
 ﻿#pragma once
 #include "Object.h"
+#include <cstdint>
 #include <vector>
 #include <algorithm>
+#include <bit>
 
+// ========================================================================
+// BVH (分箱 SAH 构建)
+// ========================================================================
+// 每个节点在三个轴上把图元重心分进若干个桶，按表面积启发式 (SAH) 评估桶边界处的切分：
+//   cost = traversal_cost + (A_left * N_left + A_right * N_right) / A_node * intersection_cost
+// 取代价最低的轴和位置；当直接做叶子 (N * intersection_cost) 更便宜且图元数不超过 max_leaf_size 时停止。
+// 构建过程不使用随机数，同样的输入得到同样的树。
+// 树深不超过 MAX_DEPTH：SAH 切得太偏、再切下去可能超限的子树改为按图元数对半切分 (见 depth_limited)。
 class BVHNode : public Object {
 public:
-	// 构建函数：传入一堆物体，构建出一棵树
+	struct Settings {
+		int bins = 16;                  // 每个轴的桶数
+		int max_leaf_size = 4;          // 叶子最多放几个图元
+		float traversal_cost = 1.0f;    // 访问一个节点的相对代价
+		float intersection_cost = 1.0f; // 一次图元求交的相对代价
+	};
+
+	// 构建函数：传入一堆物体，构建出一棵树 (会重排 objects)
+	// 树只负责自己创建的内部节点，图元的生命周期由调用方管理
 	BVHNode(std::vector<Object*>& objects);
-	// 递归辅助构造函数
-	BVHNode(std::vector<Object*>& src_objects, size_t start, size_t end);
+	BVHNode(std::vector<Object*>& objects, const Settings& settings);
+	virtual ~BVHNode();
+
+	BVHNode(const BVHNode&) = delete;
+	BVHNode& operator=(const BVHNode&) = delete;
 
 	virtual bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override;
 	virtual AABB get_bounding_box() const override;
 
+	bool is_leaf() const { return left == nullptr; }
+	// 整棵树的 SAH 代价 (相对于根节点表面积)，用来比较不同构建的质量
+	float sah_cost() const;
+	float sah_cost(const Settings& settings) const;
+	size_t node_count() const;
+
+	// 树深 (根为 0，叶子的最大深度) 的上限，LinearBVH / WideBVH 的遍历栈按它开固定大小
+	static constexpr int MAX_DEPTH = 64;
+
+	// 构建时每个图元的包围盒和重心只求一次
+	struct BuildRef {
+		AABB box;
+		Vec3f centroid;
+		uint32_t index; // 图元在输入数组中的下标
+	};
+
+	// 对 [start, end) 做一次分箱 SAH 决策 (LinearBVH 直接构建扁平数组时也用它)
+	// 返回 false 表示做成叶子更划算；返回 true 时 refs 已按切分重排，[start, mid) 在左，axis 为切分轴
+	static bool sah_split(std::vector<BuildRef>& refs, size_t start, size_t end, const AABB& box,
+		const AABB& centroid_box, const Settings& settings, size_t& mid, int& axis);
+
+	// 深度 depth 的节点还剩 count 个图元，depth + ceil(log2(count)) 达到 max_depth 时返回 true，此后只能对半切分：
+	// 对半切分让孩子的 ceil(log2(count)) 恰好少 1，这个和不再增长，叶子的深度就不会超过 max_depth
+	static bool depth_limited(int depth, size_t count, int max_depth = MAX_DEPTH) {
+		return depth + (int)std::bit_width(count - 1) >= max_depth;
+	}
+	// 按重心范围最大的轴对半切分 [start, end)，接口同 sah_split；图元数不超过 max_leaf_size 时做成叶子
+	static bool median_split(std::vector<BuildRef>& refs, size_t start, size_t end, const AABB& centroid_box,
+		const Settings& settings, size_t& mid, int& axis);
+
 public:
-	Object* left;  // 左子树
-	Object* right; // 右子树
-	AABB box;      // 当前节点的包围盒
-};
\ No newline at end of file
+	BVHNode* left = nullptr;  // 左子树 (叶子为空)
+	BVHNode* right = nullptr; // 右子树 (叶子为空)
+	AABB box;                 // 当前节点的包围盒
+	int split_axis = 0;       // 内部节点的切分轴 (左孩子在该轴上偏小)
+	std::vector<Object*> primitives; // 叶子里的图元
+
+private:
+	BVHNode() = default;
+	static BVHNode* build(std::vector<BuildRef>& refs, size_t start, size_t end, int depth, const Settings& settings,
+		const std::vector<Object*>& objects);
+	float sah_sum(const Settings& settings) const;
+};
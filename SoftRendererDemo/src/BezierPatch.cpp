@@ -0,0 +1,206 @@
+﻿#include "BezierPatch.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 三次曲线在 t = 0.5 处一分为二 (De Casteljau)，in / 输出都按 stride 取点
+	inline void split_cubic(const Vec3f* in, int stride, Vec3f* lo, Vec3f* hi) {
+		Vec3f p0 = in[0], p1 = in[stride], p2 = in[2 * stride], p3 = in[3 * stride];
+		Vec3f a = (p0 + p1) * 0.5f, b = (p1 + p2) * 0.5f, c = (p2 + p3) * 0.5f;
+		Vec3f ab = (a + b) * 0.5f, bc = (b + c) * 0.5f;
+		Vec3f mid = (ab + bc) * 0.5f;
+		lo[0] = p0; lo[stride] = a; lo[2 * stride] = ab; lo[3 * stride] = mid;
+		hi[0] = mid; hi[stride] = bc; hi[2 * stride] = c; hi[3 * stride] = p3;
+	}
+
+	// 在 u = 0.5 和 v = 0.5 处四分，顺序：(u 低, v 低), (u 高, v 低), (u 低, v 高), (u 高, v 高)
+	void split_patch(const CubicPatch& p, CubicPatch out[4]) {
+		CubicPatch left, right;
+		for (int row = 0; row < 4; ++row) split_cubic(&p.cp[row * 4], 1, &left.cp[row * 4], &right.cp[row * 4]);
+		for (int col = 0; col < 4; ++col) {
+			split_cubic(&left.cp[col], 4, &out[0].cp[col], &out[2].cp[col]);
+			split_cubic(&right.cp[col], 4, &out[1].cp[col], &out[3].cp[col]);
+		}
+	}
+
+	AABB hull_bounds(const CubicPatch& p) {
+		AABB box;
+		for (const Vec3f& c : p.cp) box.expand(c);
+		return box;
+	}
+
+	// 控制点偏离四个角的双线性插值的最大距离
+	float bilinear_deviation(const CubicPatch& p) {
+		const Vec3f& c00 = p.cp[0];
+		const Vec3f& c10 = p.cp[3];
+		const Vec3f& c01 = p.cp[12];
+		const Vec3f& c11 = p.cp[15];
+		float dev = 0.0f;
+		for (int row = 0; row < 4; ++row) {
+			float v = row / 3.0f;
+			for (int col = 0; col < 4; ++col) {
+				float u = col / 3.0f;
+				Vec3f q = (c00 * (1 - u) + c10 * u) * (1 - v) + (c01 * (1 - u) + c11 * u) * v;
+				dev = std::max(dev, (p.cp[row * 4 + col] - q).length());
+			}
+		}
+		return dev;
+	}
+
+	// 包围盒求交并返回进入距离 (用于近的孩子先访问)
+	inline bool box_entry(const AABB& box, const Ray& r, float tmin, float tmax, float& entry) {
+		for (int i = 0; i < 3; ++i) {
+			float t0 = (box.min[i] - r.orig[i]) * r.invDir[i];
+			float t1 = (box.max[i] - r.orig[i]) * r.invDir[i];
+			if (r.invDir[i] < 0.0f) std::swap(t0, t1);
+			tmin = std::max(tmin, t0);
+			tmax = std::min(tmax, t1);
+			if (tmin > tmax) return false;
+		}
+		entry = tmin;
+		return true;
+	}
+}
+
+BezierPatch::BezierPatch(const CubicPatch& patch, float flatness, int max_depth)
+	: surface(patch), max_depth(max_depth) {
+	AABB root = hull_bounds(patch);
+	float diag = (root.max - root.min).length();
+	flat_tolerance = flatness * diag;
+	hit_tolerance = std::max(1e-5f * diag, 1e-7f);
+
+	nodes.push_back(Node());
+	build(patch, 0, 0.0f, 1.0f, 0.0f, 1.0f, 0);
+}
+
+void BezierPatch::build(const CubicPatch& sub, int index, float u0, float u1, float v0, float v1, int depth) {
+	nodes[index] = { hull_bounds(sub), u0, u1, v0, v1, -1 };
+	if (depth >= max_depth || bilinear_deviation(sub) <= flat_tolerance) {
+		leaves++;
+		return;
+	}
+
+	CubicPatch children[4];
+	split_patch(sub, children);
+	int first = (int)nodes.size();
+	nodes[index].first_child = first;
+	nodes.resize(nodes.size() + 4);
+
+	float um = (u0 + u1) * 0.5f, vm = (v0 + v1) * 0.5f;
+	build(children[0], first + 0, u0, um, v0, vm, depth + 1);
+	build(children[1], first + 1, um, u1, v0, vm, depth + 1);
+	build(children[2], first + 2, u0, um, vm, v1, depth + 1);
+	build(children[3], first + 3, um, u1, vm, v1, depth + 1);
+}
+
+AABB BezierPatch::get_bounding_box() const {
+	return nodes[0].box;
+}
+
+bool BezierPatch::newton(const Ray& r, const Vec3f& n1, float d1, const Vec3f& n2, float d2, const Node& leaf,
+	float& u, float& v, float& t) const {
+	const int MAX_ITERATIONS = 8;
+	u = (leaf.u0 + leaf.u1) * 0.5f;
+	v = (leaf.v0 + leaf.v1) * 0.5f;
+
+	Vec3f pos, du, dv;
+	for (int it = 0; it < MAX_ITERATIONS; ++it) {
+		surface.eval(u, v, pos, du, dv);
+		float f1 = n1.dot(pos) + d1;
+		float f2 = n2.dot(pos) + d2;
+		if (std::abs(f1) < hit_tolerance && std::abs(f2) < hit_tolerance) break;
+
+		float a = n1.dot(du), b = n1.dot(dv);
+		float c = n2.dot(du), d = n2.dot(dv);
+		float det = a * d - b * c;
+		if (std::abs(det) < 1e-20f) return false;
+
+		float inv = 1.0f / det;
+		u -= (d * f1 - b * f2) * inv;
+		v -= (a * f2 - c * f1) * inv;
+		// 明显跑出叶子就放弃，交给相邻叶子
+		float su = leaf.u1 - leaf.u0, sv = leaf.v1 - leaf.v0;
+		if (u < leaf.u0 - su || u > leaf.u1 + su || v < leaf.v0 - sv || v > leaf.v1 + sv) return false;
+	}
+
+	// 最终的解必须在叶子范围内 (允许一点点余量，避免叶子接缝处漏掉)
+	const float margin = 1e-4f;
+	if (u < leaf.u0 - margin || u > leaf.u1 + margin || v < leaf.v0 - margin || v > leaf.v1 + margin) return false;
+	u = std::clamp(u, 0.0f, 1.0f);
+	v = std::clamp(v, 0.0f, 1.0f);
+
+	surface.eval(u, v, pos, du, dv);
+	if (std::abs(n1.dot(pos) + d1) > hit_tolerance * 4.0f || std::abs(n2.dot(pos) + d2) > hit_tolerance * 4.0f) return false;
+
+	t = (pos - r.orig).dot(r.dir) / r.dir.dot(r.dir);
+	return true;
+}
+
+bool BezierPatch::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const {
+	// 光线表示成两个平面的交线：n1、n2 都垂直于 dir，且互相垂直
+	Vec3f n1 = (std::abs(r.dir.x) > std::abs(r.dir.y) && std::abs(r.dir.x) > std::abs(r.dir.z))
+		? Vec3f(r.dir.y, -r.dir.x, 0.0f) : Vec3f(0.0f, r.dir.z, -r.dir.y);
+	n1 = n1.normalize();
+	Vec3f n2 = n1.cross(r.dir).normalize();
+	float d1 = -n1.dot(r.orig);
+	float d2 = -n2.dot(r.orig);
+
+	// 显式栈遍历四叉树 (深度 <= max_depth，每层最多压 4 个)
+	int stack[64];
+	float stack_entry[64];
+	int top = 0;
+	float entry;
+	if (!box_entry(nodes[0].box, r, tmin, tmax, entry)) return false;
+	stack[top] = 0;
+	stack_entry[top++] = entry;
+
+	bool hit = false;
+	float best_u = 0.0f, best_v = 0.0f;
+	while (top > 0) {
+		--top;
+		if (stack_entry[top] > tmax) continue; // 已经有更近的交点
+		const Node& node = nodes[stack[top]];
+		if (node.first_child < 0) {
+			float u, v, t;
+			if (newton(r, n1, d1, n2, d2, node, u, v, t) && t > tmin && t < tmax) {
+				tmax = t;
+				best_u = u;
+				best_v = v;
+				hit = true;
+			}
+			continue;
+		}
+
+		// 被击中的孩子按进入距离从远到近压栈，近的先出栈
+		int order[4];
+		float dist[4];
+		int count = 0;
+		for (int k = 0; k < 4; ++k) {
+			int child = node.first_child + k;
+			if (!box_entry(nodes[child].box, r, tmin, tmax, entry)) continue;
+			int pos = count++;
+			while (pos > 0 && dist[pos - 1] < entry) {
+				order[pos] = order[pos - 1];
+				dist[pos] = dist[pos - 1];
+				pos--;
+			}
+			order[pos] = child;
+			dist[pos] = entry;
+		}
+		for (int k = 0; k < count && top < 64; ++k) {
+			stack[top] = order[k];
+			stack_entry[top++] = dist[k];
+		}
+	}
+
+	if (!hit) return false;
+	rec.t = tmax;
+	rec.p = r.pointAt(tmax);
+	rec.set_face_normal(r, surface.normal(best_u, best_v));
+	// 曲面片参数直接作为 (u, v) 和纹理坐标
+	rec.u = best_u;
+	rec.v = best_v;
+	rec.uv = Vec2f(best_u, best_v);
+	rec.prim_id = -1;
+	return true;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+#include <vector>
+#include "Object.h"
+#include "CubicPatch.h"
+
+// ========================================================================
+// Bezier 曲面片 (BezierPatch)：光线直接求交，不预先细分成三角形
+// ========================================================================
+// 构建时把曲面片在参数空间里四分 (De Casteljau)，直到子曲面片足够平 (控制点离四个角的
+// 双线性面很近)，得到一棵四叉树。每个节点的包围盒取子曲面片控制点的包围盒 (凸包性质保证
+// 包住曲面)。求交时遍历四叉树，在被击中的叶子里做 Newton 迭代：
+//   光线写成两个平面的交线 (n1.p + d1 = 0, n2.p + d2 = 0)，
+//   解 F(u, v) = (n1.S(u,v) + d1, n2.S(u,v) + d2) = 0，雅可比由 dS/du, dS/dv 给出。
+// 叶子足够平时从叶子中心出发几步就收敛；解落在叶子参数范围外就交给相邻叶子。
+// 内存只有 16 个控制点 + 几十个节点，比细分成三角形小得多，交点和法线都是精确曲面上的值。
+class BezierPatch : public Object {
+public:
+	// flatness: 子曲面片偏离双线性面的最大距离 / 整个曲面片包围盒对角线，小于它就停止细分
+	explicit BezierPatch(const CubicPatch& patch, float flatness = 0.01f, int max_depth = 6);
+
+	virtual bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override;
+	virtual AABB get_bounding_box() const override;
+
+	const CubicPatch& patch() const { return surface; }
+	size_t node_count() const { return nodes.size(); }
+	size_t leaf_count() const { return leaves; }
+	size_t memory_bytes() const { return sizeof(*this) + nodes.capacity() * sizeof(Node); }
+
+private:
+	struct Node {
+		AABB box;
+		float u0, u1, v0, v1;
+		int first_child; // 四个孩子连续存放；-1 表示叶子
+	};
+
+	void build(const CubicPatch& sub, int index, float u0, float u1, float v0, float v1, int depth);
+	// 在叶子里从中心出发做 Newton 迭代，成功返回 true 并写出 (u, v, t)
+	bool newton(const Ray& r, const Vec3f& n1, float d1, const Vec3f& n2, float d2, const Node& leaf,
+		float& u, float& v, float& t) const;
+
+	CubicPatch surface;
+	std::vector<Node> nodes; // nodes[0] 是根
+	size_t leaves = 0;
+	float flat_tolerance;    // 绝对距离
+	float hit_tolerance;     // Newton 残差阈值 (绝对距离)
+	int max_depth;
+};
@@ -0,0 +1,150 @@
+﻿#include "CubicPatch.h"
+#include "FrameArena.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// 前向差分：以步长 h 逐步推进多项式 a t^3 + b t^2 + c t + d，每步只做 3 次向量加法
+	struct ForwardDiff {
+		Vec3f f, d1, d2, d3;
+
+		ForwardDiff(const Vec3f& a, const Vec3f& b, const Vec3f& c, const Vec3f& d, float h) {
+			float h2 = h * h, h3 = h2 * h;
+			f = d;
+			d1 = a * h3 + b * h2 + c * h;
+			d2 = a * (6.0f * h3) + b * (2.0f * h2);
+			d3 = a * (6.0f * h3);
+		}
+
+		void step() {
+			f = f + d1;
+			d1 = d1 + d2;
+			d2 = d2 + d3;
+		}
+	};
+
+	// 按 v 的基函数把 4 行压成一条沿 u 的三次曲线 (4 个控制点)
+	inline void collapse_rows(const Vec3f cp[16], const float w[4], Vec3f out[4]) {
+		for (int col = 0; col < 4; ++col) {
+			out[col] = cp[col] * w[0] + cp[4 + col] * w[1] + cp[8 + col] * w[2] + cp[12 + col] * w[3];
+		}
+	}
+
+	inline Vec3f safe_normalize(const Vec3f& n) {
+		float len = n.length();
+		return len > 1e-12f ? n * (1.0f / len) : Vec3f(0, 0, 0);
+	}
+}
+
+CubicPatch::CubicPatch(std::span<const Vec3f> points) {
+	for (int i = 0; i < 16; ++i) cp[i] = points.size() == 16 ? points[i] : Vec3f(0, 0, 0);
+}
+
+void CubicPatch::bernstein(float t, float b[4], float db[4]) {
+	float s = 1.0f - t;
+	b[0] = s * s * s;
+	b[1] = 3.0f * s * s * t;
+	b[2] = 3.0f * s * t * t;
+	b[3] = t * t * t;
+	db[0] = -3.0f * s * s;
+	db[1] = 3.0f * s * s - 6.0f * s * t;
+	db[2] = 6.0f * s * t - 3.0f * t * t;
+	db[3] = 3.0f * t * t;
+}
+
+Vec3f CubicPatch::eval(float u, float v) const {
+	Vec3f pos, du, dv;
+	eval(u, v, pos, du, dv);
+	return pos;
+}
+
+void CubicPatch::eval(float u, float v, Vec3f& pos, Vec3f& du, Vec3f& dv) const {
+	float bu[4], dbu[4], bv[4], dbv[4];
+	bernstein(u, bu, dbu);
+	bernstein(v, bv, dbv);
+
+	Vec3f curve[4], curve_dv[4];
+	collapse_rows(cp, bv, curve);
+	collapse_rows(cp, dbv, curve_dv);
+
+	pos = Vec3f(0, 0, 0); du = Vec3f(0, 0, 0); dv = Vec3f(0, 0, 0);
+	for (int j = 0; j < 4; ++j) {
+		pos = pos + curve[j] * bu[j];
+		du = du + curve[j] * dbu[j];
+		dv = dv + curve_dv[j] * bu[j];
+	}
+}
+
+Vec3f CubicPatch::normal(float u, float v) const {
+	Vec3f pos, du, dv;
+	eval(u, v, pos, du, dv);
+	Vec3f n = safe_normalize(du.cross(dv));
+	if (n.length() > 0.0f) return n;
+
+	// 退化：某个偏导数为零 (控制点重合)，往曲面片中心挪一点再算，极限方向一致
+	const float inset = 1e-3f;
+	float u2 = u + (u < 0.5f ? inset : -inset);
+	float v2 = v + (v < 0.5f ? inset : -inset);
+	eval(u2, v2, pos, du, dv);
+	n = safe_normalize(du.cross(dv));
+	return n.length() > 0.0f ? n : Vec3f(0, 0, 1);
+}
+
+// ==========================================
+// 细分
+// ==========================================
+void CubicPatch::tessellate(int div_u, int div_v, Vec3f* positions, Vec3f* normals, Vec2f* uvs) const {
+	if (div_u < 1 || div_v < 1 || positions == nullptr) return;
+	const int row_verts = div_u + 1;
+	const float h = 1.0f / div_u;
+
+	// v 方向的基函数表 (每行 4 个权重 + 4 个导数权重)
+	ScratchScope scratch;
+	std::pmr::vector<float> v_table((size_t)(div_v + 1) * 8, scratch.resource());
+	for (int i = 0; i <= div_v; ++i) bernstein((float)i / div_v, &v_table[i * 8], &v_table[i * 8 + 4]);
+
+	auto emit_row = [&](int i) {
+		float v = (float)i / div_v;
+		const float* bv = &v_table[i * 8];
+		const float* dbv = &v_table[i * 8 + 4];
+
+		// 1. 这一行是一条沿 u 的三次曲线：位置 P(u)，以及 dP/dv(u) (同样是三次)
+		Vec3f c[4], cv[4];
+		collapse_rows(cp, bv, c);
+		collapse_rows(cp, dbv, cv);
+
+		// 2. 转成幂基系数，初始化前向差分
+		// P(u) = a u^3 + b u^2 + c u + d
+		ForwardDiff pos(c[3] - c[0] + (c[1] - c[2]) * 3.0f, (c[0] + c[2]) * 3.0f - c[1] * 6.0f, (c[1] - c[0]) * 3.0f, c[0], h);
+		ForwardDiff tan_v(cv[3] - cv[0] + (cv[1] - cv[2]) * 3.0f, (cv[0] + cv[2]) * 3.0f - cv[1] * 6.0f, (cv[1] - cv[0]) * 3.0f, cv[0], h);
+		// dP/du(u) 是二次：3 [(D0 - 2 D1 + D2) u^2 + 2 (D1 - D0) u + D0]，Dk = c[k+1] - c[k]
+		Vec3f d0 = c[1] - c[0], d1 = c[2] - c[1], d2 = c[3] - c[2];
+		ForwardDiff tan_u(Vec3f(0, 0, 0), (d0 - d1 * 2.0f + d2) * 3.0f, (d1 - d0) * 6.0f, d0 * 3.0f, h);
+
+		Vec3f* row_pos = positions + (size_t)i * row_verts;
+		for (int j = 0; j < row_verts; ++j) {
+			// 行尾直接取端点 (= 最后一个控制点)，消除累积误差，保证相邻曲面片共享的边完全一致
+			row_pos[j] = j == div_u ? c[3] : pos.f;
+			if (normals) {
+				Vec3f n = safe_normalize(tan_u.f.cross(tan_v.f));
+				normals[(size_t)i * row_verts + j] = n.length() > 0.0f ? n : normal((float)j / div_u, v);
+			}
+			if (uvs) uvs[(size_t)i * row_verts + j] = Vec2f((float)j / div_u, v);
+			pos.step();
+			tan_u.step();
+			tan_v.step();
+		}
+	};
+
+	// 小网格串行即可，调度开销比计算还大
+	const size_t total = (size_t)row_verts * (div_v + 1);
+	if (total < 16384) {
+		for (int i = 0; i <= div_v; ++i) emit_row(i);
+	}
+	else {
+		ThreadPool::instance().parallel_for((size_t)div_v + 1, 0, [&](size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) emit_row((int)i);
+		});
+	}
+}
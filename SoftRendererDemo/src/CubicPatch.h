@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <span>
+#include "GMath.h"
+
+// ==========================================
+// 双三次 Bezier 曲面片求值器
+// ==========================================
+// 控制点固定为 4x4 (行优先：cp[row * 4 + col]，col 沿 u，row 沿 v)，与 Bezier::eval_surface 约定一致。
+// 相比 De Casteljau：
+//   - 直接用 Bernstein 基函数加权，导数也是解析的 (法线 = dP/du x dP/dv)，不再需要有限差分
+//   - tessellate 时 v 方向的基函数预先制表，u 方向沿行用前向差分 (每个顶点只有加法)
+//   - 全程不分配堆内存 (表放在线程的 FrameArena 上)
+struct CubicPatch {
+	Vec3f cp[16];
+
+	CubicPatch() = default;
+	// points 必须正好 16 个，否则返回全零的曲面片
+	explicit CubicPatch(std::span<const Vec3f> points);
+
+	// 三次 Bernstein 基函数及其导数
+	static void bernstein(float t, float b[4], float db[4]);
+
+	Vec3f eval(float u, float v) const;
+	// 同时求位置和两个偏导数
+	void eval(float u, float v, Vec3f& pos, Vec3f& du, Vec3f& dv) const;
+	// 单位法线 (du x dv)；在退化点 (例如收缩成一点的边) 上取稍微往内的位置
+	Vec3f normal(float u, float v) const;
+
+	// 细分为 (div_u + 1) x (div_v + 1) 的规则网格，按行写入 (行内 u 递增)
+	// 输出数组由调用方分配；normals / uvs 可以为 nullptr
+	// 顶点数较多时按行并行 (ThreadPool)
+	void tessellate(int div_u, int div_v, Vec3f* positions, Vec3f* normals, Vec2f* uvs) const;
+};
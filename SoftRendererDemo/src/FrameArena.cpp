@@ -0,0 +1,74 @@
+﻿#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t block_size, std::pmr::memory_resource* upstream)
+	: upstream(upstream), block_size(std::max<size_t>(block_size, 4096)) {
+}
+
+FrameArena::~FrameArena() {
+	for (const Block& b : blocks) upstream->deallocate(b.data, b.size, alignof(std::max_align_t));
+}
+
+FrameArena& FrameArena::local() {
+	thread_local FrameArena arena;
+	return arena;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+	if (bytes == 0) bytes = 1;
+
+	// 1. 当前块放得下：对齐后移动指针
+	// 2. 放不下：往后找一个已有的、足够大的块 (rewind 之后留下的)
+	// 3. 都不行：向上游申请新块，插在当前块之后
+	size_t block = current;
+	size_t aligned = 0;
+	for (; block < blocks.size(); ++block) {
+		size_t start = block == current ? offset : 0;
+		uintptr_t base = reinterpret_cast<uintptr_t>(blocks[block].data);
+		aligned = (size_t)(((base + start + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+		if (aligned + bytes <= blocks[block].size) break;
+	}
+	if (block == blocks.size()) {
+		Block b;
+		b.size = std::max(block_size, bytes + alignment);
+		b.data = static_cast<std::byte*>(upstream->allocate(b.size, alignof(std::max_align_t)));
+		block = blocks.empty() ? 0 : current + 1;
+		blocks.insert(blocks.begin() + block, b);
+		uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+		aligned = (size_t)(((base + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+		frame_stats.block_allocations++;
+	}
+
+	current = block;
+	offset = aligned + bytes;
+
+	frame_stats.allocations++;
+	frame_stats.bytes += bytes;
+	frame_stats.peak_bytes = std::max(frame_stats.peak_bytes, used_bytes());
+	return blocks[block].data + aligned;
+}
+
+void FrameArena::rewind(const Marker& m) {
+	current = m.block;
+	offset = m.offset;
+}
+
+FrameArena::Stats FrameArena::end_frame() {
+	rewind(Marker{});
+	Stats s = frame_stats;
+	frame_stats = Stats{};
+	return s;
+}
+
+size_t FrameArena::capacity() const {
+	size_t total = 0;
+	for (const Block& b : blocks) total += b.size;
+	return total;
+}
+
+size_t FrameArena::used_bytes() const {
+	size_t used = offset;
+	for (size_t i = 0; i < current && i < blocks.size(); ++i) used += blocks[i].size;
+	return used;
+}
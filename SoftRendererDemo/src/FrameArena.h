@@ -0,0 +1,88 @@
+﻿#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// ==========================================
+// 帧内临时内存 (线性 Arena)
+// ==========================================
+// 分配只是移动指针 (bump)，释放是空操作；整块内存在帧末 (end_frame) 或作用域结束 (ScratchScope) 时一次性回收。
+// 实现为 std::pmr::memory_resource，可以直接给 std::pmr::vector 等容器使用：
+//     ScratchScope scratch;
+//     std::pmr::vector<Vec3f> tmp(scratch.resource());
+// 内存块回收后保留复用，稳定运行时不再触碰堆。
+// 每个线程一个实例 (local())，不加锁；不要把一个线程的 Arena 分配出的内存交给别的线程长期持有。
+class FrameArena : public std::pmr::memory_resource {
+public:
+	// 一帧 (或自上次 end_frame 以来) 的统计
+	struct Stats {
+		size_t allocations = 0;       // 分配次数
+		size_t bytes = 0;             // 分配的字节数 (累计，不扣除回收)
+		size_t peak_bytes = 0;        // 同一时刻占用的最大字节数
+		size_t block_allocations = 0; // 向上游 (堆) 申请新块的次数，稳定后应为 0
+	};
+
+	// block_size：每个内存块的默认大小；超过它的单次请求会单独申请一块
+	explicit FrameArena(size_t block_size = 1 << 20, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	~FrameArena() override;
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// 当前线程的实例
+	static FrameArena& local();
+
+	// 位置标记：rewind 回到标记处，之后分配的内存全部作废
+	struct Marker {
+		size_t block = 0;
+		size_t offset = 0;
+	};
+	Marker mark() const { return { current, offset }; }
+	void rewind(const Marker& m);
+
+	// 帧结束：回收全部内存 (保留内存块)，返回这一帧的统计并清零
+	Stats end_frame();
+
+	const Stats& stats() const { return frame_stats; }
+	size_t capacity() const; // 已持有的内存块总大小
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {} // 由 rewind / end_frame 统一回收
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+	struct Block {
+		std::byte* data = nullptr;
+		size_t size = 0;
+	};
+
+	size_t used_bytes() const;
+
+	std::pmr::memory_resource* upstream;
+	size_t block_size;
+	std::vector<Block> blocks;
+	size_t current = 0; // 当前分配所在的块
+	size_t offset = 0;  // 当前块内的偏移
+	Stats frame_stats;
+};
+
+// ==========================================
+// 作用域内的临时内存
+// ==========================================
+// 构造时记录 Arena 位置，析构时退回；可以嵌套。
+// 用在不以帧为单位的热路径上 (解析、细分、工作线程里的计算)，这些地方没有人调用 end_frame。
+class ScratchScope {
+public:
+	explicit ScratchScope(FrameArena& arena = FrameArena::local()) : arena(arena), marker(arena.mark()) {}
+	~ScratchScope() { arena.rewind(marker); }
+
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	std::pmr::memory_resource* resource() { return &arena; }
+
+private:
+	FrameArena& arena;
+	FrameArena::Marker marker;
+};
@@ -1,4 +1,9 @@
 ﻿#include "Geometry.h"
+#include "MeshOptimizer.h"
+#include "FrameArena.h"
+#include "CubicPatch.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <cmath>
 
 // ========================================================================
@@ -32,6 +37,7 @@ namespace Geometry {
 				mesh.indices.push_back(p1); mesh.indices.push_back(p2); mesh.indices.push_back(p3);
 			}
 		}
+		MeshOptimizer::optimize(mesh); // 网格顺序生成的索引对顶点缓存不友好，重排一次
 		return mesh;
 	}
 
@@ -165,24 +171,99 @@ namespace Geometry {
 	// 核心求值函数 (递归版 De Casteljau)
 	// 输入: 当前层级的控制点列表, 参数 t
 	// 输出: 最终计算出的点
-	Vec3f Bezier::eval(const std::vector<Vec3f>& pts, float t) {
-		if (pts.empty()) return Vec3f(0, 0, 0);
+	// ========================================================================
+	// De Casteljau 工具 (不分配堆内存)
+	// ========================================================================
+	namespace {
+		// 控制点不超过这个数时，工作区直接放在栈上
+		constexpr int INLINE_POINTS = 16;
+		// 自适应展平的最大递归深度 (最多 2^16 段)
+		constexpr int MAX_FLATTEN_DEPTH = 16;
+
+		// 在 work 上原地迭代 (work 会被覆盖)，结果汇聚在 work[0]
+		inline Vec3f de_casteljau(Vec3f* work, int n, float t) {
+			// k 表示层级，从 n-1 降到 1
+			for (int k = 1; k < n; ++k) {
+				for (int i = 0; i < n - k; ++i) {
+					// 原地更新数组：P_i = (1-t)P_i + t*P_{i+1}
+					work[i] = work[i] + (work[i + 1] - work[i]) * t;
+				}
+			}
+			return work[0];
+		}
 
-		// 拷贝一份控制点作为工作副本
-		std::vector<Vec3f> temp = pts;
-		int n = temp.size();
+		// 在 t = 0.5 处一分为二：金字塔的左边缘是左半段的控制点，右边缘是右半段的
+		// 直接在 right 上原地迭代：第 k 层之后 right[n-1-k] 不再改变，恰好就是右半段的第 n-1-k 个控制点
+		inline void split_half(const Vec3f* pts, int n, Vec3f* left, Vec3f* right) {
+			for (int i = 0; i < n; ++i) right[i] = pts[i];
+			for (int k = 0; k < n; ++k) {
+				left[k] = right[0];
+				for (int i = 0; i < n - 1 - k; ++i) right[i] = (right[i] + right[i + 1]) * 0.5f;
+			}
+		}
 
-		// De Casteljau 迭代过程：类似金字塔倒推
-		// k 表示层级，从 n-1 降到 1
-		for (int k = 1; k < n; ++k) {
-			for (int i = 0; i < n - k; ++i) {
-				// 原地更新数组：P_i = (1-t)P_i + t*P_{i+1}
-				temp[i] = temp[i] + (temp[i + 1] - temp[i]) * t;
+		// 控制点到弦的最大距离 (弦退化时取到起点的距离)
+		inline float chord_deviation(const Vec3f* pts, int n) {
+			Vec3f a = pts[0], b = pts[n - 1];
+			Vec3f ab = b - a;
+			float len2 = ab.dot(ab);
+			float worst = 0.0f;
+			for (int i = 1; i < n - 1; ++i) {
+				Vec3f ap = pts[i] - a;
+				float d2 = len2 > 1e-20f ? ap.cross(ab).dot(ap.cross(ab)) / len2 : ap.dot(ap);
+				worst = std::max(worst, d2);
 			}
+			return std::sqrt(worst);
+		}
+
+		// 递归展平：flat(pts, n) 判断是否足够平，emit(p) 输出每段的终点
+		template <class Flat, class Emit>
+		void flatten_recursive(const Vec3f* pts, int n, int depth, Vec3f* work, const Flat& flat, const Emit& emit) {
+			if (depth >= MAX_FLATTEN_DEPTH || flat(pts, n)) {
+				emit(pts[n - 1]);
+				return;
+			}
+			// 每一层用 work 中属于自己的 2n 个点
+			Vec3f* left = work;
+			Vec3f* right = work + n;
+			split_half(pts, n, left, right);
+			flatten_recursive(left, n, depth + 1, work + 2 * n, flat, emit);
+			flatten_recursive(right, n, depth + 1, work + 2 * n, flat, emit);
+		}
+
+		template <class Flat, class Emit>
+		void flatten_curve(std::span<const Vec3f> pts, const Flat& flat, const Emit& emit) {
+			if (pts.empty()) return;
+			emit(pts[0]);
+			if (pts.size() == 1) return;
+
+			// 工作区只是未初始化的临时内存 (每层 2n 个点)，不需要逐个构造
+			const int n = (int)pts.size();
+			const size_t work_size = (size_t)2 * n * (MAX_FLATTEN_DEPTH + 1);
+			ScratchScope scratch;
+			std::pmr::polymorphic_allocator<Vec3f> alloc(scratch.resource());
+			Vec3f* work = alloc.allocate(work_size);
+			flatten_recursive(pts.data(), n, 0, work, flat, emit);
 		}
 
-		// 最终结果汇聚在第一个元素
-		return temp[0];
+		inline auto world_flatness(float tolerance) {
+			return [tolerance](const Vec3f* pts, int n) { return chord_deviation(pts, n) <= tolerance; };
+		}
+	}
+
+	Vec3f Bezier::eval(std::span<const Vec3f> pts, float t) {
+		if (pts.empty()) return Vec3f(0, 0, 0);
+		int n = (int)pts.size();
+
+		// 拷贝一份控制点作为工作副本 (常见次数直接用栈)
+		if (n <= INLINE_POINTS) {
+			Vec3f temp[INLINE_POINTS];
+			for (int i = 0; i < n; ++i) temp[i] = pts[i];
+			return de_casteljau(temp, n, t);
+		}
+		ScratchScope scratch;
+		std::pmr::vector<Vec3f> temp(pts.begin(), pts.end(), scratch.resource());
+		return de_casteljau(temp.data(), n, t);
 	}
 
 	// 生成整条曲线的所有点
@@ -203,6 +284,69 @@ namespace Geometry {
 		return curve_points;
 	}
 
+	std::vector<Vec3f> Bezier::flatten(std::span<const Vec3f> pts, float tolerance) {
+		std::vector<Vec3f> out;
+		flatten_curve(pts, world_flatness(std::max(tolerance, 1e-7f)), [&](const Vec3f& p) { out.push_back(p); });
+		return out;
+	}
+
+	std::vector<Vec3f> Bezier::flatten(std::span<const Vec3f> pts, float tolerance_pixels, const Mat4& mvp, const Vec2f& screen) {
+		// 在屏幕上度量：投影子曲线的控制点 (凸包在投影下依然包住曲线)，穿过相机平面时继续细分
+		auto flat = [&](const Vec3f* p, int n) {
+			Vec3f inline_points[INLINE_POINTS];
+			ScratchScope scratch;
+			std::pmr::vector<Vec3f> scratch_points(scratch.resource());
+			if (n > INLINE_POINTS) scratch_points.resize(n);
+			Vec3f* projected = n > INLINE_POINTS ? scratch_points.data() : inline_points;
+			for (int i = 0; i < n; ++i) {
+				Vec4f c = mvp * Vec4f(p[i], 1.0f);
+				if (c.w <= 1e-5f) return false;
+				projected[i] = Vec3f(0.5f * screen.x * (c.x / c.w + 1.0f), 0.5f * screen.y * (c.y / c.w + 1.0f), 0.0f);
+			}
+			return chord_deviation(projected, n) <= tolerance_pixels;
+		};
+		std::vector<Vec3f> out;
+		flatten_curve(pts, flat, [&](const Vec3f& p) { out.push_back(p); });
+		return out;
+	}
+
+	void Bezier::flatten_batch(std::span<const Vec3f> points, std::span<const uint32_t> offsets, float tolerance,
+		std::vector<Vec3f>& out_points, std::vector<uint32_t>& out_offsets) {
+		out_points.clear();
+		out_offsets.assign(1, 0);
+		if (offsets.size() < 2) return;
+		const size_t curves = offsets.size() - 1;
+		const auto flat = world_flatness(std::max(tolerance, 1e-7f));
+		auto curve = [&](size_t i) { return points.subspan(offsets[i], offsets[i + 1] - offsets[i]); };
+
+		// 1. 按块并行展平：每块先写进自己的数组，同时记录每条曲线的点数
+		const size_t block = 256;
+		const size_t blocks = (curves + block - 1) / block;
+		std::vector<std::vector<Vec3f>> block_points(blocks);
+		out_offsets.resize(curves + 1);
+		ThreadPool::instance().parallel_for(blocks, 1, [&](size_t b, size_t e) {
+			for (size_t k = b; k < e; ++k) {
+				std::vector<Vec3f>& dst = block_points[k];
+				for (size_t i = k * block; i < std::min(curves, (k + 1) * block); ++i) {
+					size_t before = dst.size();
+					flatten_curve(curve(i), flat, [&](const Vec3f& p) { dst.push_back(p); });
+					out_offsets[i + 1] = (uint32_t)(dst.size() - before);
+				}
+			}
+		});
+
+		// 2. 前缀和得到每条曲线的输出区间
+		for (size_t i = 0; i < curves; ++i) out_offsets[i + 1] += out_offsets[i];
+		out_points.resize(out_offsets[curves]);
+
+		// 3. 并行拷贝到最终位置
+		ThreadPool::instance().parallel_for(blocks, 1, [&](size_t b, size_t e) {
+			for (size_t k = b; k < e; ++k) {
+				std::copy(block_points[k].begin(), block_points[k].end(), out_points.begin() + out_offsets[k * block]);
+			}
+		});
+	}
+
 	Vec3f Bezier::eval_surface(const std::vector<Vec3f>& control_points, float u, float v)
 	{
 		// 安全检查：必须是 16 个点 (4x4)
@@ -211,19 +355,14 @@ namespace Geometry {
 		}
 
 		// 临时容器：存储 4 行经过 u 插值后的点
-		std::vector<Vec3f> u_interpolated_points;
+		ScratchScope scratch;
+		std::pmr::vector<Vec3f> u_interpolated_points(scratch.resource());
 		u_interpolated_points.reserve(4);
 
 		// 1. 遍历 4 行
 		for (int i = 0; i < 4; ++i) {
-			// 提取当前行的 4 个控制点
-			std::vector<Vec3f> row_points;
-			row_points.reserve(4);
-
-			for (int j = 0; j < 4; ++j) {
-				// 索引计算：行号 * 4 + 列号
-				row_points.push_back(control_points[i * 4 + j]);
-			}
+			// 当前行的 4 个控制点 (行优先存储，直接取视图，不拷贝)
+			std::span<const Vec3f> row_points(control_points.data() + i * 4, 4);
 
 			// 对这一行用 u 进行曲线求值，得到一个点
 			Vec3f p = eval(row_points, u);
@@ -237,44 +376,21 @@ namespace Geometry {
 
 	Mesh Bezier::generate_surface_mesh(const std::vector<Vec3f>& control_points, int div_u, int div_v) {
 		Mesh mesh;
+		if (control_points.size() != 16 || div_u < 1 || div_v < 1) return mesh;
+
 		// 1. 生成顶点数据 (Positions & Normals & UVs)
 		// 注意：顶点数比格子数多 1
-		for (int i = 0; i <= div_v; ++i) {
-			float v = (float)i / div_v;
-			for (int j = 0; j <= div_u; ++j) {
-				float u = (float)j / div_u;
-
-				// 计算位置
-				Vec3f pos = eval_surface(control_points, u, v);
-				mesh.positions.push_back(pos);
-
-				// 计算 UV
-				mesh.uvs.push_back(Vec2f(u, v));
-
-				// 计算法线 (使用有限差分法，防止边缘导数退化)
-				float eps = 0.001f;
-				// 限制采样点在 [0,1] 范围内
-				float u_L = std::max(0.0f, u - eps);
-				float u_R = std::min(1.0f, u + eps);
-				float v_B = std::max(0.0f, v - eps);
-				float v_T = std::min(1.0f, v + eps);
-
-				Vec3f p_L = eval_surface(control_points, u_L, v);
-				Vec3f p_R = eval_surface(control_points, u_R, v);
-				Vec3f p_B = eval_surface(control_points, u, v_B);
-				Vec3f p_T = eval_surface(control_points, u, v_T);
-
-				Vec3f tangent_u = (p_R - p_L).normalize();
-				Vec3f tangent_v = (p_T - p_B).normalize();
-
-				// 叉乘得到法线
-				mesh.normals.push_back(tangent_u.cross(tangent_v).normalize());
-			}
-		}
+		// 法线来自解析偏导数 (CubicPatch)，行内前向差分，顶点多时按行并行
+		size_t vertex_count = (size_t)(div_u + 1) * (div_v + 1);
+		mesh.positions.resize(vertex_count);
+		mesh.normals.resize(vertex_count);
+		mesh.uvs.resize(vertex_count);
+		CubicPatch(control_points).tessellate(div_u, div_v, mesh.positions.data(), mesh.normals.data(), mesh.uvs.data());
 
 		// 2. 生成三角形索引 (Indices)
 		// 注意：循环只到 div_v - 1 和 div_u - 1，防止越界
 		int n_verts_row = div_u + 1;
+		mesh.indices.reserve((size_t)div_u * div_v * 6);
 		for (int i = 0; i < div_v; ++i) {
 			for (int j = 0; j < div_u; ++j) {
 				int p0 = i * n_verts_row + j;       // 左下
@@ -294,6 +410,7 @@ namespace Geometry {
 			}
 		}
 
+		MeshOptimizer::optimize(mesh);
 		return mesh;
 	}
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 ﻿#pragma once
+#include <cstdint>
 #include <vector>
+#include <span>
 #include "GMath.h"
 
 // 基础网格结构
@@ -7,6 +9,7 @@ struct Mesh {
 	std::vector<Vec3f> positions;
 	std::vector<Vec3f> normals;
 	std::vector<Vec2f> uvs;
+	std::vector<Vec4f> tangents; // 可选：xyz 切线，w 手性 (MeshProcessing::compute_tangents)
 	std::vector<int> indices;
 };
 
@@ -21,12 +24,24 @@ namespace Geometry {
 
 	// 贝塞尔曲线
 	struct Bezier {
-		// 核心求值 (De Casteljau)
-		static Vec3f eval(const std::vector<Vec3f>& pts, float t);
+		// 核心求值 (De Casteljau)，工作副本在栈上 (超过 16 个控制点时放在线程的 FrameArena 上)
+		static Vec3f eval(std::span<const Vec3f> pts, float t);
 
 		// 生成整条线的点集
 		static std::vector<Vec3f> generate_curve(const std::vector<Vec3f>& pts, int segments);
 
+		// 自适应展平：对半细分，直到控制点到弦的最大距离不超过 tolerance (世界单位)
+		// 输出包含两个端点，点数由曲率决定；任意次数，不分配堆内存 (结果数组除外)
+		static std::vector<Vec3f> flatten(std::span<const Vec3f> pts, float tolerance);
+		// 屏幕空间版本：控制点按 mvp 投影后以像素度量 (输出仍是原空间的点)
+		static std::vector<Vec3f> flatten(std::span<const Vec3f> pts, float tolerance_pixels, const Mat4& mvp, const Vec2f& screen);
+
+		// 批量展平 (发丝、矢量路径等大量短曲线)：
+		// 输入为 CSR：第 i 条曲线的控制点是 points[offsets[i], offsets[i+1])
+		// 输出同样是 CSR；各曲线并行处理，结果与逐条调用 flatten 相同
+		static void flatten_batch(std::span<const Vec3f> points, std::span<const uint32_t> offsets, float tolerance,
+			std::vector<Vec3f>& out_points, std::vector<uint32_t>& out_offsets);
+
 		// 曲面求值 双向 De Casteljau
 		// control_points: 必须包含 16 个点 (4x4 矩阵的行优先排列)
 		static Vec3f eval_surface(const std::vector<Vec3f>& control_points, float u, float v);
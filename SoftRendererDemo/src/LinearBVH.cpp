@@ -0,0 +1,533 @@
+﻿#include "LinearBVH.h"
+#include "ThreadPool.h"
+#include <cstring>
+
+static_assert(sizeof(LinearBVH::Node) == 32, "LinearBVH::Node should stay 32 bytes");
+
+namespace {
+	inline float node_area(const LinearBVH::Node& node) {
+		Vec3f d = node.max - node.min;
+		return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+	}
+}
+
+namespace {
+	// ========================================================================
+	// HLBVH 辅助
+	// ========================================================================
+	// 10 位整数的位之间插入两个 0：...9876543210 -> ..9..8..7..6..5..4..3..2..1..0
+	inline uint32_t expand_bits(uint32_t v) {
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// 30 位 Morton 码，位从高到低按 x, y, z 交错；p 已归一化到 [0, 1]
+	inline uint32_t morton_code(const Vec3f& p) {
+		auto quantize = [](float f) { return (uint32_t)std::clamp(f * 1024.0f, 0.0f, 1023.0f); };
+		return (expand_bits(quantize(p.x)) << 2) | (expand_bits(quantize(p.y)) << 1) | expand_bits(quantize(p.z));
+	}
+
+	// Morton 码第 bit 位对应的轴
+	inline int morton_axis(int bit) { return 2 - bit % 3; }
+
+	struct MortonRef {
+		uint32_t code;
+		uint32_t index;
+	};
+
+	// 并行 LSD 基数排序：30 位分 3 趟，每趟 10 位。
+	// 每趟：各块统计直方图 -> 按 (桶, 块) 顺序求前缀和 -> 各块稳定地分散写出
+	void radix_sort(std::vector<MortonRef>& refs) {
+		const int BITS_PER_PASS = 10;
+		const int BUCKETS = 1 << BITS_PER_PASS;
+		const size_t n = refs.size();
+		ThreadPool& pool = ThreadPool::instance();
+		const size_t block = std::max<size_t>(n / (pool.concurrency() * 4) + 1, 16384);
+		const size_t blocks = (n + block - 1) / block;
+
+		std::vector<MortonRef> temp(n);
+		std::vector<uint32_t> offsets(blocks * BUCKETS);
+		for (int pass = 0; pass < 3; ++pass) {
+			const int shift = pass * BITS_PER_PASS;
+			std::fill(offsets.begin(), offsets.end(), 0);
+			pool.parallel_for(blocks, 1, [&](size_t b, size_t e) {
+				for (size_t blk = b; blk < e; ++blk) {
+					uint32_t* count = &offsets[blk * BUCKETS];
+					for (size_t i = blk * block, end = std::min(n, i + block); i < end; ++i) {
+						count[(refs[i].code >> shift) & (BUCKETS - 1)]++;
+					}
+				}
+			});
+
+			uint32_t sum = 0;
+			for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+				for (size_t blk = 0; blk < blocks; ++blk) {
+					uint32_t c = offsets[blk * BUCKETS + bucket];
+					offsets[blk * BUCKETS + bucket] = sum;
+					sum += c;
+				}
+			}
+
+			pool.parallel_for(blocks, 1, [&](size_t b, size_t e) {
+				for (size_t blk = b; blk < e; ++blk) {
+					uint32_t* offset = &offsets[blk * BUCKETS];
+					for (size_t i = blk * block, end = std::min(n, i + block); i < end; ++i) {
+						temp[offset[(refs[i].code >> shift) & (BUCKETS - 1)]++] = refs[i];
+					}
+				}
+			});
+			refs.swap(temp);
+		}
+	}
+
+	// 一棵底层子树 (treelet)：Morton 码高 12 位相同的一段图元
+	struct Treelet {
+		size_t start = 0, end = 0;
+		std::vector<LinearBVH::Node> nodes; // 局部下标 (右孩子 offset 相对 treelet 起点)
+		AABB box;
+		size_t base = 0;                    // 在最终数组中的起点
+	};
+
+	inline void set_bounds(LinearBVH::Node& node, const AABB& box) {
+		node.min = box.min;
+		node.max = box.max;
+	}
+
+	inline AABB node_bounds(const LinearBVH::Node& node) {
+		return AABB(node.min, node.max);
+	}
+
+	// 顶层树的深度上限 (treelet 最多 4096 个，对半切只要 12 层)；treelet 按根在这个深度来限制，整棵树不超过 MAX_DEPTH
+	constexpr int UPPER_MAX_DEPTH = 24;
+
+	// 按 Morton 码的位递归切分 [start, end)：第 bit 位为 0 的在左，为 1 的在右 (二分查找切分点)
+	// 叶子的 offset 是排序后的全局下标，图元数组直接按排序结果排列
+	int emit_lbvh(const std::vector<MortonRef>& refs, const std::vector<AABB>& boxes, size_t start, size_t end,
+		int bit, int depth, int max_leaf, std::vector<LinearBVH::Node>& out) {
+		int index = (int)out.size();
+		out.push_back(LinearBVH::Node());
+		const size_t count = end - start;
+
+		if (count <= (size_t)max_leaf) {
+			AABB box;
+			for (size_t i = start; i < end; ++i) box.expand(boxes[refs[i].index]);
+			set_bounds(out[index], box);
+			out[index].offset = (int32_t)start;
+			out[index].count = (uint16_t)count;
+			return index;
+		}
+
+		// 找到区间内首尾不同的最高位；全部相同 (重合的重心) 或深度受限时对半分 (已按 Morton 码排好，中点即中位数)
+		while (bit >= 0 && ((refs[start].code >> bit) & 1) == ((refs[end - 1].code >> bit) & 1)) bit--;
+		const bool limited = BVHNode::depth_limited(depth, count);
+		size_t split;
+		if (bit >= 0 && !limited) {
+			size_t lo = start, hi = end - 1;
+			while (lo + 1 < hi) {
+				size_t mid = (lo + hi) / 2;
+				if ((refs[mid].code >> bit) & 1) hi = mid;
+				else lo = mid;
+			}
+			split = hi;
+		}
+		else {
+			split = start + count / 2;
+		}
+
+		emit_lbvh(refs, boxes, start, split, bit - 1, depth + 1, max_leaf, out);
+		int right = emit_lbvh(refs, boxes, split, end, bit - 1, depth + 1, max_leaf, out);
+		AABB box = node_bounds(out[index + 1]);
+		box.expand(node_bounds(out[right]));
+		set_bounds(out[index], box);
+		out[index].offset = right;
+		out[index].axis = (uint8_t)(bit >= 0 && !limited ? morton_axis(bit) : box.max_extent_axis());
+		return index;
+	}
+
+	// 顶层：在 treelet 之上做 SAH (treelet 数量少，按重心排序后精确扫描)
+	struct UpperNode {
+		AABB box;
+		int left = -1, right = -1;
+		int treelet = -1;
+		int axis = 0;
+	};
+
+	int build_upper(std::vector<Treelet>& treelets, std::vector<int>& items, size_t start, size_t end, int depth,
+		std::vector<UpperNode>& out) {
+		int index = (int)out.size();
+		out.push_back(UpperNode());
+		if (end - start == 1) {
+			out[index].box = treelets[items[start]].box;
+			out[index].treelet = items[start];
+			return index;
+		}
+
+		auto centroid = [&](int item, int axis) { return treelets[item].box.center()[axis]; };
+		auto weight = [&](int item) { return (float)(treelets[item].end - treelets[item].start); };
+
+		// 深度受限：按重心范围最大的轴对半分 treelet
+		if (BVHNode::depth_limited(depth, end - start, UPPER_MAX_DEPTH)) {
+			AABB centroids;
+			for (size_t i = start; i < end; ++i) centroids.expand(treelets[items[i]].box.center());
+			const int axis = centroids.max_extent_axis();
+			const size_t mid = start + (end - start) / 2;
+			std::nth_element(items.begin() + start, items.begin() + mid, items.begin() + end,
+				[&](int a, int b) { return centroid(a, axis) < centroid(b, axis); });
+			int left = build_upper(treelets, items, start, mid, depth + 1, out);
+			int right = build_upper(treelets, items, mid, end, depth + 1, out);
+			out[index].left = left;
+			out[index].right = right;
+			out[index].axis = axis;
+			out[index].box = out[left].box;
+			out[index].box.expand(out[right].box);
+			return index;
+		}
+
+		// 每个轴：按重心排序，从右往左累积面积，再从左往右扫描，代价 = A_l * N_l + A_r * N_r (N 为图元数)
+		float best_cost = FLT_MAX;
+		int best_axis = 0;
+		size_t best_split = start + (end - start) / 2;
+		std::vector<float> right_cost(end - start);
+		for (int axis = 0; axis < 3; ++axis) {
+			std::sort(items.begin() + start, items.begin() + end, [&](int a, int b) { return centroid(a, axis) < centroid(b, axis); });
+			AABB acc;
+			float n = 0.0f;
+			for (size_t i = end - 1; i > start; --i) {
+				acc.expand(treelets[items[i]].box);
+				n += weight(items[i]);
+				right_cost[i - start] = acc.surface_area() * n;
+			}
+			acc = AABB();
+			n = 0.0f;
+			for (size_t i = start + 1; i < end; ++i) {
+				acc.expand(treelets[items[i - 1]].box);
+				n += weight(items[i - 1]);
+				float cost = acc.surface_area() * n + right_cost[i - start];
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_split = i;
+				}
+			}
+		}
+		if (best_axis != 2) {
+			std::sort(items.begin() + start, items.begin() + end, [&](int a, int b) { return centroid(a, best_axis) < centroid(b, best_axis); });
+		}
+
+		int left = build_upper(treelets, items, start, best_split, depth + 1, out);
+		int right = build_upper(treelets, items, best_split, end, depth + 1, out);
+		out[index].left = left;
+		out[index].right = right;
+		out[index].axis = best_axis;
+		out[index].box = out[left].box;
+		out[index].box.expand(out[right].box);
+		return index;
+	}
+
+	// 顶层节点按深度优先分配最终下标；遇到 treelet 就整段预留
+	int place_upper(const std::vector<UpperNode>& upper, int u, std::vector<Treelet>& treelets,
+		std::vector<std::pair<int, int>>& placed, size_t& counter) {
+		const UpperNode& node = upper[u];
+		if (node.treelet >= 0) {
+			Treelet& t = treelets[node.treelet];
+			t.base = counter;
+			counter += t.nodes.size();
+			return (int)t.base;
+		}
+		int index = (int)counter++;
+		placed.push_back({ u, index });
+		place_upper(upper, node.left, treelets, placed, counter);
+		place_upper(upper, node.right, treelets, placed, counter);
+		return index;
+	}
+}
+
+LinearBVH::LinearBVH(std::vector<Object*>& objects)
+	: LinearBVH(objects, BVHNode::Settings())
+{
+}
+
+LinearBVH::LinearBVH(std::vector<Object*>& objects, const BVHNode::Settings& settings, Builder builder) {
+	if (objects.empty()) return;
+
+	// 包围盒只取一次 (虚调用，并行)
+	std::vector<AABB> boxes(objects.size());
+	ThreadPool::instance().parallel_for(objects.size(), 0, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) boxes[i] = objects[i]->get_bounding_box();
+	});
+	build(boxes, settings, builder);
+
+	// 图元按叶子顺序排列，调用方的数组同步重排
+	primitives.resize(objects.size());
+	for (size_t i = 0; i < order.size(); ++i) primitives[i] = objects[order[i]];
+	objects = primitives;
+}
+
+LinearBVH::LinearBVH(const std::vector<AABB>& boxes, const BVHNode::Settings& settings, Builder builder) {
+	if (!boxes.empty()) build(boxes, settings, builder);
+}
+
+LinearBVH::LinearBVH(const BVHNode& tree) {
+	nodes.reserve(tree.node_count());
+	flatten(tree);
+}
+
+void LinearBVH::build(const std::vector<AABB>& boxes, const BVHNode::Settings& settings, Builder builder) {
+	if (builder == Builder::HLBVH || (builder == Builder::Auto && boxes.size() >= HLBVH_THRESHOLD)) build_hlbvh(boxes, settings);
+	else build_sah(boxes, settings);
+}
+
+// 分箱 SAH (与 BVHNode 的切分完全一致)，直接按深度优先写入扁平数组
+void LinearBVH::build_sah(const std::vector<AABB>& boxes, const BVHNode::Settings& settings) {
+	std::vector<BVHNode::BuildRef> refs(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i) refs[i] = { boxes[i], boxes[i].center(), (uint32_t)i };
+
+	nodes.reserve(boxes.size() * 2 / std::max(settings.max_leaf_size, 1) + 1);
+	emit_sah(refs, 0, refs.size(), 0, settings);
+
+	// 叶子是 refs 中连续的一段，构建结束时 refs 的顺序就是图元顺序
+	order.resize(refs.size());
+	for (size_t i = 0; i < refs.size(); ++i) order[i] = refs[i].index;
+}
+
+int LinearBVH::emit_sah(std::vector<BVHNode::BuildRef>& refs, size_t start, size_t end, int depth, const BVHNode::Settings& settings) {
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+	AABB box, centroid_box;
+	for (size_t i = start; i < end; ++i) {
+		box.expand(refs[i].box);
+		centroid_box.expand(refs[i].centroid);
+	}
+	set_bounds(nodes[index], box);
+
+	size_t mid;
+	int axis = 0;
+	const bool split = BVHNode::depth_limited(depth, end - start)
+		? BVHNode::median_split(refs, start, end, centroid_box, settings, mid, axis)
+		: BVHNode::sah_split(refs, start, end, box, centroid_box, settings, mid, axis);
+	if (!split) {
+		nodes[index].offset = (int32_t)start;
+		nodes[index].count = (uint16_t)(end - start);
+		return index;
+	}
+
+	nodes[index].axis = (uint8_t)axis;
+	emit_sah(refs, start, mid, depth + 1, settings); // 左孩子就是 index + 1
+	int right = emit_sah(refs, mid, end, depth + 1, settings);
+	nodes[index].offset = right;
+	return index;
+}
+
+// 深度优先展开，返回节点下标
+int LinearBVH::flatten(const BVHNode& node) {
+	int index = (int)nodes.size();
+	nodes.push_back(Node());
+	nodes[index].min = node.box.min;
+	nodes[index].max = node.box.max;
+
+	if (node.is_leaf()) {
+		nodes[index].offset = (int32_t)primitives.size();
+		nodes[index].count = (uint16_t)node.primitives.size();
+		primitives.insert(primitives.end(), node.primitives.begin(), node.primitives.end());
+		return index;
+	}
+
+	nodes[index].axis = (uint8_t)node.split_axis;
+	flatten(*node.left); // 左孩子就是 index + 1
+	int right = flatten(*node.right);
+	nodes[index].offset = right;
+	return index;
+}
+
+// ========================================================================
+// HLBVH 构建
+// ========================================================================
+// 1. 并行求图元包围盒、重心范围和 30 位 Morton 码
+// 2. 并行基数排序
+// 3. 按 Morton 码高 12 位 (每轴 16 格) 分成 treelet，各 treelet 并行按 Morton 位切分建子树
+// 4. treelet 之上用 SAH 建顶层，弥补 Morton 切分在粗层级上的质量损失
+// 5. 按深度优先顺序把顶层节点和各 treelet 拼进同一个数组 (treelet 并行拷贝)
+void LinearBVH::build_hlbvh(const std::vector<AABB>& input_boxes, const BVHNode::Settings& settings) {
+	const size_t n = input_boxes.size();
+	ThreadPool& pool = ThreadPool::instance();
+	const int max_leaf = std::clamp(settings.max_leaf_size, 1, 65535);
+
+	// 1. 重心范围 (分块归约)
+	const std::vector<AABB>& boxes = input_boxes;
+	const size_t block = 1 << 14;
+	const size_t blocks = (n + block - 1) / block;
+	std::vector<AABB> partial(blocks);
+	pool.parallel_for(blocks, 1, [&](size_t b, size_t e) {
+		for (size_t blk = b; blk < e; ++blk) {
+			for (size_t i = blk * block, end = std::min(n, i + block); i < end; ++i) partial[blk].expand(boxes[i].center());
+		}
+	});
+	AABB centroid_box;
+	for (const AABB& p : partial) centroid_box.expand(p);
+
+	Vec3f extent = centroid_box.max - centroid_box.min;
+	Vec3f inv_extent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	std::vector<MortonRef> refs(n);
+	pool.parallel_for(n, 0, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) {
+			Vec3f p = boxes[i].center() - centroid_box.min;
+			refs[i] = { morton_code(Vec3f(p.x * inv_extent.x, p.y * inv_extent.y, p.z * inv_extent.z)), (uint32_t)i };
+		}
+	});
+
+	// 2. 排序
+	radix_sort(refs);
+
+	// 3. 切分 treelet 并行建子树
+	const int TREELET_SHIFT = 30 - 12;
+	std::vector<Treelet> treelets;
+	for (size_t start = 0, i = 1; i <= n; ++i) {
+		if (i == n || (refs[i].code >> TREELET_SHIFT) != (refs[start].code >> TREELET_SHIFT)) {
+			Treelet t;
+			t.start = start;
+			t.end = i;
+			treelets.push_back(std::move(t));
+			start = i;
+		}
+	}
+	pool.parallel_for(treelets.size(), 1, [&](size_t b, size_t e) {
+		for (size_t k = b; k < e; ++k) {
+			Treelet& t = treelets[k];
+			t.nodes.reserve((t.end - t.start) * 2 / max_leaf + 1);
+			emit_lbvh(refs, boxes, t.start, t.end, TREELET_SHIFT - 1, UPPER_MAX_DEPTH, max_leaf, t.nodes);
+			t.box = node_bounds(t.nodes[0]);
+		}
+	});
+
+	// 4. 顶层 SAH
+	std::vector<int> items(treelets.size());
+	for (size_t k = 0; k < items.size(); ++k) items[k] = (int)k;
+	std::vector<UpperNode> upper;
+	upper.reserve(treelets.size() * 2);
+	int upper_root = build_upper(treelets, items, 0, items.size(), 0, upper);
+
+	// 5. 拼接：顶层节点串行写入，treelet 并行拷贝并把局部的右孩子下标平移到全局
+	std::vector<std::pair<int, int>> placed; // (顶层节点, 最终下标)
+	size_t total = 0;
+	place_upper(upper, upper_root, treelets, placed, total);
+	nodes.assign(total, Node());
+
+	std::vector<int> upper_index(upper.size(), -1);
+	for (const auto& [u, index] : placed) upper_index[u] = index;
+	for (const auto& [u, index] : placed) {
+		const UpperNode& un = upper[u];
+		const UpperNode& right = upper[un.right];
+		set_bounds(nodes[index], un.box);
+		// 左孩子紧跟在后面，只记录右孩子 (可能是顶层节点，也可能是某个 treelet 的根)
+		nodes[index].offset = right.treelet >= 0 ? (int32_t)treelets[right.treelet].base : upper_index[un.right];
+		nodes[index].axis = (uint8_t)un.axis;
+	}
+
+	pool.parallel_for(treelets.size(), 1, [&](size_t b, size_t e) {
+		for (size_t k = b; k < e; ++k) {
+			const Treelet& t = treelets[k];
+			Node* dst = &nodes[t.base];
+			std::memcpy(dst, t.nodes.data(), t.nodes.size() * sizeof(Node));
+			for (size_t i = 0; i < t.nodes.size(); ++i) {
+				if (dst[i].count == 0) dst[i].offset += (int32_t)t.base;
+			}
+		}
+	});
+
+	// 图元按 Morton 顺序排列 (叶子的 offset 就是排序后的下标)
+	order.resize(n);
+	pool.parallel_for(n, 0, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) order[i] = refs[i].index;
+	});
+}
+
+bool LinearBVH::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const {
+	// 叶子：逐个图元求交，击中就收紧 tmax
+	return traverse(r, tmin, tmax, [&](size_t first, size_t count, float t_min, float& t_max) {
+		bool hit = false;
+		for (size_t i = first; i < first + count; ++i) {
+			if (primitives[i]->intersect(r, t_min, t_max, rec)) {
+				hit = true;
+				t_max = rec.t;
+			}
+		}
+		return hit;
+	});
+}
+
+float LinearBVH::refit() {
+	return refit([&](size_t i) { return primitives[i]->get_bounding_box(); });
+}
+
+float LinearBVH::refit(const std::function<AABB(size_t)>& primitive_bounds) {
+	if (nodes.empty()) return 0.0f;
+
+	// 1. 按深度分层 (只做一次，拓扑不变就一直可用)
+	if (level_offsets.empty()) {
+		std::vector<int> depth(nodes.size(), 0);
+		int max_depth = 0;
+		// 深度优先布局里父节点总在孩子前面，顺序扫描一遍即可
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (nodes[i].count > 0) continue;
+			depth[i + 1] = depth[i] + 1;
+			depth[nodes[i].offset] = depth[i] + 1;
+			max_depth = std::max(max_depth, depth[i] + 1);
+		}
+		level_offsets.assign(max_depth + 2, 0);
+		for (int d : depth) level_offsets[d + 1]++;
+		for (int d = 0; d <= max_depth; ++d) level_offsets[d + 1] += level_offsets[d];
+		level_nodes.resize(nodes.size());
+		std::vector<size_t> cursor(level_offsets.begin(), level_offsets.end() - 1);
+		for (size_t i = 0; i < nodes.size(); ++i) level_nodes[cursor[depth[i]]++] = (int)i;
+	}
+
+	// 2. 从最深一层往上：叶子取图元包围盒，内部节点合并两个孩子 (孩子一定在更深的层，已经更新过)
+	ThreadPool& pool = ThreadPool::instance();
+	for (size_t d = level_offsets.size() - 1; d-- > 0;) {
+		const size_t begin = level_offsets[d], count = level_offsets[d + 1] - begin;
+		auto refit_range = [&](size_t b, size_t e) {
+			for (size_t k = b; k < e; ++k) {
+				Node& node = nodes[level_nodes[begin + k]];
+				AABB box;
+				if (node.count > 0) {
+					for (int i = 0; i < node.count; ++i) box.expand(primitive_bounds((size_t)node.offset + i));
+				}
+				else {
+					int index = (int)(&node - nodes.data());
+					box = node_bounds(nodes[index + 1]);
+					box.expand(node_bounds(nodes[node.offset]));
+				}
+				set_bounds(node, box);
+			}
+		};
+		// 靠近根的几层节点很少，直接串行
+		if (count < 1024) refit_range(0, count);
+		else pool.parallel_for(count, 256, refit_range);
+	}
+	return sah_cost();
+}
+
+AABB LinearBVH::get_bounding_box() const {
+	return nodes.empty() ? AABB() : AABB(nodes[0].min, nodes[0].max);
+}
+
+float LinearBVH::sah_cost() const {
+	return sah_cost(BVHNode::Settings());
+}
+
+// 与 BVHNode::sah_cost 相同：内部节点 A * traversal_cost，叶子 A * N * intersection_cost，除以根的面积
+float LinearBVH::sah_cost(const BVHNode::Settings& settings) const {
+	if (nodes.empty()) return 0.0f;
+	float root = node_area(nodes[0]);
+	if (root <= 0.0f) return 0.0f;
+	double sum = 0.0;
+	for (const Node& node : nodes) {
+		sum += node_area(node) * (node.count > 0 ? node.count * settings.intersection_cost : settings.traversal_cost);
+	}
+	return (float)(sum / root);
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "BVH.h"
+
+// ========================================================================
+// 线性 BVH (扁平数组 + 迭代遍历)
+// ========================================================================
+// 由 BVHNode 树按深度优先顺序展开：左孩子紧跟在父节点后面，只需记录右孩子下标；
+// 叶子记录 primitives 中的一段 [offset, offset + count)。每个节点 32 字节，两个正好一条缓存行。
+// 遍历用显式栈，不递归、不走节点的虚函数；按光线方向在切分轴上的符号先访问近的孩子，
+// 找到交点后 tmax 收紧，远处的子树大多在包围盒测试时就被剔除。只有叶子里的图元求交是虚调用。
+class LinearBVH : public Object {
+public:
+	struct Node {
+		Vec3f min;
+		int32_t offset;  // 叶子：第一个图元在 primitives 中的下标；内部节点：右孩子的节点下标
+		Vec3f max;
+		uint16_t count;  // 叶子的图元数，0 表示内部节点
+		uint8_t axis;    // 内部节点的切分轴
+		uint8_t pad;
+	};
+
+	// 构建方式
+	enum class Builder {
+		SAH,   // 分箱 SAH (与 BVHNode 的切分相同)：质量最好，单线程
+		HLBVH, // 并行 Morton 码 (LBVH) 建底层子树，顶层再用 SAH 合并：大场景构建快很多
+		Auto   // 图元数达到 HLBVH_THRESHOLD 时用 HLBVH，否则 SAH
+	};
+	static constexpr size_t HLBVH_THRESHOLD = 1 << 18;
+
+	// 建树 (会重排 objects 为叶子顺序)；图元的生命周期由调用方管理
+	LinearBVH(std::vector<Object*>& objects);
+	LinearBVH(std::vector<Object*>& objects, const BVHNode::Settings& settings, Builder builder = Builder::SAH);
+	// 只按包围盒建结构，不关联 Object (例如 TriangleMesh 内部的三角形)：
+	// 叶子里第 i 个位置对应输入的第 get_order()[i] 个图元，求交用 traverse 自定义叶子测试
+	LinearBVH(const std::vector<AABB>& boxes, const BVHNode::Settings& settings, Builder builder = Builder::SAH);
+	// 展开一棵已有的树
+	explicit LinearBVH(const BVHNode& tree);
+	LinearBVH() = default;
+
+	virtual bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override;
+	virtual AABB get_bounding_box() const override;
+
+	// 迭代遍历，叶子交给 leaf_test(first, count, tmin, tmax)：检查排序后的第 [first, first + count) 个图元，
+	// 击中时把 tmax 收紧为最近的交点并返回 true
+	template <typename LeafTest>
+	bool traverse(const Ray& r, float tmin, float tmax, LeafTest&& leaf_test) const;
+
+	// 重新拟合：图元移动 / 变形但数量不变时，拓扑保持不变，只自底向上重新计算包围盒
+	// 同一深度的节点并行处理，从最深一层往根推进；返回重新拟合后的 SAH 代价
+	float refit();
+	// primitive_bounds(i) 返回排序后第 i 个图元的包围盒 (可能被多个线程同时调用)
+	float refit(const std::function<AABB(size_t)>& primitive_bounds);
+
+	const std::vector<Node>& get_nodes() const { return nodes; }
+	const std::vector<Object*>& get_primitives() const { return primitives; }
+	const std::vector<uint32_t>& get_order() const { return order; }
+	size_t node_count() const { return nodes.size(); }
+	float sah_cost() const;
+	float sah_cost(const BVHNode::Settings& settings) const;
+
+	// 与 AABB::intersect 相同的 slab 测试，直接读分量 (避免 Vec3f::operator[] 的函数调用)
+	static bool slab_test(const Node& node, const Vec3f& orig, const Vec3f& inv_dir, float tmin, float tmax) {
+		float t0 = (node.min.x - orig.x) * inv_dir.x;
+		float t1 = (node.max.x - orig.x) * inv_dir.x;
+		if (inv_dir.x < 0.0f) std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin > tmax) return false;
+
+		t0 = (node.min.y - orig.y) * inv_dir.y;
+		t1 = (node.max.y - orig.y) * inv_dir.y;
+		if (inv_dir.y < 0.0f) std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin > tmax) return false;
+
+		t0 = (node.min.z - orig.z) * inv_dir.z;
+		t1 = (node.max.z - orig.z) * inv_dir.z;
+		if (inv_dir.z < 0.0f) std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		return tmin <= tmax;
+	}
+
+private:
+	void build(const std::vector<AABB>& boxes, const BVHNode::Settings& settings, Builder builder);
+	void build_sah(const std::vector<AABB>& boxes, const BVHNode::Settings& settings);
+	int emit_sah(std::vector<BVHNode::BuildRef>& refs, size_t start, size_t end, int depth, const BVHNode::Settings& settings);
+	void build_hlbvh(const std::vector<AABB>& boxes, const BVHNode::Settings& settings);
+	int flatten(const BVHNode& node);
+
+	std::vector<Node> nodes;         // nodes[0] 是根
+	std::vector<Object*> primitives; // 按叶子顺序排列 (只按包围盒建的为空)
+	std::vector<uint32_t> order;     // 排序后第 i 个位置 -> 输入下标
+
+	// refit 用的分层顺序 (第一次 refit 时生成)：level_nodes[level_offsets[d], level_offsets[d + 1]) 是深度 d 的节点
+	std::vector<int> level_nodes;
+	std::vector<size_t> level_offsets;
+};
+
+template <typename LeafTest>
+bool LinearBVH::traverse(const Ray& r, float tmin, float tmax, LeafTest&& leaf_test) const {
+	if (nodes.empty()) return false;
+
+	const bool dir_negative[3] = { r.invDir.x < 0.0f, r.invDir.y < 0.0f, r.invDir.z < 0.0f };
+	// 每个内部节点最多压一个孩子，构建保证深度不超过 BVHNode::MAX_DEPTH
+	int stack[BVHNode::MAX_DEPTH];
+	int top = 0;
+	int current = 0;
+	bool hit = false;
+
+	while (true) {
+		const Node& node = nodes[current];
+		if (slab_test(node, r.orig, r.invDir, tmin, tmax)) {
+			if (node.count > 0) {
+				if (leaf_test((size_t)node.offset, (size_t)node.count, tmin, tmax)) hit = true;
+				if (top == 0) break;
+				current = stack[--top];
+			}
+			else if (dir_negative[node.axis]) {
+				// 光线沿切分轴负方向走：右孩子 (坐标偏大) 更近
+				stack[top++] = current + 1;
+				current = node.offset;
+			}
+			else {
+				stack[top++] = node.offset;
+				current = current + 1;
+			}
+		}
+		else {
+			if (top == 0) break;
+			current = stack[--top];
+		}
+	}
+	return hit;
+}
@@ -11,8 +11,22 @@ int main() {
 	//run_model_loading_test();
 	//TestCC::run_turntable_animation();
 	// TestCC::run_bezier_curve_test();
+	//TestCC::run_curve_flattening_test();
 	//TestCC::run_bezier_surface_test();
+	//TestCC::run_bezier_tessellation_benchmark();
+	//TestCC::run_adaptive_tessellation_test();
+	//TestCC::run_patch_mesh_test();
 	TestCC::run_ray_tracing_test();
+	//TestCC::run_bezier_ray_tracing_test();
+	//TestCC::run_bvh_benchmark();
+	//TestCC::run_bvh_refit_test();
+	//TestCC::run_triangle_mesh_test();
+	//TestCC::run_texture_layout_benchmark();
+	//TestCC::run_virtual_texture_test();
+	//TestCC::run_obj_loader_benchmark();
+	//TestCC::run_quantized_mesh_test();
+	//TestCC::run_streaming_mesh_test();
+	//TestCC::run_mesh_processing_test();
 
     return 0;
 }
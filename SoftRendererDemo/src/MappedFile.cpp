@@ -0,0 +1,157 @@
+﻿#include "MappedFile.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		swap(other);
+	}
+	return *this;
+}
+
+void MappedFile::swap(MappedFile& other) noexcept {
+	std::swap(ptr, other.ptr);
+	std::swap(length, other.length);
+#ifdef _WIN32
+	std::swap(file_handle, other.file_handle);
+	std::swap(mapping_handle, other.mapping_handle);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path, Access access) {
+	close();
+
+	// 缓存管理器按这个标志决定预读策略 (映射视图的缺页同样受影响)
+	DWORD hint = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | hint, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Failed to open file for mapping: " << path << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		std::cerr << "Cannot map empty file: " << path << std::endl;
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		std::cerr << "CreateFileMapping failed: " << path << std::endl;
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		std::cerr << "MapViewOfFile failed: " << path << std::endl;
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	if (access == Access::Sequential) {
+		// 顺序扫描：异步把整个文件读进页缓存 (不计入工作集)，之后的缺页不用再等磁盘
+		WIN32_MEMORY_RANGE_ENTRY range = { view, (SIZE_T)file_size.QuadPart };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	ptr = static_cast<const uint8_t*>(view);
+	length = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const {
+	if (!ptr || offset >= length) return;
+	bytes = std::min(bytes, length - offset);
+	// 对未锁定的页调用 VirtualUnlock 会把它们移出工作集 (只读映射的页是干净的，直接丢弃)
+	VirtualUnlock((LPVOID)(ptr + offset), bytes);
+}
+
+void MappedFile::close() {
+	if (ptr) UnmapViewOfFile(ptr);
+	if (mapping_handle) CloseHandle((HANDLE)mapping_handle);
+	if (file_handle) CloseHandle((HANDLE)file_handle);
+	ptr = nullptr;
+	length = 0;
+	file_handle = nullptr;
+	mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path, Access access) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Failed to open file for mapping: " << path << std::endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		std::cerr << "Cannot map empty file: " << path << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // 映射建立后文件描述符可以关闭
+	if (view == MAP_FAILED) {
+		std::cerr << "mmap failed: " << path << std::endl;
+		return false;
+	}
+	// 顺序扫描加大预读；随机访问 (按页表取 Tile) 关掉预读，免得每次缺页都多读一串用不上的页
+	madvise(view, (size_t)st.st_size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+	ptr = static_cast<const uint8_t*>(view);
+	length = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::release(size_t offset, size_t bytes) const {
+	if (!ptr || offset >= length) return;
+	bytes = std::min(bytes, length - offset);
+	// madvise 要求起点按页对齐：向内收缩到完整的页
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t begin = (offset + page - 1) / page * page;
+	size_t end = (offset + bytes) / page * page;
+	if (end > begin) madvise(const_cast<uint8_t*>(ptr) + begin, end - begin, MADV_DONTNEED);
+}
+
+void MappedFile::close() {
+	if (ptr) munmap(const_cast<uint8_t*>(ptr), length);
+	ptr = nullptr;
+	length = 0;
+}
+
+#endif
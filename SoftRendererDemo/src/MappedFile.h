@@ -0,0 +1,48 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ==========================================
+// 只读内存映射文件 (Win32: CreateFileMapping / POSIX: mmap)
+// ==========================================
+// 整个文件映射进地址空间，但物理内存由操作系统按页按需调入，
+// 因此几十 GB 的文件也可以直接当数组访问，真正占用的只有摸过的页。
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// 访问模式提示：决定操作系统是否预读
+	enum class Access {
+		Sequential, // 从头到尾扫描 (OBJ 解析、缓存拷贝、流式分块)：积极预读
+		Random      // 零散访问 (虚拟纹理按页表取 Tile)：关掉预读，只读摸到的页
+	};
+
+	// 打开并映射整个文件，失败返回 false (空文件也视为失败)
+	bool open(const std::string& path, Access access);
+	void close();
+
+	// 提示操作系统 [offset, offset + bytes) 暂时不再需要，可以从进程的工作集里换出
+	// 之后再访问会从页缓存/磁盘重新调入，内容不变 (流式读取时用来限制常驻内存)
+	void release(size_t offset, size_t bytes) const;
+
+	bool is_open() const { return ptr != nullptr; }
+	const uint8_t* data() const { return ptr; }
+	size_t size() const { return length; }
+
+private:
+	void swap(MappedFile& other) noexcept;
+
+	const uint8_t* ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,249 @@
+﻿#include "MeshCache.h"
+#include "MeshProcessing.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+// 磁盘上直接存放 Vec3f / Vec2f 的内存布局
+static_assert(sizeof(Vec3f) == 12 && sizeof(Vec2f) == 8, "Mesh cache expects tightly packed vectors");
+
+namespace {
+	const size_t HEADER_BYTES = 128;
+	const uint64_t ARRAY_ALIGN = 16;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t path_hash;      // 源文件路径 (FNV-1a)
+		uint64_t source_size;    // 源文件字节数
+		int64_t source_mtime;    // 源文件修改时间 (file_time_type 的计数)
+		uint32_t vertex_count;
+		uint32_t index_count;
+		float bounds_min[3];
+		float bounds_max[3];
+		uint64_t positions_offset;
+		uint64_t normals_offset;
+		uint64_t uvs_offset;
+		uint64_t indices_offset;
+		uint64_t file_size;
+	};
+	static_assert(sizeof(Header) <= HEADER_BYTES, "Header too large");
+
+	uint64_t fnv1a(const std::string& s) {
+		uint64_t h = 14695981039346656037ull;
+		for (unsigned char c : s) {
+			h ^= c;
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+
+	uint64_t align_up(uint64_t x) { return (x + ARRAY_ALIGN - 1) / ARRAY_ALIGN * ARRAY_ALIGN; }
+
+	// 源文件的身份：路径哈希 + 大小 + 修改时间
+	bool source_identity(const std::string& source_path, uint64_t& hash, uint64_t& size, int64_t& mtime) {
+		std::error_code ec;
+		std::filesystem::path p(source_path);
+		size = (uint64_t)std::filesystem::file_size(p, ec);
+		if (ec) return false;
+		auto time = std::filesystem::last_write_time(p, ec);
+		if (ec) return false;
+		mtime = (int64_t)time.time_since_epoch().count();
+		hash = fnv1a(std::filesystem::absolute(p, ec).lexically_normal().string());
+		return true;
+	}
+
+	// 按 Header 计算各数组的偏移
+	void layout(Header& h) {
+		h.positions_offset = HEADER_BYTES;
+		h.normals_offset = align_up(h.positions_offset + (uint64_t)h.vertex_count * sizeof(Vec3f));
+		h.uvs_offset = align_up(h.normals_offset + (uint64_t)h.vertex_count * sizeof(Vec3f));
+		h.indices_offset = align_up(h.uvs_offset + (uint64_t)h.vertex_count * sizeof(Vec2f));
+		h.file_size = h.indices_offset + (uint64_t)h.index_count * sizeof(int);
+	}
+}
+
+std::string MeshCache::cache_path(const std::string& source_path) {
+	return source_path + ".srmesh";
+}
+
+MeshBounds MeshCache::compute_bounds(const Mesh& mesh) {
+	return MeshProcessing::compute_bounds(mesh);
+}
+
+// ==========================================
+// 读取
+// ==========================================
+namespace {
+	// 读取并校验 Header 的结构 (不涉及源文件身份)
+	bool read_header(const MappedFile& file, Header& h) {
+		if (file.size() < HEADER_BYTES) return false;
+		std::memcpy(&h, file.data(), sizeof(Header));
+		if (h.magic != MeshCache::MAGIC || h.version != MeshCache::VERSION) return false;
+
+		Header expected = h;
+		layout(expected);
+		return expected.positions_offset == h.positions_offset && expected.normals_offset == h.normals_offset
+			&& expected.uvs_offset == h.uvs_offset && expected.indices_offset == h.indices_offset
+			&& expected.file_size == h.file_size && file.size() >= h.file_size;
+	}
+
+	bool matches_source(const Header& h, const std::string& source_path) {
+		uint64_t hash, size;
+		int64_t mtime;
+		if (!source_identity(source_path, hash, size, mtime)) return false;
+		return h.path_hash == hash && h.source_size == size && h.source_mtime == mtime;
+	}
+}
+
+bool MeshCache::is_fresh(const std::string& source_path) {
+	std::string path = cache_path(source_path);
+	std::error_code ec;
+	if (!std::filesystem::exists(path, ec)) return false;
+
+	MappedFile file;
+	Header h;
+	return file.open(path, MappedFile::Access::Sequential) && read_header(file, h) && matches_source(h, source_path);
+}
+
+bool MeshCache::map(const std::string& cache_file, MappedFile& file, View& view) {
+	if (!file.open(cache_file, MappedFile::Access::Sequential)) return false;
+
+	Header h;
+	if (!read_header(file, h)) {
+		std::cerr << "Error: Not a valid mesh cache: " << cache_file << std::endl;
+		file.close();
+		return false;
+	}
+
+	const uint8_t* base = file.data();
+	view.positions = (const Vec3f*)(base + h.positions_offset);
+	view.normals = (const Vec3f*)(base + h.normals_offset);
+	view.uvs = (const Vec2f*)(base + h.uvs_offset);
+	view.indices = (const int*)(base + h.indices_offset);
+	view.vertex_count = h.vertex_count;
+	view.index_count = h.index_count;
+	view.bounds.min = Vec3f(h.bounds_min[0], h.bounds_min[1], h.bounds_min[2]);
+	view.bounds.max = Vec3f(h.bounds_max[0], h.bounds_max[1], h.bounds_max[2]);
+	view.positions_offset = h.positions_offset;
+	view.normals_offset = h.normals_offset;
+	view.uvs_offset = h.uvs_offset;
+	view.indices_offset = h.indices_offset;
+	return true;
+}
+
+bool MeshCache::load(const std::string& source_path, Mesh& mesh, MeshBounds& bounds) {
+	std::string path = cache_path(source_path);
+	std::error_code ec;
+	if (!std::filesystem::exists(path, ec)) return false;
+
+	MappedFile file;
+	if (!file.open(path, MappedFile::Access::Sequential)) return false;
+
+	// 1. 校验 Header 与源文件身份
+	Header h;
+	if (file.size() >= HEADER_BYTES) std::memcpy(&h, file.data(), sizeof(Header));
+	if (file.size() < HEADER_BYTES || h.magic != MAGIC || h.version != VERSION) return false;
+	if (!matches_source(h, source_path)) return false;
+	if (!read_header(file, h)) {
+		std::cerr << "Warning: Corrupt mesh cache ignored: " << path << std::endl;
+		return false;
+	}
+
+	// 2. 整块拷贝 (映射区 -> vector)，没有任何解析
+	const uint8_t* base = file.data();
+	mesh.positions.resize(h.vertex_count);
+	mesh.normals.resize(h.vertex_count);
+	mesh.uvs.resize(h.vertex_count);
+	mesh.indices.resize(h.index_count);
+	std::memcpy(mesh.positions.data(), base + h.positions_offset, (size_t)h.vertex_count * sizeof(Vec3f));
+	std::memcpy(mesh.normals.data(), base + h.normals_offset, (size_t)h.vertex_count * sizeof(Vec3f));
+	std::memcpy(mesh.uvs.data(), base + h.uvs_offset, (size_t)h.vertex_count * sizeof(Vec2f));
+	std::memcpy(mesh.indices.data(), base + h.indices_offset, (size_t)h.index_count * sizeof(int));
+
+	// 3. 索引越界说明文件被截断或篡改，丢弃
+	for (int idx : mesh.indices) {
+		if (idx < 0 || (uint32_t)idx >= h.vertex_count) {
+			std::cerr << "Warning: Corrupt mesh cache ignored: " << path << std::endl;
+			mesh = Mesh();
+			return false;
+		}
+	}
+
+	bounds.min = Vec3f(h.bounds_min[0], h.bounds_min[1], h.bounds_min[2]);
+	bounds.max = Vec3f(h.bounds_max[0], h.bounds_max[1], h.bounds_max[2]);
+	return true;
+}
+
+// ==========================================
+// 写入
+// ==========================================
+bool MeshCache::save(const std::string& source_path, const Mesh& mesh, const MeshBounds& bounds) {
+	Header h = {};
+	h.magic = MAGIC;
+	h.version = VERSION;
+	if (!source_identity(source_path, h.path_hash, h.source_size, h.source_mtime)) return false;
+	if (mesh.normals.size() != mesh.positions.size() || mesh.uvs.size() != mesh.positions.size()) {
+		std::cerr << "Warning: Mesh cache requires per-vertex normals and uvs, skipped: " << source_path << std::endl;
+		return false;
+	}
+
+	h.vertex_count = (uint32_t)mesh.positions.size();
+	h.index_count = (uint32_t)mesh.indices.size();
+	for (int k = 0; k < 3; ++k) {
+		h.bounds_min[k] = bounds.min[k];
+		h.bounds_max[k] = bounds.max[k];
+	}
+	layout(h);
+
+	std::string path = cache_path(source_path);
+	std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cerr << "Warning: Cannot write mesh cache: " << path << std::endl;
+			return false;
+		}
+
+		// 按偏移顺序写出，中间用 0 填充对齐
+		uint64_t written = 0;
+		auto write_at = [&](uint64_t offset, const void* data, size_t bytes) {
+			static const char zeros[ARRAY_ALIGN] = {};
+			while (written < offset) {
+				size_t pad = (size_t)std::min<uint64_t>(offset - written, ARRAY_ALIGN);
+				out.write(zeros, (std::streamsize)pad);
+				written += pad;
+			}
+			out.write((const char*)data, (std::streamsize)bytes);
+			written += bytes;
+		};
+
+		char header_bytes[HEADER_BYTES] = {};
+		std::memcpy(header_bytes, &h, sizeof(Header));
+		write_at(0, header_bytes, HEADER_BYTES);
+		write_at(h.positions_offset, mesh.positions.data(), mesh.positions.size() * sizeof(Vec3f));
+		write_at(h.normals_offset, mesh.normals.data(), mesh.normals.size() * sizeof(Vec3f));
+		write_at(h.uvs_offset, mesh.uvs.data(), mesh.uvs.size() * sizeof(Vec2f));
+		write_at(h.indices_offset, mesh.indices.data(), mesh.indices.size() * sizeof(int));
+
+		if (!out) {
+			std::cerr << "Warning: Failed to write mesh cache: " << path << std::endl;
+			out.close();
+			std::error_code ec;
+			std::filesystem::remove(tmp_path, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec) {
+		std::cerr << "Warning: Cannot replace mesh cache: " << path << " (" << ec.message() << ")" << std::endl;
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include "Geometry.h"
+#include "MappedFile.h"
+
+// 包围盒 (Mesh 空间)
+struct MeshBounds {
+	Vec3f min = Vec3f(0, 0, 0);
+	Vec3f max = Vec3f(0, 0, 0);
+};
+
+// ==========================================
+// 二进制 Mesh 缓存 (.srmesh)
+// ==========================================
+// 第一次加载 OBJ 后把结果写到 "<源文件>.srmesh"，之后直接映射读取，不再做任何文本解析。
+// 文件布局 (小端)：
+//   [Header 128 字节][positions][normals][uvs][indices]
+//   每个数组都从 16 字节对齐的偏移开始，偏移记录在 Header 里
+// 缓存按 (源文件路径哈希, 大小, 修改时间) 校验，任一不匹配即视为失效并重新生成。
+class MeshCache {
+public:
+	// 缓存文件路径
+	static std::string cache_path(const std::string& source_path);
+
+	// 读取缓存：缓存不存在或已失效返回 false (不输出错误)
+	static bool load(const std::string& source_path, Mesh& mesh, MeshBounds& bounds);
+
+	// 缓存是否存在且与源文件匹配
+	static bool is_fresh(const std::string& source_path);
+
+	// 直接映射一个 .srmesh 文件，数组指针指向映射区 (不拷贝，不校验源文件)
+	// 指针在 file 关闭前有效；流式读取 (MeshStream) 用它按需访问超大网格
+	struct View {
+		const Vec3f* positions = nullptr;
+		const Vec3f* normals = nullptr;
+		const Vec2f* uvs = nullptr;
+		const int* indices = nullptr;
+		size_t vertex_count = 0;
+		size_t index_count = 0;
+		MeshBounds bounds;
+		// 数组在文件中的偏移 (用于 MappedFile::release)
+		uint64_t positions_offset = 0, normals_offset = 0, uvs_offset = 0, indices_offset = 0;
+	};
+	static bool map(const std::string& cache_file, MappedFile& file, View& view);
+
+	// 写入缓存 (先写临时文件再改名，避免留下半截文件)，失败只打印警告
+	static bool save(const std::string& source_path, const Mesh& mesh, const MeshBounds& bounds);
+
+	static MeshBounds compute_bounds(const Mesh& mesh);
+
+	static const uint32_t MAGIC = 0x534D5253; // "SRMS"
+	// 内容变化时递增，旧缓存按版本不符丢弃并重新解析
+	// 2: indices 经过 MeshOptimizer 重排
+	// 3: 缺失的法线由 MeshProcessing 生成 (之前填 (0, 1, 0))
+	static const uint32_t VERSION = 3;
+};
@@ -0,0 +1,188 @@
+﻿#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+
+float MeshOptimizer::compute_acmr(const std::vector<int>& indices, size_t vertex_count, int cache_size) {
+	if (indices.size() < 3) return 0.0f;
+
+	// FIFO：记录每个顶点进入缓存的时间戳，和当前时间差 < cache_size 即命中
+	std::vector<size_t> stamp(vertex_count, 0);
+	size_t time = (size_t)cache_size + 1;
+	size_t misses = 0;
+	for (int idx : indices) {
+		if (time - stamp[idx] > (size_t)cache_size) {
+			stamp[idx] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+// ==========================================
+// Tipsify
+// ==========================================
+std::vector<size_t> MeshOptimizer::optimize_vertex_cache(std::vector<int>& indices, size_t vertex_count, int cache_size) {
+	const size_t tri_count = indices.size() / 3;
+	std::vector<size_t> clusters;
+	if (tri_count == 0) return clusters;
+
+	// 1. 顶点 -> 三角形邻接表 (CSR)
+	std::vector<int> live(vertex_count, 0); // 每个顶点还没输出的三角形数
+	for (size_t i = 0; i < tri_count * 3; ++i) live[indices[i]]++;
+	std::vector<size_t> adj_offset(vertex_count + 1, 0);
+	for (size_t v = 0; v < vertex_count; ++v) adj_offset[v + 1] = adj_offset[v] + live[v];
+	std::vector<int> adj(adj_offset[vertex_count]);
+	{
+		std::vector<size_t> cursor(adj_offset.begin(), adj_offset.end() - 1);
+		for (size_t t = 0; t < tri_count; ++t) {
+			for (int k = 0; k < 3; ++k) adj[cursor[indices[t * 3 + k]]++] = (int)t;
+		}
+	}
+
+	// 2. 扇出
+	const size_t k = (size_t)cache_size;
+	std::vector<size_t> stamp(vertex_count, 0);
+	size_t time = k + 1;
+	std::vector<char> emitted(tri_count, 0);
+	std::vector<int> dead_end;      // 最近输出过的顶点，死胡同时优先回到这里
+	std::vector<int> candidates;
+	std::vector<int> output;
+	output.reserve(tri_count * 3);
+	size_t scan = 0;                // 死胡同栈也空了时，按编号顺序找下一个还有剩余三角形的顶点
+
+	auto skip_dead_end = [&]() -> int {
+		while (!dead_end.empty()) {
+			int d = dead_end.back();
+			dead_end.pop_back();
+			if (live[d] > 0) return d;
+		}
+		while (scan < vertex_count) {
+			if (live[scan] > 0) return (int)scan;
+			scan++;
+		}
+		return -1;
+	};
+
+	int fan = 0;
+	while (fan >= 0 && live[fan] == 0) fan = (fan + 1 < (int)vertex_count) ? fan + 1 : -1;
+	clusters.push_back(0);
+
+	while (fan >= 0) {
+		// 输出 fan 的所有剩余三角形
+		candidates.clear();
+		for (size_t a = adj_offset[fan]; a < adj_offset[fan + 1]; ++a) {
+			int t = adj[a];
+			if (emitted[t]) continue;
+			emitted[t] = 1;
+			for (int c = 0; c < 3; ++c) {
+				int v = indices[t * 3 + c];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - stamp[v] > k) stamp[v] = time++;
+			}
+		}
+
+		// 选下一个扇心：还在缓存里、且扇出后不会把自己挤出缓存的顶点中，最老的那个
+		int next = -1;
+		int best = -1;
+		for (int v : candidates) {
+			if (live[v] <= 0) continue;
+			int priority = 0;
+			if (time - stamp[v] + 2 * (size_t)live[v] <= k) priority = (int)(time - stamp[v]);
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+		if (next < 0) {
+			// 死胡同：这里形成簇的边界
+			next = skip_dead_end();
+			if (next >= 0) clusters.push_back(output.size() / 3);
+		}
+		fan = next;
+	}
+
+	indices.swap(output);
+	return clusters;
+}
+
+// ==========================================
+// Overdraw：簇排序
+// ==========================================
+void MeshOptimizer::optimize_overdraw(std::vector<int>& indices, const std::vector<Vec3f>& positions, const std::vector<size_t>& clusters) {
+	const size_t tri_count = indices.size() / 3;
+	if (clusters.size() < 2) return;
+
+	// 1. 合并过小的簇：几个三角形的簇排序意义不大，反而会打碎缓存顺序
+	const size_t min_cluster_tris = 64;
+	std::vector<size_t> starts;
+	for (size_t c : clusters) {
+		if (starts.empty() || c - starts.back() >= min_cluster_tris) starts.push_back(c);
+	}
+	if (starts.size() > 1 && tri_count - starts.back() < min_cluster_tris) starts.pop_back();
+	if (starts.size() < 2) return;
+
+	// 2. 网格中心 (按面积加权的三角形重心)
+	auto tri_centroid = [&](size_t t) {
+		return (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) * (1.0f / 3.0f);
+	};
+	auto tri_area_normal = [&](size_t t) {
+		const Vec3f& a = positions[indices[t * 3]];
+		return (positions[indices[t * 3 + 1]] - a).cross(positions[indices[t * 3 + 2]] - a);
+	};
+
+	Vec3f mesh_center(0, 0, 0);
+	float total_area = 0.0f;
+	for (size_t t = 0; t < tri_count; ++t) {
+		float area = tri_area_normal(t).length();
+		mesh_center = mesh_center + tri_centroid(t) * area;
+		total_area += area;
+	}
+	if (total_area > 0.0f) mesh_center = mesh_center * (1.0f / total_area);
+
+	// 3. 每个簇的排序键
+	const size_t cluster_count = starts.size();
+	std::vector<float> keys(cluster_count);
+	for (size_t c = 0; c < cluster_count; ++c) {
+		size_t begin = starts[c], end = (c + 1 < cluster_count) ? starts[c + 1] : tri_count;
+		Vec3f center(0, 0, 0), normal(0, 0, 0);
+		float area_sum = 0.0f;
+		for (size_t t = begin; t < end; ++t) {
+			Vec3f n = tri_area_normal(t);
+			float area = n.length();
+			center = center + tri_centroid(t) * area;
+			normal = normal + n;
+			area_sum += area;
+		}
+		if (area_sum > 0.0f) center = center * (1.0f / area_sum);
+		keys[c] = (center - mesh_center).dot(normal);
+	}
+
+	// 4. 朝外的簇先画 (稳定排序保证结果确定)
+	std::vector<size_t> order(cluster_count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<int> sorted;
+	sorted.reserve(indices.size());
+	for (size_t c : order) {
+		size_t begin = starts[c], end = (c + 1 < cluster_count) ? starts[c + 1] : tri_count;
+		sorted.insert(sorted.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+	}
+	indices.swap(sorted);
+}
+
+MeshOptimizer::Stats MeshOptimizer::optimize(Mesh& mesh, int cache_size) {
+	Stats stats;
+	const size_t vertex_count = mesh.positions.size();
+	stats.acmr_before = compute_acmr(mesh.indices, vertex_count, cache_size);
+
+	std::vector<size_t> clusters = optimize_vertex_cache(mesh.indices, vertex_count, cache_size);
+	optimize_overdraw(mesh.indices, mesh.positions, clusters);
+
+	stats.clusters = clusters.size();
+	stats.acmr_after = compute_acmr(mesh.indices, vertex_count, cache_size);
+	return stats;
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+#include <cstddef>
+#include <vector>
+#include "Geometry.h"
+
+// ==========================================
+// 三角形重排：顶点缓存 + Overdraw
+// ==========================================
+// 1. 顶点缓存优化 (Tipsify, Sander et al. 2007)
+//    以顶点为中心逐个"扇出"相邻三角形，下一个扇心优先选还留在缓存里的顶点，
+//    线性时间，结果接近 Forsyth 但快得多。
+// 2. Overdraw 优化
+//    Tipsify 走进死胡同时会跳到远处重新开始，这些位置把三角形分成若干簇 (Cluster)。
+//    簇内保持缓存友好的顺序，簇之间按"朝外程度"排序：
+//    dot(簇中心 - 网格中心, 簇法线) 越大越靠外，越先画，越容易挡住后画的内部三角形。
+// 只改变 indices 的顺序，不改顶点数据。
+class MeshOptimizer {
+public:
+	struct Stats {
+		float acmr_before = 0.0f; // 平均每个三角形的缓存未命中数 (越小越好，下限约 0.5)
+		float acmr_after = 0.0f;
+		size_t clusters = 0;
+	};
+
+	static const int DEFAULT_CACHE_SIZE = 16;
+
+	// ACMR (Average Cache Miss Ratio)：用 FIFO 缓存模拟顶点着色器的后变换缓存
+	static float compute_acmr(const std::vector<int>& indices, size_t vertex_count, int cache_size = DEFAULT_CACHE_SIZE);
+
+	// 顶点缓存优化，原地重排 indices；返回每个簇的起始三角形编号 (第一个总是 0)
+	static std::vector<size_t> optimize_vertex_cache(std::vector<int>& indices, size_t vertex_count, int cache_size = DEFAULT_CACHE_SIZE);
+
+	// 按簇排序降低 Overdraw，clusters 为 optimize_vertex_cache 的返回值
+	static void optimize_overdraw(std::vector<int>& indices, const std::vector<Vec3f>& positions, const std::vector<size_t>& clusters);
+
+	// 两步一起做，返回优化前后的 ACMR
+	static Stats optimize(Mesh& mesh, int cache_size = DEFAULT_CACHE_SIZE);
+};
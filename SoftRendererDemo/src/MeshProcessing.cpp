@@ -0,0 +1,231 @@
+﻿#include "MeshProcessing.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace {
+	// 顶点 -> 三角形邻接表 (CSR)
+	struct Adjacency {
+		std::vector<size_t> offsets; // 大小 vertex_count + 1
+		std::vector<int> triangles;
+	};
+
+	Adjacency build_adjacency(const Mesh& mesh) {
+		ThreadPool& pool = ThreadPool::instance();
+		const size_t vertex_count = mesh.positions.size();
+		const size_t tri_count = mesh.indices.size() / 3;
+
+		// 1. 并行计数
+		std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[vertex_count]);
+		pool.parallel_for(vertex_count, 0, [&](size_t b, size_t e) {
+			for (size_t v = b; v < e; ++v) counts[v].store(0, std::memory_order_relaxed);
+		});
+		pool.parallel_for(tri_count, 0, [&](size_t b, size_t e) {
+			for (size_t t = b; t < e; ++t) {
+				for (int k = 0; k < 3; ++k) counts[mesh.indices[t * 3 + k]].fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+
+		// 2. 前缀和
+		Adjacency adj;
+		adj.offsets.resize(vertex_count + 1);
+		adj.offsets[0] = 0;
+		for (size_t v = 0; v < vertex_count; ++v) adj.offsets[v + 1] = adj.offsets[v] + counts[v].load(std::memory_order_relaxed);
+
+		// 3. 并行填充 (复用计数器作为写游标)，再把每个顶点的列表排序，保证求和顺序确定
+		adj.triangles.resize(adj.offsets[vertex_count]);
+		pool.parallel_for(vertex_count, 0, [&](size_t b, size_t e) {
+			for (size_t v = b; v < e; ++v) counts[v].store(0, std::memory_order_relaxed);
+		});
+		pool.parallel_for(tri_count, 0, [&](size_t b, size_t e) {
+			for (size_t t = b; t < e; ++t) {
+				for (int k = 0; k < 3; ++k) {
+					int v = mesh.indices[t * 3 + k];
+					adj.triangles[adj.offsets[v] + counts[v].fetch_add(1, std::memory_order_relaxed)] = (int)t;
+				}
+			}
+		});
+		pool.parallel_for(vertex_count, 0, [&](size_t b, size_t e) {
+			for (size_t v = b; v < e; ++v) std::sort(adj.triangles.begin() + adj.offsets[v], adj.triangles.begin() + adj.offsets[v + 1]);
+		});
+		return adj;
+	}
+
+	bool indices_valid(const Mesh& mesh) {
+		for (int idx : mesh.indices) {
+			if (idx < 0 || (size_t)idx >= mesh.positions.size()) return false;
+		}
+		return true;
+	}
+
+	// 两个向量夹角 (输入无需归一化)
+	float angle_between(const Vec3f& a, const Vec3f& b) {
+		float la = a.length(), lb = b.length();
+		if (la <= 0.0f || lb <= 0.0f) return 0.0f;
+		return std::acos(std::clamp(a.dot(b) / (la * lb), -1.0f, 1.0f));
+	}
+}
+
+namespace MeshProcessing {
+	// ==========================================
+	// 顶点法线
+	// ==========================================
+	std::vector<Vec3f> vertex_normals(const Mesh& mesh, NormalWeighting weighting) {
+		ThreadPool& pool = ThreadPool::instance();
+		const size_t vertex_count = mesh.positions.size();
+		const size_t tri_count = mesh.indices.size() / 3;
+		std::vector<Vec3f> normals(vertex_count, Vec3f(0, 1, 0));
+		if (tri_count == 0 || !indices_valid(mesh)) return normals;
+
+		// 1. 每个三角形对三个角的贡献 (面法线 x 权重)
+		std::vector<Vec3f> corner(tri_count * 3);
+		pool.parallel_for(tri_count, 0, [&](size_t b, size_t e) {
+			for (size_t t = b; t < e; ++t) {
+				const Vec3f& p0 = mesh.positions[mesh.indices[t * 3]];
+				const Vec3f& p1 = mesh.positions[mesh.indices[t * 3 + 1]];
+				const Vec3f& p2 = mesh.positions[mesh.indices[t * 3 + 2]];
+				Vec3f n = (p1 - p0).cross(p2 - p0); // 模长 = 2 倍面积
+				if (weighting == NormalWeighting::Area) {
+					corner[t * 3] = corner[t * 3 + 1] = corner[t * 3 + 2] = n;
+				}
+				else {
+					// 近似退化的三角形 (例如球极点处) 法线方向不可信，夹角却可能很大，直接跳过
+					float len = n.length();
+					float edge_scale = (p1 - p0).length() * (p2 - p0).length();
+					Vec3f unit = len > 1e-5f * edge_scale ? n * (1.0f / len) : Vec3f(0, 0, 0);
+					corner[t * 3] = unit * angle_between(p1 - p0, p2 - p0);
+					corner[t * 3 + 1] = unit * angle_between(p2 - p1, p0 - p1);
+					corner[t * 3 + 2] = unit * angle_between(p0 - p2, p1 - p2);
+				}
+			}
+		});
+
+		// 2. 每个顶点收集相邻三角形中属于自己的那个角
+		Adjacency adj = build_adjacency(mesh);
+		pool.parallel_for(vertex_count, 0, [&](size_t b, size_t e) {
+			for (size_t v = b; v < e; ++v) {
+				Vec3f sum(0, 0, 0);
+				for (size_t a = adj.offsets[v]; a < adj.offsets[v + 1]; ++a) {
+					size_t t = (size_t)adj.triangles[a];
+					for (int k = 0; k < 3; ++k) {
+						if (mesh.indices[t * 3 + k] == (int)v) sum = sum + corner[t * 3 + k];
+					}
+				}
+				// 孤立顶点或退化三角形：保留默认朝上
+				if (sum.length() > 0.0f) normals[v] = sum.normalize();
+			}
+		});
+		return normals;
+	}
+
+	void compute_normals(Mesh& mesh, NormalWeighting weighting) {
+		mesh.normals = vertex_normals(mesh, weighting);
+	}
+
+	// ==========================================
+	// 切线 (Lengyel 方法)
+	// ==========================================
+	void compute_tangents(Mesh& mesh) {
+		ThreadPool& pool = ThreadPool::instance();
+		const size_t vertex_count = mesh.positions.size();
+		const size_t tri_count = mesh.indices.size() / 3;
+		mesh.tangents.assign(vertex_count, Vec4f(1, 0, 0, 1));
+		if (tri_count == 0 || mesh.uvs.size() != vertex_count || mesh.normals.size() != vertex_count || !indices_valid(mesh)) return;
+
+		// 1. 每个三角形的 dP/du 和 dP/dv (按面积自然加权，不归一化)
+		std::vector<Vec3f> tri_t(tri_count), tri_b(tri_count);
+		pool.parallel_for(tri_count, 0, [&](size_t b, size_t e) {
+			for (size_t t = b; t < e; ++t) {
+				int i0 = mesh.indices[t * 3], i1 = mesh.indices[t * 3 + 1], i2 = mesh.indices[t * 3 + 2];
+				Vec3f e1 = mesh.positions[i1] - mesh.positions[i0];
+				Vec3f e2 = mesh.positions[i2] - mesh.positions[i0];
+				float du1 = mesh.uvs[i1].x - mesh.uvs[i0].x, dv1 = mesh.uvs[i1].y - mesh.uvs[i0].y;
+				float du2 = mesh.uvs[i2].x - mesh.uvs[i0].x, dv2 = mesh.uvs[i2].y - mesh.uvs[i0].y;
+				float det = du1 * dv2 - du2 * dv1;
+				if (std::abs(det) < 1e-12f) {
+					// UV 退化：不贡献
+					tri_t[t] = tri_b[t] = Vec3f(0, 0, 0);
+					continue;
+				}
+				float r = 1.0f / det;
+				tri_t[t] = (e1 * dv2 - e2 * dv1) * r;
+				tri_b[t] = (e2 * du1 - e1 * du2) * r;
+			}
+		});
+
+		// 2. 顶点收集 + Gram-Schmidt 正交化
+		Adjacency adj = build_adjacency(mesh);
+		pool.parallel_for(vertex_count, 0, [&](size_t b, size_t e) {
+			for (size_t v = b; v < e; ++v) {
+				Vec3f t_sum(0, 0, 0), b_sum(0, 0, 0);
+				for (size_t a = adj.offsets[v]; a < adj.offsets[v + 1]; ++a) {
+					t_sum = t_sum + tri_t[adj.triangles[a]];
+					b_sum = b_sum + tri_b[adj.triangles[a]];
+				}
+
+				const Vec3f& n = mesh.normals[v];
+				Vec3f tangent = t_sum - n * n.dot(t_sum);
+				if (tangent.length() <= 1e-12f) {
+					// 没有可用的 UV 方向：取任意一个与法线垂直的方向
+					Vec3f axis = std::abs(n.x) < 0.9f ? Vec3f(1, 0, 0) : Vec3f(0, 1, 0);
+					tangent = axis - n * n.dot(axis);
+				}
+				tangent = tangent.normalize();
+				float handedness = n.cross(tangent).dot(b_sum) < 0.0f ? -1.0f : 1.0f;
+				mesh.tangents[v] = Vec4f(tangent, handedness);
+			}
+		});
+	}
+
+	// ==========================================
+	// 包围盒 / 归一化
+	// ==========================================
+	MeshBounds compute_bounds(const Mesh& mesh) {
+		MeshBounds bounds;
+		const size_t n = mesh.positions.size();
+		if (n == 0) return bounds;
+
+		// 分块归约：每块一个局部包围盒，最后串行合并
+		ThreadPool& pool = ThreadPool::instance();
+		const size_t block = 1 << 16;
+		const size_t blocks = (n + block - 1) / block;
+		std::vector<MeshBounds> partial(blocks);
+		pool.parallel_for(blocks, 1, [&](size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				size_t begin = i * block, end = std::min(n, begin + block);
+				Vec3f lo = mesh.positions[begin], hi = lo;
+				for (size_t k = begin + 1; k < end; ++k) {
+					const Vec3f& p = mesh.positions[k];
+					lo = Vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+					hi = Vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+				}
+				partial[i].min = lo;
+				partial[i].max = hi;
+			}
+		});
+
+		bounds = partial[0];
+		for (const MeshBounds& p : partial) {
+			bounds.min = Vec3f(std::min(bounds.min.x, p.min.x), std::min(bounds.min.y, p.min.y), std::min(bounds.min.z, p.min.z));
+			bounds.max = Vec3f(std::max(bounds.max.x, p.max.x), std::max(bounds.max.y, p.max.y), std::max(bounds.max.z, p.max.z));
+		}
+		return bounds;
+	}
+
+	MeshBounds normalize(Mesh& mesh, float size) {
+		MeshBounds bounds = compute_bounds(mesh);
+		if (mesh.positions.empty()) return bounds;
+
+		Vec3f center = (bounds.min + bounds.max) * 0.5f;
+		Vec3f extent = bounds.max - bounds.min;
+		float max_dim = std::max(extent.x, std::max(extent.y, extent.z));
+		float scale = max_dim > 0.0f ? size / max_dim : 1.0f;
+
+		ThreadPool::instance().parallel_for(mesh.positions.size(), 0, [&](size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) mesh.positions[i] = (mesh.positions[i] - center) * scale;
+		});
+		return bounds;
+	}
+}
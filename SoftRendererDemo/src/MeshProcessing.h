@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <vector>
+#include "Geometry.h"
+#include "MeshCache.h" // MeshBounds
+
+// ==========================================
+// Mesh 预处理 (并行)
+// ==========================================
+// 所有操作都是对 Mesh 数组的整体并行遍历 (ThreadPool::instance())：
+//   - 顶点法线：先并行算每个三角形的加权面法线，再通过 "顶点 -> 三角形" 邻接表 (CSR)
+//     由每个顶点自己去收集 (Gather)，不需要原子加法；邻接表内按三角形编号排序，结果与线程数无关
+//   - 切线：同样的 Gather 结构，UV 退化的三角形不参与
+//   - 包围盒：分块归约
+//   - 归一化：平移到原点并缩放到给定尺寸
+namespace MeshProcessing {
+	enum class NormalWeighting {
+		Area,  // 按面积加权 (面法线叉积的模长本身就是 2 倍面积)
+		Angle  // 按顶点处的夹角加权 (对三角形剖分方式不敏感)
+	};
+
+	// 计算顶点法线 (不修改 mesh)
+	std::vector<Vec3f> vertex_normals(const Mesh& mesh, NormalWeighting weighting = NormalWeighting::Angle);
+
+	// 计算并覆盖 mesh.normals
+	void compute_normals(Mesh& mesh, NormalWeighting weighting = NormalWeighting::Angle);
+
+	// 计算 mesh.tangents (xyz 为切线，w 为副切线的手性 ±1)；需要 normals 和 uvs
+	void compute_tangents(Mesh& mesh);
+
+	MeshBounds compute_bounds(const Mesh& mesh);
+
+	// 平移包围盒中心到原点，并把最长边缩放到 size；返回原来的包围盒
+	MeshBounds normalize(Mesh& mesh, float size = 2.0f);
+}
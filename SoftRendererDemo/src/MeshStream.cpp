@@ -0,0 +1,220 @@
+﻿#include "MeshStream.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	// 块内每个三角形的最坏开销：3 个独立顶点 (32 字节) + 3 个索引 + 重编号表
+	const size_t BYTES_PER_CHUNK_TRIANGLE = 3 * (32 + 4 + 16);
+
+	bool ends_with(const std::string& s, const std::string& suffix) {
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+}
+
+bool MeshStream::open(const std::string& path, size_t memory_budget) {
+	close();
+	source = path;
+	budget = memory_budget;
+
+	// 1. 块大小：块数据占预算的 1/4，剩下留给常驻数据和映射窗口
+	chunk_tris = std::max<size_t>(1024, budget / 4 / BYTES_PER_CHUNK_TRIANGLE);
+	window_bytes = std::clamp<size_t>(budget / 8, 1 << 20, 64 << 20);
+
+	// 2. 选择数据源：.srmesh > 新鲜的缓存 > OBJ 文本
+	if (ends_with(path, ".srmesh")) {
+		binary = MeshCache::map(path, file, view);
+		if (!binary) return false;
+	}
+	else if (MeshCache::is_fresh(path)) {
+		binary = MeshCache::map(MeshCache::cache_path(path), file, view);
+		if (!binary) return false;
+	}
+	else if (!file.open(path, MappedFile::Access::Sequential)) {
+		std::cerr << "Error: Failed to open mesh stream " << path << std::endl;
+		return false;
+	}
+
+	std::cout << "Mesh stream opened: " << path << (binary ? " (binary" : " (obj")
+		<< ", " << chunk_tris << " tris/chunk)" << std::endl;
+	return true;
+}
+
+void MeshStream::close() {
+	file.close();
+	view = MeshCache::View();
+	binary = false;
+	chunk_tris = 0;
+	tris_read = 0;
+	peak_bytes = 0;
+	warned_budget = false;
+	rewind();
+}
+
+void MeshStream::rewind() {
+	tris_read = 0;
+	index_cursor = 0;
+	byte_cursor = 0;
+	std::vector<Vec3f>().swap(obj_positions);
+	std::vector<Vec3f>().swap(obj_normals);
+	std::vector<Vec2f>().swap(obj_uvs);
+	std::vector<Model::ObjIndex>().swap(pending);
+	pending_head = 0;
+	remap.clear();
+	obj_remap.clear();
+}
+
+bool MeshStream::next(Mesh& chunk) {
+	if (!file.is_open()) return false;
+	return binary ? next_binary(chunk) : next_obj(chunk);
+}
+
+size_t MeshStream::resident_bytes() const {
+	size_t bytes = obj_positions.capacity() * sizeof(Vec3f) + obj_normals.capacity() * sizeof(Vec3f)
+		+ obj_uvs.capacity() * sizeof(Vec2f) + pending.capacity() * sizeof(Model::ObjIndex);
+	// 哈希表按每个节点约 32 字节估算
+	bytes += (remap.size() + obj_remap.size()) * 32;
+	return bytes;
+}
+
+void MeshStream::track_peak(const Mesh& chunk) {
+	size_t bytes = resident_bytes()
+		+ chunk.positions.capacity() * sizeof(Vec3f) + chunk.normals.capacity() * sizeof(Vec3f)
+		+ chunk.uvs.capacity() * sizeof(Vec2f) + chunk.indices.capacity() * sizeof(int);
+	peak_bytes = std::max(peak_bytes, bytes);
+}
+
+// ==========================================
+// .srmesh：按索引区间出块
+// ==========================================
+bool MeshStream::next_binary(Mesh& chunk) {
+	if (index_cursor + 3 > view.index_count) return false;
+
+	size_t begin = index_cursor;
+	size_t end = std::min(view.index_count, begin + chunk_tris * 3);
+	end -= (end - begin) % 3;
+
+	chunk.positions.clear();
+	chunk.normals.clear();
+	chunk.uvs.clear();
+	chunk.indices.clear();
+	remap.clear();
+
+	// 1. 块内重新编号：同一块里共享的顶点只拷贝一次
+	for (size_t i = begin; i < end; i += 3) {
+		int g[3] = { view.indices[i], view.indices[i + 1], view.indices[i + 2] };
+		if (g[0] < 0 || g[1] < 0 || g[2] < 0 || (size_t)g[0] >= view.vertex_count
+			|| (size_t)g[1] >= view.vertex_count || (size_t)g[2] >= view.vertex_count) {
+			continue; // 损坏的三角形直接跳过
+		}
+		for (int k = 0; k < 3; ++k) {
+			auto it = remap.find(g[k]);
+			if (it == remap.end()) {
+				it = remap.emplace(g[k], (int)chunk.positions.size()).first;
+				chunk.positions.push_back(view.positions[g[k]]);
+				chunk.normals.push_back(view.normals[g[k]]);
+				chunk.uvs.push_back(view.uvs[g[k]]);
+			}
+			chunk.indices.push_back(it->second);
+		}
+	}
+	index_cursor = end;
+	tris_read += (end - begin) / 3;
+	track_peak(chunk);
+
+	// 2. 归还已经读过的索引页；顶点数组超过预算的一半时也一并归还 (之后按需重新调入)
+	file.release((size_t)view.indices_offset + begin * sizeof(int), (end - begin) * sizeof(int));
+	size_t vertex_bytes = view.vertex_count * (sizeof(Vec3f) * 2 + sizeof(Vec2f));
+	if (vertex_bytes > budget / 2) {
+		file.release((size_t)view.positions_offset, (size_t)(view.indices_offset - view.positions_offset));
+	}
+	return true;
+}
+
+// ==========================================
+// .obj：窗口解析 + 出块
+// ==========================================
+bool MeshStream::parse_obj_window() {
+	const char* data = (const char*)file.data();
+	const size_t size = file.size();
+	if (byte_cursor >= size) return false;
+
+	// 1. 窗口边界挪到换行之后
+	size_t end = std::min(size, byte_cursor + window_bytes);
+	if (end < size) {
+		const char* nl = (const char*)std::memchr(data + end, '\n', size - end);
+		end = nl ? (size_t)(nl - data) + 1 : size;
+	}
+
+	Model::ObjChunk parsed;
+	Model::parse_obj_chunk(data + byte_cursor, data + end, parsed);
+
+	// 2. 相对索引按窗口开始前的属性数量修正 (与 Model 的并行合并相同)
+	size_t base_p = obj_positions.size(), base_t = obj_uvs.size(), base_n = obj_normals.size();
+	for (uint32_t r : parsed.relative) {
+		Model::ObjIndex& idx = parsed.corners[r / 3];
+		int& field = (r % 3 == 0) ? idx.p : (r % 3 == 1) ? idx.t : idx.n;
+		size_t base = (r % 3 == 0) ? base_p : (r % 3 == 1) ? base_t : base_n;
+		field += (int)base;
+		if (field < 0) field = -1;
+	}
+
+	obj_positions.insert(obj_positions.end(), parsed.positions.begin(), parsed.positions.end());
+	obj_uvs.insert(obj_uvs.end(), parsed.uvs.begin(), parsed.uvs.end());
+	obj_normals.insert(obj_normals.end(), parsed.normals.begin(), parsed.normals.end());
+
+	// 已输出的面顶点从队列头部挪走，避免队列无限增长
+	if (pending_head > 0) {
+		pending.erase(pending.begin(), pending.begin() + pending_head);
+		pending_head = 0;
+	}
+	pending.insert(pending.end(), parsed.corners.begin(), parsed.corners.end());
+
+	// 3. 文本窗口解析完就不再需要
+	file.release(byte_cursor, end - byte_cursor);
+	byte_cursor = end;
+
+	if (!warned_budget && resident_bytes() > budget) {
+		std::cerr << "Warning: OBJ vertex attributes exceed the streaming budget (" << resident_bytes() / (1024 * 1024)
+			<< " MB); convert to .srmesh for true out-of-core streaming: " << source << std::endl;
+		warned_budget = true;
+	}
+	return true;
+}
+
+bool MeshStream::next_obj(Mesh& chunk) {
+	// 1. 凑够一块的面顶点
+	const size_t want = chunk_tris * 3;
+	while (pending.size() - pending_head < want && parse_obj_window()) {
+	}
+	size_t available = pending.size() - pending_head;
+	available -= available % 3;
+	if (available == 0) return false;
+	size_t take = std::min(want, available);
+
+	chunk.positions.clear();
+	chunk.normals.clear();
+	chunk.uvs.clear();
+	chunk.indices.clear();
+	obj_remap.clear();
+	missing_normal.clear();
+
+	// 2. 按 (p, t, n) 块内去重，越界索引和缺失属性的处理与 Model::build_mesh 共用
+	for (size_t i = pending_head; i < pending_head + take; ++i) {
+		const Model::ObjIndex idx = Model::sanitize(pending[i], obj_positions.size(), obj_uvs.size(), obj_normals.size());
+		auto it = obj_remap.find(idx);
+		if (it == obj_remap.end()) {
+			it = obj_remap.emplace(idx, (int)chunk.positions.size()).first;
+			Model::append_vertex(idx, obj_positions, obj_uvs, obj_normals, chunk, missing_normal);
+		}
+		chunk.indices.push_back(it->second);
+	}
+
+	// 3. 没有 vn 的顶点用生成的法线 (与 Model 相同)。只能看到本块的三角形，
+	//    块边界上的顶点只由块内相邻面加权，和整体生成的结果可能略有差别
+	Model::fill_missing_normals(chunk, missing_normal);
+	pending_head += take;
+	tris_read += take / 3;
+	track_peak(chunk);
+	return true;
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Geometry.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "Model.h"
+
+// ==========================================
+// 流式 Mesh 读取 (Out-of-core)
+// ==========================================
+// 超大网格不整体进内存：按固定三角形数切成小块，每块 读取 -> 变换/光栅化 -> 丢弃。
+// 每块都是一个独立的小 Mesh (块内重新编号，共享顶点只存一份)，可以直接 bind_mesh_to_shader。
+//
+// 数据源：
+// 1. .srmesh (MeshCache 格式)：真正的 Out-of-core。整个文件只是映射，
+//    每块按索引区间读取需要的顶点，读完就把对应的页还给操作系统。
+// 2. .obj：单遍扫描，按窗口解析面并立即出块；但 OBJ 的面可以引用前面任意位置的顶点，
+//    所以 v/vt/vn 属性必须常驻 (通常只占展开后数据的一小部分)。
+//    如果存在新鲜的 "<obj>.srmesh" 缓存，会自动改用它。
+class MeshStream {
+public:
+	static const size_t DEFAULT_BUDGET = 256ull * 1024 * 1024;
+
+	// 打开文件；memory_budget 决定每块的三角形数 (块数据 + 常驻数据不超过预算)
+	bool open(const std::string& path, size_t memory_budget = DEFAULT_BUDGET);
+	void close();
+
+	// 读取下一块 (chunk 会被覆盖，复用其容量)；没有剩余数据时返回 false
+	bool next(Mesh& chunk);
+
+	// 从头再读一遍
+	void rewind();
+
+	bool is_binary() const { return binary; }
+	size_t chunk_triangles() const { return chunk_tris; }
+
+	// 已输出的三角形数 / 总三角形数 (OBJ 在读完之前总数未知，返回 0)
+	size_t triangles_read() const { return tris_read; }
+	size_t triangle_count() const { return binary ? view.index_count / 3 : 0; }
+
+	// 当前常驻的字节数 (不含映射区里尚未归还的页)
+	size_t resident_bytes() const;
+	size_t peak_resident_bytes() const { return peak_bytes; }
+
+private:
+	bool next_binary(Mesh& chunk);
+	bool next_obj(Mesh& chunk);
+	// 解析下一个 OBJ 窗口，把属性追加到常驻数组、面顶点追加到待输出队列
+	bool parse_obj_window();
+	void track_peak(const Mesh& chunk);
+
+	std::string source;
+	size_t budget = DEFAULT_BUDGET;
+	size_t chunk_tris = 0;
+	size_t tris_read = 0;
+	size_t peak_bytes = 0;
+	bool binary = false;
+
+	MappedFile file;
+
+	// .srmesh
+	MeshCache::View view;
+	size_t index_cursor = 0;
+	std::unordered_map<int, int> remap; // 全局顶点 -> 块内顶点
+
+	// .obj
+	size_t byte_cursor = 0;
+	size_t window_bytes = 0;
+	std::vector<Vec3f> obj_positions;
+	std::vector<Vec3f> obj_normals;
+	std::vector<Vec2f> obj_uvs;
+	std::vector<Model::ObjIndex> pending; // 已解析、尚未输出的面顶点
+	std::vector<char> missing_normal;     // 当前块里没有 vn 的顶点 (复用容量)
+	size_t pending_head = 0;
+	bool warned_budget = false;
+	std::unordered_map<Model::ObjIndex, int, Model::ObjIndexHash> obj_remap;
+};
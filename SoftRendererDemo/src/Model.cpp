@@ -3,9 +3,42 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include "MeshProcessing.h"
+#include "FrameArena.h"
 
-Model::Model(const std::string& filepath) {
-	load_obj(filepath);
+Model::Model(const std::string& filepath, ObjParser parser, bool use_cache, bool optimize) {
+	// 1. 二进制缓存命中：直接拷贝数组，跳过文本解析
+	if (use_cache && MeshCache::load(filepath, _mesh, _bounds)) {
+		std::cout << "Model loaded from cache: " << MeshCache::cache_path(filepath)
+			<< " (" << _mesh.indices.size() / 3 << " tris, " << _mesh.positions.size() << " verts)" << std::endl;
+		return;
+	}
+
+	// 2. 解析 OBJ
+	if (parser == ObjParser::Parallel) {
+		load_obj_parallel(filepath);
+	}
+	else {
+		load_obj(filepath);
+	}
+	_bounds = MeshCache::compute_bounds(_mesh);
+
+	// 3. 三角形重排 (顶点缓存 + Overdraw)，结果随缓存一起保存，下次不用再做
+	if (optimize && !_mesh.indices.empty()) {
+		MeshOptimizer::Stats stats = MeshOptimizer::optimize(_mesh);
+		std::cout << "Model optimized: ACMR " << stats.acmr_before << " -> " << stats.acmr_after
+			<< " (" << stats.clusters << " clusters)" << std::endl;
+	}
+
+	// 4. 写缓存供下次使用 (加载失败或没有重排时不写)
+	if (use_cache && optimize && !_mesh.indices.empty()) {
+		MeshCache::save(filepath, _mesh, _bounds);
+	}
 }
 
 // 辅助函数：简单的字符串分割
@@ -29,10 +62,7 @@ void Model::load_obj(const std::string& filepath) {
 	_raw_positions.reserve(10000);
 	_raw_normals.reserve(10000);
 	_raw_uvs.reserve(10000);
-	_mesh.positions.reserve(_raw_positions.size() * 2);
-	_mesh.normals.reserve(_raw_positions.size() * 2);
-	_mesh.uvs.reserve(_raw_positions.size() * 2);
-	_mesh.indices.reserve(_raw_positions.size() * 6);
+	std::vector<ObjIndex> corners; // 三角化后的面顶点
 
 	std::string line;
 	while (std::getline(file, line)) {
@@ -64,7 +94,8 @@ void Model::load_obj(const std::string& filepath) {
 		}
 		// 4. 解析面 f v1/vt1/vn1 v2/vt2/vn2 ...
 		else if (prefix == "f") {
-			std::vector<ObjIndex> face_indices;
+			ScratchScope scratch; // 每个面的临时索引，处理完即回收
+			std::pmr::vector<ObjIndex> face_indices(scratch.resource());
 			std::string token;
 
 			// 读取该面包含的所有顶点索引块
@@ -80,48 +111,313 @@ void Model::load_obj(const std::string& filepath) {
 				ObjIndex idx1 = face_indices[i];
 				ObjIndex idx2 = face_indices[i + 1];
 
-				// 构建三个顶点
-				ObjIndex tri_indices[3] = { idx0, idx1, idx2 };
+				corners.push_back(idx0);
+				corners.push_back(idx1);
+				corners.push_back(idx2);
+			}
+		}
+	}
 
-				for (int k = 0; k < 3; ++k) {
-					ObjIndex idx = tri_indices[k];
+	build_mesh(corners);
 
-					// --- 处理 Position ---
-					// OBJ 索引从 1 开始，记得 -1
-					if (idx.p >= 0 && idx.p < _raw_positions.size()) {
-						_mesh.positions.push_back(_raw_positions[idx.p]);
-					}
-					else {
-						_mesh.positions.push_back(Vec3f(0, 0, 0)); // 容错
-					}
+	std::cout << "Model loaded: " << filepath
+		<< " (" << _mesh.indices.size() / 3 << " tris, " << _mesh.positions.size() << " verts)" << std::endl;
+}
 
-					// --- 处理 UV ---
-					if (idx.t >= 0 && idx.t < _raw_uvs.size()) {
-						_mesh.uvs.push_back(_raw_uvs[idx.t]);
-					}
-					else {
-						_mesh.uvs.push_back(Vec2f(0, 0)); // 默认 UV
-					}
+void Model::append_vertex(const ObjIndex& idx, const std::vector<Vec3f>& positions, const std::vector<Vec2f>& uvs,
+	const std::vector<Vec3f>& normals, Mesh& out, std::vector<char>& missing_normal) {
+	out.positions.push_back(idx.p >= 0 ? positions[idx.p] : Vec3f(0, 0, 0)); // 容错
+	out.uvs.push_back(idx.t >= 0 ? uvs[idx.t] : Vec2f(0, 0));                 // 默认 UV
+	// 如果没有法线，暂时填个向上的，建完后用生成的顶点法线替换
+	out.normals.push_back(idx.n >= 0 ? normals[idx.n] : Vec3f(0, 1, 0));
+	missing_normal.push_back(idx.n < 0);
+}
+
+size_t Model::fill_missing_normals(Mesh& mesh, const std::vector<char>& missing_normal) {
+	if (std::find(missing_normal.begin(), missing_normal.end(), 1) == missing_normal.end()) return 0;
+	std::vector<Vec3f> generated = MeshProcessing::vertex_normals(mesh);
+	size_t count = 0;
+	for (size_t v = 0; v < generated.size(); ++v) {
+		if (!missing_normal[v]) continue;
+		mesh.normals[v] = generated[v];
+		++count;
+	}
+	return count;
+}
+
+// ==========================================
+// 去重：面顶点 -> 索引 Mesh
+// ==========================================
+// OBJ 的一个"顶点"是 (p, t, n) 三元组，相邻面共享的顶点会被反复引用。
+// 用哈希表把相同的三元组映射到同一个输出顶点，indices 才有真正的复用。
+// 哈希表是开放寻址 + 线性探测，容量为 2 的幂，装载因子 <= 0.5，避免 unordered_map 的逐节点分配。
+// 初始容量按输出顶点数的估计 (不超过原始 v / vt 数的若干倍) 而不是面顶点数分配，
+// 装满一半时翻倍重排：几千万个面顶点的扫描数据不会为最坏情况预先占用几 GB。
+void Model::build_mesh(const std::vector<ObjIndex>& corners) {
+	const ObjIndexHash hash;
+
+	// 输出顶点通常和 v / vt 中较多的那个数量相当 (接缝处略多)，上限是面顶点数
+	const size_t raw_count = std::max(_raw_positions.size(), _raw_uvs.size());
+	const size_t expected = std::min(corners.size(), raw_count + raw_count / 4);
+	size_t capacity = 16;
+	while (capacity < expected * 2) capacity <<= 1;
+	size_t mask = capacity - 1;
+	std::vector<ObjIndex> keys(capacity);
+	std::vector<int> slots(capacity, -1); // -1 表示空槽，否则是输出顶点编号
+
+	// 装载因子超过 0.5：容量翻倍，把已有的键重新放进新表
+	auto grow = [&]() {
+		std::vector<ObjIndex> old_keys = std::move(keys);
+		std::vector<int> old_slots = std::move(slots);
+		capacity *= 2;
+		mask = capacity - 1;
+		keys.assign(capacity, ObjIndex());
+		slots.assign(capacity, -1);
+		for (size_t i = 0; i < old_slots.size(); ++i) {
+			if (old_slots[i] < 0) continue;
+			size_t slot = hash(old_keys[i]) & mask;
+			while (slots[slot] >= 0) slot = (slot + 1) & mask;
+			keys[slot] = old_keys[i];
+			slots[slot] = old_slots[i];
+		}
+	};
+
+	_mesh.positions.clear();
+	_mesh.normals.clear();
+	_mesh.uvs.clear();
+	_mesh.indices.clear();
+	_mesh.indices.reserve(corners.size());
+	std::vector<char> missing_normal; // 没有 vn 的输出顶点，最后统一补
+
+	for (const ObjIndex& corner : corners) {
+		const ObjIndex idx = sanitize(corner, _raw_positions.size(), _raw_uvs.size(), _raw_normals.size());
+
+		// 1. 查表：已有相同的 (p, t, n) 直接复用
+		size_t slot = hash(idx) & mask;
+		while (slots[slot] >= 0) {
+			if (keys[slot] == idx) break;
+			slot = (slot + 1) & mask;
+		}
+		if (slots[slot] >= 0) {
+			_mesh.indices.push_back(slots[slot]);
+			continue;
+		}
+
+		// 2. 新顶点：按首次出现的顺序追加 (表满一半就先扩容，重新找槽)
+		if ((_mesh.positions.size() + 1) * 2 > capacity) {
+			grow();
+			slot = hash(idx) & mask;
+			while (slots[slot] >= 0) slot = (slot + 1) & mask;
+		}
+		keys[slot] = idx;
+		slots[slot] = (int)_mesh.positions.size();
+		_mesh.indices.push_back(slots[slot]);
+		append_vertex(idx, _raw_positions, _raw_uvs, _raw_normals, _mesh, missing_normal);
+	}
+
+	// 3. 补全缺失的法线
+	if (size_t generated = fill_missing_normals(_mesh, missing_normal)) {
+		std::cout << "Model: generated normals for " << generated << " verts" << std::endl;
+	}
 
-					// --- 处理 Normal ---
-					if (idx.n >= 0 && idx.n < _raw_normals.size()) {
-						_mesh.normals.push_back(_raw_normals[idx.n]);
+	// 4. 原始数组只在解析期间需要，建好 Mesh 后释放
+	std::vector<Vec3f>().swap(_raw_positions);
+	std::vector<Vec3f>().swap(_raw_normals);
+	std::vector<Vec2f>().swap(_raw_uvs);
+	_mesh.positions.shrink_to_fit();
+	_mesh.normals.shrink_to_fit();
+	_mesh.uvs.shrink_to_fit();
+}
+
+// ==========================================
+// 并行 OBJ 解析
+// ==========================================
+// 1. 整个文件内存映射，按换行切成若干块 (每块 >= 1MB)
+// 2. 每块独立解析：手写扫描 + std::from_chars，不构造任何临时字符串
+// 3. 按块的顺序合并：前缀和得到每块在总数组中的偏移，并行拷贝
+// 负数 (相对) 索引依赖于前面出现过的顶点数，块内先按块内计数解析，合并时再补偏移
+namespace {
+	inline const char* skip_blank(const char* p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+		return p;
+	}
+
+	inline bool parse_float(const char*& p, const char* end, float& out) {
+		p = skip_blank(p, end);
+		if (p < end && *p == '+') ++p; // from_chars 不接受前导 '+'
+		auto result = std::from_chars(p, end, out);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+
+	inline bool parse_int(const char*& p, const char* end, int& out) {
+		auto result = std::from_chars(p, end, out);
+		if (result.ec != std::errc()) return false;
+		p = result.ptr;
+		return true;
+	}
+}
+
+void Model::parse_obj_chunk(const char* begin, const char* end, ObjChunk& out) {
+	// 面顶点：索引 + 哪些分量是相对索引 (bit 0/1/2 = p/t/n)
+	struct Corner { ObjIndex idx; int relative = 0; };
+
+	// OBJ 索引：正数从 1 开始；负数相对于当前已出现的数量；0 非法
+	auto resolve = [](int value, size_t local_count, int& field, int bit, int& relative) {
+		if (value > 0) field = value - 1;
+		else if (value < 0) { field = (int)local_count + value; relative |= bit; }
+	};
+
+	auto emit = [&out](const Corner& c) {
+		for (int k = 0; k < 3; ++k) {
+			if (c.relative & (1 << k)) out.relative.push_back((uint32_t)(out.corners.size() * 3 + k));
+		}
+		out.corners.push_back(c.idx);
+	};
+
+	const char* p = begin;
+	while (p < end) {
+		const char* line_end = (const char*)std::memchr(p, '\n', end - p);
+		if (!line_end) line_end = end;
+
+		const char* q = skip_blank(p, line_end);
+		if (q + 1 < line_end && q[0] == 'v') {
+			// 1. 顶点数据 v / vt / vn (缺失的分量保持 0)
+			if (q[1] == ' ' || q[1] == '\t') {
+				q += 1;
+				Vec3f v(0, 0, 0);
+				parse_float(q, line_end, v.x) && parse_float(q, line_end, v.y) && parse_float(q, line_end, v.z);
+				out.positions.push_back(v);
+			}
+			else if (q[1] == 't') {
+				q += 2;
+				Vec2f t(0, 0);
+				parse_float(q, line_end, t.x) && parse_float(q, line_end, t.y);
+				out.uvs.push_back(t);
+			}
+			else if (q[1] == 'n') {
+				q += 2;
+				Vec3f n(0, 0, 0);
+				parse_float(q, line_end, n.x) && parse_float(q, line_end, n.y) && parse_float(q, line_end, n.z);
+				out.normals.push_back(n);
+			}
+		}
+		else if (q + 1 < line_end && q[0] == 'f' && (q[1] == ' ' || q[1] == '\t')) {
+			// 2. 面：边读边做扇形三角化 (0, i, i+1)，不需要临时数组
+			q += 1;
+			Corner first, prev;
+			int count = 0;
+			for (;;) {
+				q = skip_blank(q, line_end);
+				if (q >= line_end) break;
+
+				// 解析 "v", "v/vt", "v//vn", "v/vt/vn"
+				Corner c;
+				int value;
+				if (!parse_int(q, line_end, value)) break;
+				resolve(value, out.positions.size(), c.idx.p, 1, c.relative);
+				if (q < line_end && *q == '/') {
+					++q;
+					if (q < line_end && *q != '/' && parse_int(q, line_end, value)) {
+						resolve(value, out.uvs.size(), c.idx.t, 2, c.relative);
 					}
-					else {
-						// 如果没有法线，暂时填个向上的，或者之后重新计算
-						_mesh.normals.push_back(Vec3f(0, 1, 0));
+					if (q < line_end && *q == '/') {
+						++q;
+						if (parse_int(q, line_end, value)) {
+							resolve(value, out.normals.size(), c.idx.n, 4, c.relative);
+						}
 					}
+				}
+				// 跳过无法识别的尾巴，直到下一个空白
+				while (q < line_end && *q != ' ' && *q != '\t' && *q != '\r') ++q;
 
-					// --- 处理 Indices ---
-					// 因为我们是展平存储 (Flatten)，所以直接线性增加索引即可
-					_mesh.indices.push_back((int)_mesh.positions.size() - 1);
+				if (count == 0) first = c;
+				else if (count >= 2) {
+					emit(first);
+					emit(prev);
+					emit(c);
 				}
+				prev = c;
+				count++;
 			}
 		}
+
+		p = line_end + 1;
+	}
+}
+
+bool Model::load_obj_parallel(const std::string& filepath) {
+	MappedFile file;
+	if (!file.open(filepath, MappedFile::Access::Sequential)) {
+		std::cerr << "Error: Failed to load model " << filepath << std::endl;
+		return false;
+	}
+	const char* data = (const char*)file.data();
+	const size_t size = file.size();
+	ThreadPool& pool = ThreadPool::instance();
+
+	// 1. 切块：边界向后挪到下一个换行之后，保证每行完整地落在某一块里
+	const size_t min_chunk_bytes = 1 << 20;
+	size_t chunk_count = std::clamp<size_t>(size / min_chunk_bytes, 1, (size_t)pool.concurrency() * 4);
+	std::vector<size_t> bounds(chunk_count + 1, size);
+	bounds[0] = 0;
+	for (size_t i = 1; i < chunk_count; ++i) {
+		size_t pos = std::max(size / chunk_count * i, bounds[i - 1]);
+		const char* nl = pos < size ? (const char*)std::memchr(data + pos, '\n', size - pos) : nullptr;
+		bounds[i] = nl ? (size_t)(nl - data) + 1 : size;
 	}
 
+	// 2. 并行解析
+	std::vector<ObjChunk> chunks(chunk_count);
+	pool.parallel_for(chunk_count, 1, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) parse_obj_chunk(data + bounds[i], data + bounds[i + 1], chunks[i]);
+	});
+
+	// 3. 前缀和：每块在合并数组中的起点
+	struct Offsets { size_t positions = 0, uvs = 0, normals = 0, corners = 0; };
+	std::vector<Offsets> offsets(chunk_count + 1);
+	for (size_t i = 0; i < chunk_count; ++i) {
+		offsets[i + 1].positions = offsets[i].positions + chunks[i].positions.size();
+		offsets[i + 1].uvs = offsets[i].uvs + chunks[i].uvs.size();
+		offsets[i + 1].normals = offsets[i].normals + chunks[i].normals.size();
+		offsets[i + 1].corners = offsets[i].corners + chunks[i].corners.size();
+	}
+	const Offsets& total = offsets[chunk_count];
+	_raw_positions.resize(total.positions);
+	_raw_uvs.resize(total.uvs);
+	_raw_normals.resize(total.normals);
+	std::vector<ObjIndex> corners(total.corners);
+
+	// 4. 按顺序并行合并，同时修正相对索引
+	pool.parallel_for(chunk_count, 1, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) {
+			ObjChunk& chunk = chunks[i];
+			const Offsets& off = offsets[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), _raw_positions.begin() + off.positions);
+			std::copy(chunk.uvs.begin(), chunk.uvs.end(), _raw_uvs.begin() + off.uvs);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), _raw_normals.begin() + off.normals);
+
+			ObjIndex* dst = corners.data() + off.corners;
+			std::copy(chunk.corners.begin(), chunk.corners.end(), dst);
+			for (uint32_t r : chunk.relative) {
+				ObjIndex& idx = dst[r / 3];
+				int& field = (r % 3 == 0) ? idx.p : (r % 3 == 1) ? idx.t : idx.n;
+				size_t base = (r % 3 == 0) ? off.positions : (r % 3 == 1) ? off.uvs : off.normals;
+				field += (int)base;
+				if (field < 0) field = -1; // 指向文件开头之前：非法
+			}
+
+			// 合并完立即释放，降低峰值内存
+			chunk = ObjChunk();
+		}
+	});
+
+	build_mesh(corners);
+
 	std::cout << "Model loaded: " << filepath
-		<< " (" << _mesh.indices.size() / 3 << " tris)" << std::endl;
+		<< " (" << _mesh.indices.size() / 3 << " tris, " << _mesh.positions.size() << " verts, " << chunk_count << " chunks)" << std::endl;
+	return true;
 }
 
 // 解析 "1/2/3" 或 "1//3" 或 "1"
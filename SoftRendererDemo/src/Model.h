@@ -1,31 +1,90 @@
 ﻿#pragma once
 #include <string>
 #include <vector>
+#include <cstdint>
 #include "Geometry.h" // 包含 Mesh, Vec3f, Vec2f
+#include "MeshCache.h"
 
 class Model {
 public:
+	// OBJ 解析方式
+	enum class ObjParser {
+		Parallel, // 默认：内存映射 + 分块多线程解析，无逐行分配
+		Stream    // 旧实现：逐行 stringstream (用于对照和基准测试)
+	};
+
 	// 构造函数直接加载
-	Model(const std::string& filepath);
+	// use_cache：优先读取 "<filepath>.srmesh"，没有或已过期则解析 OBJ 并写入缓存
+	// optimize：false 时跳过三角形重排 (基准测试只测解析)；没有重排的结果不写缓存
+	Model(const std::string& filepath, ObjParser parser = ObjParser::Parallel, bool use_cache = true, bool optimize = true);
 	~Model() = default;
 
-	// 获取生成的 Mesh 数据
-	Mesh get_mesh() const { return _mesh; }
+	// 获取生成的 Mesh 数据 (只读引用，需要修改时由调用方显式拷贝)
+	const Mesh& get_mesh() const { return _mesh; }
+
+	// 包围盒 (与缓存一起保存，命中缓存时无需重新计算)
+	const MeshBounds& get_bounds() const { return _bounds; }
 
 private:
+	// MeshStream 复用分块 OBJ 解析 (parse_obj_chunk)
+	friend class MeshStream;
+
 	Mesh _mesh;
+	MeshBounds _bounds;
 
 	// 内部辅助结构：用于暂存 OBJ 文件中的原始数据
-	// 因为 OBJ 的 f 指令引用的索引是基于这些数组的
+	// 因为 OBJ 的 f 指令引用的索引是基于这些数组的 (build_mesh 结束后释放)
 	std::vector<Vec3f> _raw_positions;
 	std::vector<Vec3f> _raw_normals;
 	std::vector<Vec2f> _raw_uvs;
 
-	// 解析具体的一行
-	void load_obj(const std::string& filepath);
-
 	// 辅助：解析 "v/vt/vn" 这种字符串，返回三个索引
 	// 返回值：{pos_idx, uv_idx, norm_idx}，如果没有则为 -1
-	struct ObjIndex { int p = -1, t = -1, n = -1; };
+	struct ObjIndex {
+		int p = -1, t = -1, n = -1;
+		bool operator==(const ObjIndex&) const = default;
+	};
+
+	// (p, t, n) 去重的公共部分：build_mesh 和 MeshStream 的分块去重都用它，两条路径的结果保持一致
+	struct ObjIndexHash {
+		size_t operator()(const ObjIndex& idx) const {
+			uint64_t h = (uint32_t)idx.p * 0x9E3779B97F4A7C15ull;
+			h ^= (uint32_t)idx.t * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+			h ^= (uint32_t)idx.n * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+	// 越界的索引统一视为缺失，这样它们落到同一个默认值上也能去重
+	static ObjIndex sanitize(ObjIndex idx, size_t position_count, size_t uv_count, size_t normal_count) {
+		if (idx.p < 0 || (size_t)idx.p >= position_count) idx.p = -1;
+		if (idx.t < 0 || (size_t)idx.t >= uv_count) idx.t = -1;
+		if (idx.n < 0 || (size_t)idx.n >= normal_count) idx.n = -1;
+		return idx;
+	}
+	// 追加一个输出顶点 (idx 已经过 sanitize)，缺失的属性取默认值；没有法线时在 missing_normal 里记 1
+	static void append_vertex(const ObjIndex& idx, const std::vector<Vec3f>& positions, const std::vector<Vec2f>& uvs,
+		const std::vector<Vec3f>& normals, Mesh& out, std::vector<char>& missing_normal);
+	// 用生成的顶点法线替换 missing_normal 标出的顶点 (文件里给出的法线保持不变)，返回替换的个数
+	static size_t fill_missing_normals(Mesh& mesh, const std::vector<char>& missing_normal);
+
+	// 一个分块的解析结果 (并行解析时每块各自独立)
+	struct ObjChunk {
+		std::vector<Vec3f> positions;
+		std::vector<Vec3f> normals;
+		std::vector<Vec2f> uvs;
+		std::vector<ObjIndex> corners;      // 三角化后的面顶点，每 3 个一个三角形
+		std::vector<uint32_t> relative;     // 使用负数 (相对) 索引的分量：corner * 3 + {0,1,2}，合并时补上前面块的偏移
+	};
+
+	// 解析具体的一行 (Stream 实现)
+	void load_obj(const std::string& filepath);
+
+	// Parallel 实现：成功返回 true
+	bool load_obj_parallel(const std::string& filepath);
+	static void parse_obj_chunk(const char* begin, const char* end, ObjChunk& out);
+
+	// 把三角化后的面顶点按 (p, t, n) 去重，生成索引 Mesh
+	void build_mesh(const std::vector<ObjIndex>& corners);
+
 	ObjIndex parse_face_index(const std::string& token);
 };
\ No newline at end of file
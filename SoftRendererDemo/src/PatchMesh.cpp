@@ -0,0 +1,239 @@
+﻿#include "PatchMesh.h"
+#include "Tessellator.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	// 坐标逐位相同才算同一个点 (细分时共享边按固定方向求值，相同控制点会得到逐位相同的顶点)
+	inline uint64_t hash_position(const Vec3f& p) {
+		uint32_t bits[3];
+		std::memcpy(bits, &p.x, 4);
+		std::memcpy(bits + 1, &p.y, 4);
+		std::memcpy(bits + 2, &p.z, 4);
+		for (uint32_t& b : bits) {
+			if (b == 0x80000000u) b = 0; // -0 与 +0 视为相同
+		}
+		uint64_t h = bits[0] * 0x9E3779B97F4A7C15ull;
+		h ^= bits[1] * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+		h ^= bits[2] * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+		return h ^ (h >> 29);
+	}
+
+	inline bool same_position(const Vec3f& a, const Vec3f& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	// 开放寻址 + 线性探测的点集合：insert 返回该点第一次出现时的编号
+	class PositionTable {
+	public:
+		explicit PositionTable(size_t expected) {
+			size_t capacity = 16;
+			while (capacity < expected * 2) capacity <<= 1;
+			mask = capacity - 1;
+			slots.assign(capacity, -1);
+		}
+
+		int insert(const Vec3f& p, int id, const std::vector<Vec3f>& points) {
+			size_t slot = hash_position(p) & mask;
+			while (slots[slot] >= 0) {
+				if (same_position(points[slots[slot]], p)) return slots[slot];
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = id;
+			return id;
+		}
+
+	private:
+		std::vector<int> slots;
+		size_t mask = 0;
+	};
+
+	// 逗号当作空白，便于用 >> 读取 Newell 格式
+	std::string strip_commas(std::istream& in) {
+		std::stringstream ss;
+		ss << in.rdbuf();
+		std::string text = ss.str();
+		std::replace(text.begin(), text.end(), ',', ' ');
+		return text;
+	}
+}
+
+// ==========================================
+// 读取
+// ==========================================
+bool PatchMesh::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "Error: Cannot open patch file " << path << std::endl;
+		return false;
+	}
+
+	control_points.clear();
+	patches.clear();
+
+	std::string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	bool ok = ext == ".bpt" ? load_bpt(file) : load_newell(file);
+	if (!ok) {
+		std::cerr << "Error: Malformed patch file " << path << std::endl;
+		control_points.clear();
+		patches.clear();
+		return false;
+	}
+
+	std::cout << "Patch model loaded: " << path << " (" << patches.size() << " patches, "
+		<< control_points.size() << " control points)" << std::endl;
+	return true;
+}
+
+bool PatchMesh::load_bpt(std::istream& in) {
+	size_t count = 0;
+	if (!(in >> count)) return false;
+
+	std::vector<CubicPatch> list(count);
+	for (CubicPatch& patch : list) {
+		int degree_u = 0, degree_v = 0;
+		if (!(in >> degree_u >> degree_v)) return false;
+		if (degree_u != 3 || degree_v != 3) {
+			std::cerr << "Error: Only bicubic patches are supported (got " << degree_u << "x" << degree_v << ")" << std::endl;
+			return false;
+		}
+		for (Vec3f& p : patch.cp) {
+			if (!(in >> p.x >> p.y >> p.z)) return false;
+		}
+	}
+	assign(list);
+	return true;
+}
+
+bool PatchMesh::load_newell(std::istream& in) {
+	std::istringstream text(strip_commas(in));
+
+	size_t patch_total = 0;
+	if (!(text >> patch_total)) return false;
+	patches.resize(patch_total);
+	for (auto& indices : patches) {
+		for (int& idx : indices) {
+			if (!(text >> idx)) return false;
+			idx -= 1; // 文件中从 1 开始
+		}
+	}
+
+	size_t point_total = 0;
+	if (!(text >> point_total)) return false;
+	control_points.resize(point_total);
+	for (Vec3f& p : control_points) {
+		if (!(text >> p.x >> p.y >> p.z)) return false;
+	}
+
+	for (const auto& indices : patches) {
+		for (int idx : indices) {
+			if (idx < 0 || (size_t)idx >= point_total) return false;
+		}
+	}
+	return true;
+}
+
+void PatchMesh::assign(const std::vector<CubicPatch>& list) {
+	control_points.clear();
+	patches.assign(list.size(), {});
+	PositionTable table(list.size() * 16);
+	for (size_t i = 0; i < list.size(); ++i) {
+		for (int k = 0; k < 16; ++k) {
+			const Vec3f& p = list[i].cp[k];
+			int id = table.insert(p, (int)control_points.size(), control_points);
+			if (id == (int)control_points.size()) control_points.push_back(p);
+			patches[i][k] = id;
+		}
+	}
+}
+
+CubicPatch PatchMesh::patch(size_t i) const {
+	CubicPatch p;
+	for (int k = 0; k < 16; ++k) p.cp[k] = control_points[patches[i][k]];
+	return p;
+}
+
+std::vector<CubicPatch> PatchMesh::to_patches() const {
+	std::vector<CubicPatch> list(patches.size());
+	for (size_t i = 0; i < patches.size(); ++i) list[i] = patch(i);
+	return list;
+}
+
+// ==========================================
+// 细分 + 焊接
+// ==========================================
+Mesh PatchMesh::tessellate(int level) const {
+	Mesh mesh;
+	if (patches.empty()) return mesh;
+
+	// 1. 每个曲面片的输出大小相同，直接按编号分配输出区间，并行细分
+	const PatchLevels levels = PatchLevels::uniform(level);
+	size_t verts_per_patch = 0, tris_per_patch = 0;
+	PatchTessellator::count(levels, verts_per_patch, tris_per_patch);
+	// tessellate 的输出顺序：先是 4 个角和各边上的点 (边界)，然后是内部网格
+	const size_t boundary_per_patch = std::min(verts_per_patch, 4 + 4 * (size_t)(std::max(level, 1) - 1));
+
+	const size_t total_verts = verts_per_patch * patches.size();
+	std::vector<Vec3f> positions(total_verts), normals(total_verts);
+	std::vector<Vec2f> uvs(total_verts);
+	std::vector<int> indices(tris_per_patch * 3 * patches.size());
+
+	ThreadPool::instance().parallel_for(patches.size(), 1, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) {
+			size_t v0 = i * verts_per_patch;
+			PatchTessellator::tessellate(patch(i), levels, positions.data() + v0, normals.data() + v0, uvs.data() + v0,
+				indices.data() + i * tris_per_patch * 3, (int)v0);
+		}
+	});
+
+	// 2. 焊接：只有边界顶点可能与别的曲面片重合
+	std::vector<int> remap(total_verts);
+	PositionTable table(boundary_per_patch * patches.size());
+	for (size_t i = 0; i < patches.size(); ++i) {
+		size_t v0 = i * verts_per_patch;
+		for (size_t k = 0; k < verts_per_patch; ++k) {
+			size_t v = v0 + k;
+			remap[v] = k < boundary_per_patch ? table.insert(positions[v], (int)v, positions) : (int)v;
+		}
+	}
+
+	// 3. 压缩：保留的顶点按原顺序重新编号，被合并的顶点法线累加到保留者上
+	std::vector<int> compact(total_verts, -1);
+	for (size_t v = 0; v < total_verts; ++v) {
+		if (remap[v] != (int)v) continue;
+		compact[v] = (int)mesh.positions.size();
+		mesh.positions.push_back(positions[v]);
+		mesh.normals.push_back(Vec3f(0, 0, 0));
+		mesh.uvs.push_back(uvs[v]);
+	}
+	for (size_t v = 0; v < total_verts; ++v) {
+		int target = compact[remap[v]];
+		mesh.normals[target] = mesh.normals[target] + normals[v];
+	}
+	ThreadPool::instance().parallel_for(mesh.normals.size(), 0, [&](size_t b, size_t e) {
+		for (size_t v = b; v < e; ++v) {
+			float len = mesh.normals[v].length();
+			mesh.normals[v] = len > 0.0f ? mesh.normals[v] * (1.0f / len) : Vec3f(0, 1, 0);
+		}
+	});
+
+	// 4. 重映射索引，丢掉焊接后两个角重合的三角形
+	mesh.indices.reserve(indices.size());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		int a = compact[remap[indices[t]]], b = compact[remap[indices[t + 1]]], c = compact[remap[indices[t + 2]]];
+		if (a == b || b == c || a == c) continue;
+		mesh.indices.push_back(a);
+		mesh.indices.push_back(b);
+		mesh.indices.push_back(c);
+	}
+
+	MeshOptimizer::optimize(mesh);
+	return mesh;
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include "Geometry.h"
+#include "CubicPatch.h"
+
+// ==========================================
+// 多曲面片模型 (Utah Teapot 一类)
+// ==========================================
+// 控制点共享存储，每个曲面片是 16 个控制点索引 (行优先，与 CubicPatch 一致)。
+// 支持两种经典文本格式：
+//   .bpt    : 第一行曲面片数；每个曲面片一行 "3 3" (u/v 次数，只支持双三次) + 16 行 "x y z"
+//   Newell  : 第一行曲面片数；每个曲面片一行 16 个从 1 开始的控制点编号 (逗号或空格分隔)；
+//             然后一行控制点数 + 每行 "x, y, z" (其它扩展名都按这种格式读)
+// .bpt 里的曲面片各自携带控制点，读入时把坐标完全相同的控制点合并，后续细分才能焊接。
+class PatchMesh {
+public:
+	std::vector<Vec3f> control_points;
+	std::vector<std::array<int, 16>> patches;
+
+	// 失败返回 false 并输出错误
+	bool load(const std::string& path);
+
+	// 从独立的曲面片构建 (合并相同的控制点)
+	void assign(const std::vector<CubicPatch>& list);
+
+	size_t patch_count() const { return patches.size(); }
+	CubicPatch patch(size_t i) const;
+	std::vector<CubicPatch> to_patches() const; // 供 PatchTessellator::draw 自适应绘制
+
+	// 以统一等级细分全部曲面片 (并行)，焊接边界顶点，输出带索引的封闭网格
+	// 焊接后的顶点法线取各曲面片法线的平均；UV 保留第一次出现时的曲面片局部坐标
+	// 收缩边 (例如壶盖顶点) 上产生的退化三角形会被去掉
+	Mesh tessellate(int level) const;
+
+private:
+	bool load_bpt(std::istream& in);
+	bool load_newell(std::istream& in);
+};
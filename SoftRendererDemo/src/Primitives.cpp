@@ -30,6 +30,7 @@ bool Sphere::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) con
 	rec.p = r.pointAt(rec.t);
 	// 球面法线 = (击中点 - 球心) / 半径
 	rec.normal = (rec.p - center) / radius;
+	rec.prim_id = -1;
 
 	return true;
 }
@@ -75,6 +76,9 @@ bool Triangle::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) c
 	rec.t = t;
 	rec.p = r.pointAt(t);
 	rec.set_face_normal(r, normal);
+	rec.u = u;
+	rec.v = v;
+	rec.prim_id = -1;
 
 	return true;
 }
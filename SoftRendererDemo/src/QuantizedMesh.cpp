@@ -0,0 +1,102 @@
+﻿#include "QuantizedMesh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Quantize {
+	uint16_t float_to_half(float f) {
+		uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(f));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		int32_t exp = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mant = bits & 0x7FFFFF;
+
+		// NaN / Inf
+		if (((bits >> 23) & 0xFF) == 0xFF) return (uint16_t)(sign | 0x7C00 | (mant ? 0x200 : 0));
+		// 上溢 -> Inf
+		if (exp >= 31) return (uint16_t)(sign | 0x7C00);
+		// 下溢 -> 非规格化数或 0
+		if (exp <= 0) {
+			if (exp < -10) return (uint16_t)sign;
+			mant |= 0x800000;
+			uint32_t shift = (uint32_t)(14 - exp);
+			uint32_t half_mant = mant >> shift;
+			// 就近舍入 (ties to even)
+			uint32_t rest = mant & ((1u << shift) - 1);
+			uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half_mant & 1))) half_mant++;
+			return (uint16_t)(sign | half_mant);
+		}
+
+		uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+		// 就近舍入 (ties to even)，进位可能自然地溢出到指数
+		uint32_t rest = mant & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+		return (uint16_t)half;
+	}
+
+	void encode_octahedral(const Vec3f& n, int16_t& ex, int16_t& ey) {
+		// 投影到 |x| + |y| + |z| = 1 的八面体上，下半球沿对角线折叠到上半球外侧
+		float inv = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+		float x = n.x * inv, y = n.y * inv;
+		if (n.z < 0.0f) {
+			float ox = x;
+			x = (1.0f - std::abs(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::abs(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+		}
+		ex = (int16_t)std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f);
+		ey = (int16_t)std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f);
+	}
+}
+
+QuantizedMesh QuantizedMesh::from_mesh(const Mesh& mesh) {
+	QuantizedMesh q;
+	q.indices = mesh.indices;
+	if (mesh.positions.empty()) return q;
+
+	// 1. 包围盒 -> 量化步长 (退化的轴步长为 0，解码出来就是常数)
+	Vec3f lo = mesh.positions[0], hi = mesh.positions[0];
+	for (const Vec3f& p : mesh.positions) {
+		lo = Vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+		hi = Vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+	}
+	q.origin = lo;
+	q.step = (hi - lo) * (1.0f / 65535.0f);
+
+	auto quantize = [](float value, float lo, float step) -> uint16_t {
+		if (step <= 0.0f) return 0;
+		return (uint16_t)std::clamp(std::lround((value - lo) / step), 0L, 65535L);
+	};
+
+	// 2. 逐顶点打包
+	q.vertices.resize(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); ++i) {
+		PackedVertex& pv = q.vertices[i];
+		const Vec3f& p = mesh.positions[i];
+		pv.px = quantize(p.x, lo.x, q.step.x);
+		pv.py = quantize(p.y, lo.y, q.step.y);
+		pv.pz = quantize(p.z, lo.z, q.step.z);
+
+		Vec3f n = i < mesh.normals.size() ? mesh.normals[i] : Vec3f(0, 1, 0);
+		if (n.length() <= 0.0f) n = Vec3f(0, 1, 0);
+		Quantize::encode_octahedral(n, pv.nx, pv.ny);
+
+		Vec2f uv = i < mesh.uvs.size() ? mesh.uvs[i] : Vec2f(0, 0);
+		pv.u = Quantize::float_to_half(uv.x);
+		pv.v = Quantize::float_to_half(uv.y);
+	}
+	return q;
+}
+
+Mesh QuantizedMesh::to_mesh() const {
+	Mesh mesh;
+	mesh.indices = indices;
+	mesh.positions.resize(vertices.size());
+	mesh.normals.resize(vertices.size());
+	mesh.uvs.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		mesh.positions[i] = position(i);
+		mesh.normals[i] = normal(i);
+		mesh.uvs[i] = uv(i);
+	}
+	return mesh;
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Geometry.h"
+
+// ==========================================
+// 压缩顶点格式
+// ==========================================
+// 每个顶点 14 字节 (Mesh 的浮点格式是 32 字节)，全部是 16 位字段，不需要填充：
+//   position : 3 x uint16，相对包围盒归一化 (误差 <= 包围盒边长 / 131070)
+//   normal   : 八面体映射 (Octahedral) 后的 2 x int16 snorm
+//   uv       : 2 x half float
+struct PackedVertex {
+	uint16_t px, py, pz;
+	int16_t nx, ny;
+	uint16_t u, v;
+};
+static_assert(sizeof(PackedVertex) == 14, "PackedVertex must stay 14 bytes");
+
+namespace Quantize {
+	// --- half float (IEEE 754 binary16) ---
+	uint16_t float_to_half(float f);
+
+	inline float half_to_float(uint16_t h) {
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t exp = (h >> 10) & 0x1F;
+		uint32_t mant = h & 0x3FF;
+		uint32_t bits;
+		if (exp == 0) {
+			if (mant == 0) {
+				bits = sign; // ±0
+			}
+			else {
+				// 非规格化数：归一化尾数
+				exp = 127 - 15 + 1;
+				while (!(mant & 0x400)) { mant <<= 1; exp--; }
+				bits = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+			}
+		}
+		else if (exp == 31) {
+			bits = sign | 0x7F800000 | (mant << 13); // Inf / NaN
+		}
+		else {
+			bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+		}
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	// --- 八面体法线编码 ---
+	void encode_octahedral(const Vec3f& n, int16_t& x, int16_t& y);
+
+	inline Vec3f decode_octahedral(int16_t ex, int16_t ey) {
+		float x = ex * (1.0f / 32767.0f);
+		float y = ey * (1.0f / 32767.0f);
+		float z = 1.0f - std::abs(x) - std::abs(y);
+		// 下半球折回
+		if (z < 0.0f) {
+			float ox = x;
+			x = (1.0f - std::abs(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::abs(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return Vec3f(x, y, z).normalize();
+	}
+}
+
+// ==========================================
+// 压缩 Mesh
+// ==========================================
+struct QuantizedMesh {
+	Vec3f origin = Vec3f(0, 0, 0); // 包围盒最小角
+	Vec3f step = Vec3f(0, 0, 0);   // 每个量化单位对应的长度 (包围盒边长 / 65535)
+	std::vector<PackedVertex> vertices;
+	std::vector<int> indices;
+
+	static QuantizedMesh from_mesh(const Mesh& mesh);
+	Mesh to_mesh() const;
+
+	size_t vertex_count() const { return vertices.size(); }
+	size_t memory_bytes() const { return vertices.size() * sizeof(PackedVertex) + indices.size() * sizeof(int); }
+
+	// 解码 (在顶点读取时调用)
+	Vec3f position(size_t i) const {
+		const PackedVertex& pv = vertices[i];
+		return Vec3f(origin.x + pv.px * step.x, origin.y + pv.py * step.y, origin.z + pv.pz * step.z);
+	}
+	Vec3f normal(size_t i) const {
+		return Quantize::decode_octahedral(vertices[i].nx, vertices[i].ny);
+	}
+	Vec2f uv(size_t i) const {
+		return Vec2f(Quantize::half_to_float(vertices[i].u), Quantize::half_to_float(vertices[i].v));
+	}
+};
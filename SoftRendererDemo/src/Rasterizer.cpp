@@ -4,17 +4,6 @@
 #include <fstream>
 #include <tuple>
 
-// ==========================================
-// RGSS 采样点分布 (在 0~1 的像素空间内)
-// ==========================================
-// 特点：X 和 Y 投影都不会重叠，最大限度利用采样数
-static const float rgss_offsets[4][2] = {
-	{0.125f, 0.625f}, // Sample 0
-	{0.375f, 0.125f}, // Sample 1
-	{0.625f, 0.875f}, // Sample 2
-	{0.875f, 0.375f}  // Sample 3
-};
-
 Rasterizer::Rasterizer(int w, int h) : width(w), height(h) {
 	int total_samples = w * h * SAMPLE_COUNT; // 还是分配这么大，兼容旧代码
 	frame_buffer.resize(total_samples, Vec3f(0, 0, 0));
@@ -164,6 +153,10 @@ void Rasterizer::rasterize_triangle(const Vec4f v[], const float w_recip[], ISha
 			// 假设 get_index 返回的是像素块的起始位置
 			int pixel_base_index = get_index(x, y);
 
+			// 通过覆盖和深度测试的采样点 (第 k 位) 及其透视矫正后的权重
+			int shade_mask = 0;
+			float alpha_p[4], beta_p[4], gamma_p[4];
+
 			// === RGSS 采样循环 ===
 			for (int k = 0; k < 4; ++k) {
 				// A. 计算采样点坐标
@@ -187,9 +180,9 @@ void Rasterizer::rasterize_triangle(const Vec4f v[], const float w_recip[], ISha
 				if (std::abs(interpolated_w_recip) < 1e-5) continue;
 
 				// 计算透视矫正后的权重
-				float alpha_p = (alpha * w_recip[0]) / interpolated_w_recip;
-				float beta_p = (beta * w_recip[1]) / interpolated_w_recip;
-				float gamma_p = (gamma * w_recip[2]) / interpolated_w_recip;
+				alpha_p[k] = (alpha * w_recip[0]) / interpolated_w_recip;
+				beta_p[k] = (beta * w_recip[1]) / interpolated_w_recip;
+				gamma_p[k] = (gamma * w_recip[2]) / interpolated_w_recip;
 
 				// E. 深度测试 (Z-Buffer)
 				// ---------------------------------------------------------
@@ -200,17 +193,24 @@ void Rasterizer::rasterize_triangle(const Vec4f v[], const float w_recip[], ISha
 				int sample_index = pixel_base_index + k;
 
 				if (z_interpolated < depth_buffer[sample_index]) {
-					// 更新深度
+					// 更新深度，记录下来稍后统一着色
 					depth_buffer[sample_index] = z_interpolated;
+					shade_mask |= 1 << k;
+				}
+			}
 
-					// F. 执行 Fragment Shader (SSAA 模式)
-					// -----------------------------------------------------
-					// 我们为每个采样点都跑一次 Shader。这对于高频纹理（如棋盘格）
-					// 来说效果最好，因为能同时解决边缘锯齿和纹理内部锯齿。
-					Vec3f color = shader.fragment(alpha_p, beta_p, gamma_p);
-
-					// 写入颜色缓冲
-					frame_buffer[sample_index] = color;
+			// F. 执行 Fragment Shader (SSAA 模式)
+			// -----------------------------------------------------
+			// 我们为每个采样点都跑一次 Shader。这对于高频纹理（如棋盘格）
+			// 来说效果最好，因为能同时解决边缘锯齿和纹理内部锯齿。
+			// 4 个采样点一次交给 Shader，方便它批量 (SIMD) 采样纹理。
+			if (shade_mask) {
+				Vec3f colors[4];
+				shader.fragment4(alpha_p, beta_p, gamma_p, shade_mask, colors);
+
+				// 写入颜色缓冲
+				for (int k = 0; k < 4; ++k) {
+					if (shade_mask & (1 << k)) frame_buffer[pixel_base_index + k] = colors[k];
 				}
 			}
 		}
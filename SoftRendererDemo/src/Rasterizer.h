@@ -4,6 +4,18 @@
 #include <limits>
 #include "GMath.h"
 
+// ==========================================
+// RGSS 采样点分布 (在 0~1 的像素空间内)
+// ==========================================
+// 特点：X 和 Y 投影都不会重叠，最大限度利用采样数
+// (Shader 也会用它从 4 个采样点的 UV 差估算屏幕空间导数)
+inline constexpr float rgss_offsets[4][2] = {
+	{0.125f, 0.625f}, // Sample 0
+	{0.375f, 0.125f}, // Sample 1
+	{0.625f, 0.875f}, // Sample 2
+	{0.875f, 0.375f}  // Sample 3
+};
+
 // ==========================================
 // 定义灯光结构
 // ==========================================
@@ -28,6 +40,16 @@ struct IShader {
 	// 输入：重心坐标插值系数 (alpha, beta, gamma)
 	// 输出：最终像素颜色 (Vec3f)
 	virtual Vec3f fragment(float alpha, float beta, float gamma) = 0;
+
+	// 批量片元着色器：一次处理一个像素的 4 个 RGSS 采样点
+	// 输入：每个采样点透视矫正后的重心坐标；mask 的第 k 位表示第 k 个采样点需要着色
+	// 输出：out[k] (只有 mask 中的采样点有效)
+	// 默认实现逐个调用 fragment，Shader 可以重写它来批量采样纹理
+	virtual void fragment4(const float alpha[4], const float beta[4], const float gamma[4], int mask, Vec3f out[4]) {
+		for (int k = 0; k < 4; ++k) {
+			if (mask & (1 << k)) out[k] = fragment(alpha[k], beta[k], gamma[k]);
+		}
+	}
 };
 
 // ==========================================
@@ -30,6 +30,12 @@ struct HitRecord {
 	Vec3f normal;   // 击中点法线
 	bool front_face;// 光线是从外部击中还是内部击中？
 
+	// 三角形网格 (TriangleMesh) 才会填写：重心坐标 (交点 = (1-u-v) v0 + u v1 + v v2)、三角形编号、插值后的纹理坐标
+	float u = 0.0f;
+	float v = 0.0f;
+	int prim_id = -1;
+	Vec2f uv;
+
 	// 辅助函数：统一法线方向
 	// 确保法线始终指向光线射来的一侧
 	void set_face_normal(const Ray& r, const Vec3f& outward_normal) {
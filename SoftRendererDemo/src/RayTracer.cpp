@@ -1,4 +1,5 @@
 ﻿#include "RayTracer.h"
+#include <chrono>
 #include <iostream>
 
 void RayTracer::render()
@@ -6,6 +7,7 @@ void RayTracer::render()
 	const Vec2f ScreenSize = rasterizer->GetScreenSize();
 	int width = ScreenSize.x;
 	int height = ScreenSize.y;
+	auto start = std::chrono::high_resolution_clock::now();
 
 	for (int j = 0; j < height; ++j) {
 		// 可选：打印进度
@@ -23,6 +25,10 @@ void RayTracer::render()
 			rasterizer->set_pixel(i, j, color);
 		}
 	}
+
+	// 构建时间由 Scene::build_seconds 单独统计
+	std::cout << "Trace: " << std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count()
+		<< " s (BVH build " << scene->build_seconds() << " s)" << std::endl;
 }
 
 Vec3f RayTracer::trace(const Ray& r)
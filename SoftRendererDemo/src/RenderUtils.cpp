@@ -1,16 +1,20 @@
 ﻿#include "RenderUtils.h"
 
 void bind_mesh_to_shader(const Mesh& mesh, BlinnPhongShader& shader) {
-	shader.in_positions.clear();
-	shader.in_normals.clear();
-	shader.in_uvs.clear();
-	for (int idx : mesh.indices) {
-		shader.in_positions.push_back(mesh.positions[idx]);
-		shader.in_normals.push_back(mesh.normals[idx]);
+	// 只记录视图，不展开、不拷贝：顶点着色器通过 in_indices 间接读取
+	shader.packed_mesh = nullptr;
+	shader.in_positions = mesh.positions;
+	shader.in_normals = mesh.normals;
+	shader.in_uvs = mesh.uvs; // 为空时顶点着色器给默认 UV
+	shader.in_indices = mesh.indices;
+}
 
-		if (!mesh.uvs.empty()) shader.in_uvs.push_back(mesh.uvs[idx]);
-		else shader.in_uvs.push_back(Vec2f(0, 0));
-	}
+void bind_quantized_mesh_to_shader(const QuantizedMesh& mesh, BlinnPhongShader& shader) {
+	shader.in_positions = {};
+	shader.in_normals = {};
+	shader.in_uvs = {};
+	shader.in_indices = {};
+	shader.packed_mesh = &mesh;
 }
 
 void setup_base_shader(BlinnPhongShader& shader, int w, int h) {
@@ -2,8 +2,13 @@
 #include "Geometry.h"
 #include "Shader.h"
 
-// 将 Mesh 数据绑定到 Shader 的 Attribute
+// 将 Mesh 数据绑定到 Shader 的 Attribute (O(1)，只绑定视图)
+// 注意：Shader 不持有数据，mesh 必须在绘制期间保持有效且不被修改大小；绘制顶点数为 shader.vertex_count()
 void bind_mesh_to_shader(const Mesh& mesh, BlinnPhongShader& shader);
 
+// 绑定压缩 Mesh：Shader 直接读取压缩顶点，绘制时顶点数为 mesh.indices.size()
+// 注意：Shader 只保存指针，mesh 必须在绘制期间保持有效
+void bind_quantized_mesh_to_shader(const QuantizedMesh& mesh, BlinnPhongShader& shader);
+
 // 初始化 Shader 的通用光照和矩阵参数
 void setup_base_shader(BlinnPhongShader& shader, int w, int h);
\ No newline at end of file
@@ -0,0 +1,36 @@
+﻿#pragma once
+#include "GMath.h"
+
+// ==========================================
+// 采样器状态 (Sampler State)
+// ==========================================
+// 与纹理数据解耦：同一张 Texture 可以用不同的寻址/过滤方式采样。
+// Texture::sample 会按 (wrap, filter, 纹素布局, 是否 2 的幂) 选出一个
+// 编译期特化好的采样函数，内层循环没有取模和模式分支。
+
+// 寻址模式：UV 超出 [0, 1] 时如何取纹素 (U/V 两个方向共用)
+enum class WrapMode {
+	Repeat = 0, // 平铺
+	Clamp,      // 钳制到边缘 (解决黑边问题)
+	Mirror,     // 镜像平铺
+	Border      // 超出部分返回 border_color
+};
+
+// 过滤模式
+enum class FilterMode {
+	Nearest = 0, // 最近邻
+	Bilinear,    // 双线性
+	Trilinear    // 三线性 (需要先 generateMipmaps，否则等同于双线性)
+};
+
+struct Sampler {
+	WrapMode wrap = WrapMode::Repeat;
+	FilterMode filter = FilterMode::Bilinear;
+	Vec3f border_color = Vec3f(0.0f, 0.0f, 0.0f);
+	// UV 缩放 (平铺次数 / 棋盘格密度)：属于采样方式而不是纹理数据，
+	// 共享同一张纹理 (例如 TextureManager 的缓存) 的使用者可以各自设置
+	float uv_scale = 1.0f;
+
+	Sampler() = default;
+	Sampler(WrapMode w, FilterMode f) : wrap(w), filter(f) {}
+};
@@ -7,25 +7,45 @@
 // ==========================================
 Vec4f BlinnPhongShader::vertex(int iface, size_t vert_idx) {
 	// 1. 读取输入
-	// --- 安全性检查：位置数组 ---
 	Vec3f raw_pos(0, 0, 0);
-	if (vert_idx >= 0 && vert_idx < in_positions.size()) {
-		raw_pos = in_positions[vert_idx];
-	}
-
-	// --- 安全性检查：法线数组 ---
 	Vec3f raw_nor(0, 1, 0); // 默认向上
-	if (vert_idx >= 0 && vert_idx < in_normals.size()) {
-		raw_nor = in_normals[vert_idx];
-	}
-
-	// --- 安全性检查：UV 数组 (关键！) ---
-	// 如果 Mesh 没有提供 UV，或者索引越界，给一个默认值 (0,0)
-	if (vert_idx >= 0 && vert_idx < in_uvs.size()) {
-		varying_uv[iface] = in_uvs[vert_idx];
+	if (packed_mesh != nullptr) {
+		// 压缩顶点：通过索引读取并解码
+		size_t v = vert_idx < packed_mesh->indices.size() ? (size_t)packed_mesh->indices[vert_idx] : packed_mesh->vertex_count();
+		if (v < packed_mesh->vertex_count()) {
+			raw_pos = packed_mesh->position(v);
+			raw_nor = packed_mesh->normal(v);
+			varying_uv[iface] = packed_mesh->uv(v);
+		}
+		else {
+			varying_uv[iface] = Vec2f(0.0f, 0.0f);
+		}
 	}
 	else {
-		varying_uv[iface] = Vec2f(0.0f, 0.0f);
+		// --- 索引：没有绑定索引时按顺序读取 ---
+		size_t v = vert_idx;
+		if (!in_indices.empty()) {
+			v = vert_idx < in_indices.size() ? (size_t)in_indices[vert_idx] : in_positions.size();
+		}
+
+		// --- 安全性检查：位置数组 ---
+		if (v < in_positions.size()) {
+			raw_pos = in_positions[v];
+		}
+
+		// --- 安全性检查：法线数组 ---
+		if (v < in_normals.size()) {
+			raw_nor = in_normals[v];
+		}
+
+		// --- 安全性检查：UV 数组 (关键！) ---
+		// 如果 Mesh 没有提供 UV，或者索引越界，给一个默认值 (0,0)
+		if (v < in_uvs.size()) {
+			varying_uv[iface] = in_uvs[v];
+		}
+		else {
+			varying_uv[iface] = Vec2f(0.0f, 0.0f);
+		}
 	}
 
 	// 2. 变换法线 -> 世界空间
@@ -42,6 +62,11 @@ Vec4f BlinnPhongShader::vertex(int iface, size_t vert_idx) {
 	return projection * view * world_pos_4;
 }
 
+size_t BlinnPhongShader::vertex_count() const {
+	if (packed_mesh != nullptr) return packed_mesh->indices.size();
+	return in_indices.empty() ? in_positions.size() : in_indices.size();
+}
+
 // ==========================================
 // Fragment Shader 实现
 // ==========================================
@@ -57,30 +82,110 @@ Vec3f BlinnPhongShader::fragment(float alpha, float beta, float gamma) {
 	// 2. 插值 UV
 	Vec2f uv = varying_uv[0] * alpha + varying_uv[1] * beta + varying_uv[2] * gamma;
 
-	
-	Vec3f light_vec = light.position - world_pos;
-	float dist_sq = light_vec.dot(light_vec); // 计算光源到点的距离 r
-	Vec3f L = light_vec.normalize();     // 入射光方向 (从着色点指向光源)
-
-	Vec3f V = (camera_pos - world_pos).normalize(); // 视线方向 (从着色点指向摄像机)
-	Vec3f H = (L + V).normalize();       // 半程向量 (Blinn-Phong)
-
 	// ------------------------------------------
 	// B. 纹理调制 (Modulation)
 	// ------------------------------------------
 	// 如果有纹理，采样纹理颜色；如果没有，默认白色(1,1,1)不影响乘法
 	Vec3f tex_color = Vec3f(1.0f, 1.0f, 1.0f);
-	if (use_texture && texture != nullptr) {
+	if (use_texture && virtual_texture != nullptr) {
+		// 虚拟纹理：单点无法估算导数，按最精细一级请求
+		tex_color = virtual_texture->sample(uv.x, uv.y);
+	}
+	else if (use_texture && texture != nullptr) {
 		if (sample_mode == MODE_CHECKERBOARD) {
-			// 模式 A: 验证透视矫正 (直线是否笔直)
-			tex_color = texture->getColorCheckerboard(uv.x, uv.y);
+			// 模式 A: 验证透视矫正 (直线是否笔直)，格子密度由 sampler.uv_scale 决定
+			tex_color = texture->getColorCheckerboard(uv.x * sampler.uv_scale, uv.y * sampler.uv_scale);
 		}
 		else if (sample_mode == MODE_BILINEAR) {
-			// 模式 B: 验证双线性插值 (低分辨率是否平滑)
-			tex_color = texture->getColorBilinear(uv.x, uv.y);
+			// 模式 B: 验证双线性插值 (低分辨率是否平滑)，寻址/过滤方式由 sampler 决定
+			tex_color = texture->sample(sampler, uv.x, uv.y);
 		}
 	}
 
+	return shade(normal, world_pos, tex_color);
+}
+
+// ==========================================
+// 批量 Fragment Shader：一个像素的 4 个 RGSS 采样点
+// ==========================================
+void BlinnPhongShader::fragment4(const float alpha[4], const float beta[4], const float gamma[4], int mask, Vec3f out[4]) {
+	// 1. 插值 4 个采样点的 UV
+	// 未覆盖的采样点没有有效权重，借用第一个有效采样点的 UV 填满 SIMD 通道
+	int first = 0;
+	while (!(mask & (1 << first))) ++first;
+
+	float us[4], vs[4];
+	for (int k = 0; k < 4; ++k) {
+		int src = (mask & (1 << k)) ? k : first;
+		Vec2f uv = varying_uv[0] * alpha[src] + varying_uv[1] * beta[src] + varying_uv[2] * gamma[src];
+		us[k] = uv.x;
+		vs[k] = uv.y;
+	}
+
+	// 2. 纹理采样 (一次处理 4 个点)
+	Vec3f tex_colors[4] = { Vec3f(1.0f), Vec3f(1.0f), Vec3f(1.0f), Vec3f(1.0f) };
+	if (use_texture && virtual_texture != nullptr) {
+		// 虚拟纹理：LOD 决定请求哪一级的 Tile，像素部分覆盖时保守地用最精细一级
+		float lod = 0.0f;
+		if (mask == 0xF) {
+			float du_dx, dv_dx, du_dy, dv_dy;
+			uv_derivatives(us, vs, du_dx, dv_dx, du_dy, dv_dy);
+			lod = virtual_texture->computeLod(du_dx, dv_dx, du_dy, dv_dy);
+		}
+		for (int k = 0; k < 4; ++k) {
+			if (mask & (1 << k)) tex_colors[k] = virtual_texture->sample(us[k], vs[k], lod);
+		}
+	}
+	else if (use_texture && texture != nullptr) {
+		if (sample_mode == MODE_BILINEAR) {
+			// 4 个采样点都有效时，用它们的 UV 差估算屏幕空间导数，供 Trilinear 选 Mip
+			float lod = 0.0f;
+			if (mask == 0xF && sampler.filter == FilterMode::Trilinear) {
+				float du_dx, dv_dx, du_dy, dv_dy;
+				uv_derivatives(us, vs, du_dx, dv_dx, du_dy, dv_dy);
+				const float s = sampler.uv_scale;
+				lod = texture->computeLod(du_dx * s, dv_dx * s, du_dy * s, dv_dy * s);
+			}
+			texture->sample4(sampler, us, vs, tex_colors, lod);
+		}
+		else {
+			for (int k = 0; k < 4; ++k) tex_colors[k] = texture->getColorCheckerboard(us[k] * sampler.uv_scale, vs[k] * sampler.uv_scale);
+		}
+	}
+
+	// 3. 逐采样点计算光照
+	for (int k = 0; k < 4; ++k) {
+		if (!(mask & (1 << k))) continue;
+		Vec3f normal = (varying_normal[0] * alpha[k] + varying_normal[1] * beta[k] + varying_normal[2] * gamma[k]).normalize();
+		Vec3f world_pos = varying_world_pos[0] * alpha[k] + varying_world_pos[1] * beta[k] + varying_world_pos[2] * gamma[k];
+		out[k] = shade(normal, world_pos, tex_colors[k]);
+	}
+}
+
+// RGSS 中 0->3 与 1->2 两条对角线张成像素平面，解 2x2 方程得到 d(uv)/dx, d(uv)/dy
+void BlinnPhongShader::uv_derivatives(const float us[4], const float vs[4], float& du_dx, float& dv_dx, float& du_dy, float& dv_dy) {
+	float ax = rgss_offsets[3][0] - rgss_offsets[0][0], ay = rgss_offsets[3][1] - rgss_offsets[0][1];
+	float bx = rgss_offsets[2][0] - rgss_offsets[1][0], by = rgss_offsets[2][1] - rgss_offsets[1][1];
+	float inv_det = 1.0f / (ax * by - ay * bx);
+	float du_a = us[3] - us[0], dv_a = vs[3] - vs[0];
+	float du_b = us[2] - us[1], dv_b = vs[2] - vs[1];
+	du_dx = (du_a * by - du_b * ay) * inv_det;
+	du_dy = (du_b * ax - du_a * bx) * inv_det;
+	dv_dx = (dv_a * by - dv_b * ay) * inv_det;
+	dv_dy = (dv_b * ax - dv_a * bx) * inv_det;
+}
+
+// ==========================================
+// Blinn-Phong 光照
+// ==========================================
+Vec3f BlinnPhongShader::shade(const Vec3f& normal, const Vec3f& world_pos, const Vec3f& tex_color) const {
+	Vec3f light_vec = light.position - world_pos;
+	float dist_sq = light_vec.dot(light_vec); // 计算光源到点的距离 r
+	Vec3f L = light_vec.normalize();     // 入射光方向 (从着色点指向光源)
+
+	Vec3f V = (camera_pos - world_pos).normalize(); // 视线方向 (从着色点指向摄像机)
+	Vec3f H = (L + V).normalize();       // 半程向量 (Blinn-Phong)
+
 	// 最终的反照率 (Albedo) = 材质颜色(k_d) * 纹理颜色
 	// 这就是 "Modulation"：材质颜色“染”了纹理颜色
 	Vec3f albedo = k_d * tex_color;
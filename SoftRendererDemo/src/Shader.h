@@ -2,7 +2,11 @@
 #include "Rasterizer.h" // 包含 IShader 和 Light 的定义
 #include "GMath.h"
 #include "Texture.h"
+#include "VirtualTexture.h"
+#include "QuantizedMesh.h"
 #include <vector>
+#include <memory>
+#include <span>
 
 // BlinnPhongShader：支持环境光、漫反射、高光
 struct BlinnPhongShader : public IShader {
@@ -23,15 +27,24 @@ struct BlinnPhongShader : public IShader {
 	float p = 150.0f;                 // Shininess (高光指数)
 
 	// 纹理属性
-	Texture* texture = nullptr; // 持有纹理指针
+	std::shared_ptr<const Texture> texture; // 共享纹理句柄 (通常来自 TextureManager)
 	bool use_texture = false;   // 纹理开关
+	Sampler sampler;            // 寻址/过滤模式 (MODE_BILINEAR 下生效)
+	std::shared_ptr<const VirtualTexture> virtual_texture; // 设置后代替 texture 采样 (超大纹理)
 
 	// ==========================================
 	// Attributes (输入数据)
 	// ==========================================
-	std::vector<Vec3f> in_positions;
-	std::vector<Vec3f> in_normals;
-	std::vector<Vec2f> in_uvs;  //  UV 输入数组
+	// 只是视图 (不拷贝、不持有)：指向的数组必须在绘制期间保持有效
+	std::span<const Vec3f> in_positions;
+	std::span<const Vec3f> in_normals;
+	std::span<const Vec2f> in_uvs;  //  UV 输入数组
+	// 索引视图：非空时第 i 个绘制顶点读取 in_*[in_indices[i]]，否则直接读取 in_*[i]
+	std::span<const int> in_indices;
+
+	// 压缩顶点输入：设置后 vertex() 忽略上面三个数组，
+	// 按 packed_mesh->indices[vert_idx] 读取并就地解码 (不展开成浮点数组)
+	const QuantizedMesh* packed_mesh = nullptr;
 
 	// ==========================================
 	// Varyings (插值数据)
@@ -52,6 +65,18 @@ struct BlinnPhongShader : public IShader {
 	// ==========================================
 	virtual Vec4f vertex(int iface, size_t vert_idx) override;
 	virtual Vec3f fragment(float alpha, float beta, float gamma) override;
+
+	// 批量版本：4 个采样点的纹理一次 (SIMD) 采样，光照仍逐点计算
+	virtual void fragment4(const float alpha[4], const float beta[4], const float gamma[4], int mask, Vec3f out[4]) override;
+
+	// 当前绑定的输入需要绘制的顶点数 (传给 Rasterizer::draw)
+	size_t vertex_count() const;
+
+private:
+	// Blinn-Phong 光照 (fragment / fragment4 共用)
+	Vec3f shade(const Vec3f& normal, const Vec3f& world_pos, const Vec3f& tex_color) const;
+	// 由 4 个 RGSS 采样点的 UV 估算屏幕空间导数 (d(uv)/dx, d(uv)/dy)
+	static void uv_derivatives(const float us[4], const float vs[4], float& du_dx, float& dv_dx, float& du_dy, float& dv_dy);
 };
 
 // ==========================================
@@ -63,9 +88,9 @@ struct VertexColorShader : public IShader {
 	Mat4 view;
 	Mat4 projection;
 
-	// Attributes (输入)
-	std::vector<Vec3f> in_positions;
-	std::vector<Vec3f> in_colors;
+	// Attributes (输入，视图)
+	std::span<const Vec3f> in_positions;
+	std::span<const Vec3f> in_colors;
 
 	// Varyings (插值)
 	Vec3f varying_color[3];
@@ -101,9 +126,9 @@ struct GouraudShader : public IShader {
 	Vec3f k_s = { 1.0f, 1.0f, 1.0f };
 	float p = 150.0f;
 
-	// Attributes
-	std::vector<Vec3f> in_positions;
-	std::vector<Vec3f> in_normals;
+	// Attributes (视图)
+	std::span<const Vec3f> in_positions;
+	std::span<const Vec3f> in_normals;
 
 	// ==========================================
 	// Varyings (关键区别！)
@@ -128,9 +153,9 @@ struct ClassicPhongShader : public IShader {
 	Vec3f k_s = { 1.0f, 1.0f, 1.0f };
 	float p = 38.f;
 
-	// Attributes
-	std::vector<Vec3f> in_positions;
-	std::vector<Vec3f> in_normals;
+	// Attributes (视图)
+	std::span<const Vec3f> in_positions;
+	std::span<const Vec3f> in_normals;
 
 	// Varyings
 	Vec3f varying_world_pos[3];
@@ -0,0 +1,325 @@
+﻿#include "Tessellator.h"
+#include "Rasterizer.h"
+#include "Shader.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <cmath>
+
+PatchLevels PatchLevels::uniform(int level) {
+	PatchLevels l;
+	level = std::max(1, level);
+	for (int s = 0; s < 4; ++s) l.edge[s] = level;
+	l.inner_u = l.inner_v = level;
+	return l;
+}
+
+namespace {
+	// 各边的控制点在 cp 中的位置 (按参数递增方向)
+	constexpr int EDGE_CP[4][4] = {
+		{ 0, 1, 2, 3 },    // v = 0
+		{ 3, 7, 11, 15 },  // u = 1
+		{ 12, 13, 14, 15 },// v = 1
+		{ 0, 4, 8, 12 }    // u = 0
+	};
+
+	inline void edge_points(const CubicPatch& patch, int s, Vec3f out[4]) {
+		for (int k = 0; k < 4; ++k) out[k] = patch.cp[EDGE_CP[s][k]];
+	}
+
+	inline bool lex_less(const Vec3f& a, const Vec3f& b) {
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		return a.z < b.z;
+	}
+
+	inline bool same_point(const Vec3f& a, const Vec3f& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	// 共享边的规范方向：从字典序较小的端点出发 (端点相同时比较中间两个控制点)
+	// 两侧曲面片对同一条边得到同一个方向，按这个方向做的浮点运算逐位相同
+	inline bool edge_flipped(const Vec3f e[4]) {
+		return lex_less(e[3], e[0]) || (!lex_less(e[0], e[3]) && lex_less(e[2], e[1]));
+	}
+
+	// 边界曲线上第 k / level 个点
+	// 总是按规范方向求值：两侧曲面片无论边的方向如何，执行的浮点运算完全相同
+	Vec3f eval_edge(const Vec3f e[4], int k, int level) {
+		// 收缩成一点的边 (例如旋转曲面的极点)：权重之和的舍入误差会让各点偏离几个 ULP，直接返回该点
+		if (same_point(e[0], e[1]) && same_point(e[0], e[2]) && same_point(e[0], e[3])) return e[0];
+		const bool flip = edge_flipped(e);
+		float b[4], db[4];
+		if (!flip) {
+			CubicPatch::bernstein((float)k / level, b, db);
+			return e[0] * b[0] + e[1] * b[1] + e[2] * b[2] + e[3] * b[3];
+		}
+		CubicPatch::bernstein((float)(level - k) / level, b, db);
+		return e[3] * b[0] + e[2] * b[1] + e[1] * b[2] + e[0] * b[3];
+	}
+
+	// 等级修正：内部至少与对边一致；有任何一边需要细分时，内部至少 2 (保证有一圈内部顶点可以拼接)
+	inline void resolve_inner(const PatchLevels& levels, int& nu, int& nv, bool& simple) {
+		nu = std::max({ levels.inner_u, levels.edge[0], levels.edge[2], 1 });
+		nv = std::max({ levels.inner_v, levels.edge[1], levels.edge[3], 1 });
+		simple = nu == 1 && nv == 1;
+		if (!simple) {
+			nu = std::max(nu, 2);
+			nv = std::max(nv, 2);
+		}
+	}
+
+	inline int clamp_level(int level) { return std::max(1, level); }
+
+	// 凸包性质：16 个控制点全在某个裁剪面外侧，曲面片一定不可见
+	bool outside_frustum(const CubicPatch& patch, const Mat4& mvp) {
+		int out[6] = {};
+		for (const Vec3f& p : patch.cp) {
+			Vec4f c = mvp * Vec4f(p, 1.0f);
+			out[0] += c.x > c.w;
+			out[1] += c.x < -c.w;
+			out[2] += c.y > c.w;
+			out[3] += c.y < -c.w;
+			out[4] += c.z > c.w;
+			out[5] += c.w <= 0.0f;
+		}
+		for (int k = 0; k < 6; ++k) {
+			if (out[k] == 16) return true;
+		}
+		return false;
+	}
+}
+
+// ==========================================
+// 等级选择
+// ==========================================
+int PatchTessellator::edge_level(const Vec3f edge[4], const Mat4& mvp, const Vec2f& screen) const {
+	// 控制多边形的长度是曲线长度的上界，用投影后的长度估算需要多少段
+	// 按规范方向累加：浮点加法不满足结合律，两侧按各自的方向求和可能差一点，ceil 之后就会差一级，出现 T 形裂缝
+	const bool flip = edge_flipped(edge);
+	Vec2f prev;
+	float length = 0.0f;
+	for (int k = 0; k < 4; ++k) {
+		Vec4f c = mvp * Vec4f(edge[flip ? 3 - k : k], 1.0f);
+		if (c.w <= 1e-5f) return settings.max_level; // 穿过相机平面，无法投影，取最高等级
+		Vec2f s(0.5f * screen.x * (c.x / c.w + 1.0f), 0.5f * screen.y * (c.y / c.w + 1.0f));
+		if (k > 0) length += std::sqrt((s.x - prev.x) * (s.x - prev.x) + (s.y - prev.y) * (s.y - prev.y));
+		prev = s;
+	}
+	int level = (int)std::ceil(length / std::max(settings.target_edge_pixels, 1e-3f));
+	return std::clamp(level, 1, std::max(1, settings.max_level));
+}
+
+PatchLevels PatchTessellator::patch_levels(const CubicPatch& patch, const Mat4& mvp, const Vec2f& screen) const {
+	PatchLevels levels;
+	Vec3f e[4];
+	for (int s = 0; s < 4; ++s) {
+		edge_points(patch, s, e);
+		levels.edge[s] = edge_level(e, mvp, screen);
+	}
+
+	// 内部：中间两行 (沿 u) 和两列 (沿 v) 也可能比边界弯得更厉害
+	levels.inner_u = std::max(levels.edge[0], levels.edge[2]);
+	levels.inner_v = std::max(levels.edge[1], levels.edge[3]);
+	for (int r = 1; r <= 2; ++r) {
+		Vec3f row[4] = { patch.cp[r * 4], patch.cp[r * 4 + 1], patch.cp[r * 4 + 2], patch.cp[r * 4 + 3] };
+		Vec3f col[4] = { patch.cp[r], patch.cp[4 + r], patch.cp[8 + r], patch.cp[12 + r] };
+		levels.inner_u = std::max(levels.inner_u, edge_level(row, mvp, screen));
+		levels.inner_v = std::max(levels.inner_v, edge_level(col, mvp, screen));
+	}
+	return levels;
+}
+
+// ==========================================
+// 细分
+// ==========================================
+void PatchTessellator::count(const PatchLevels& levels, size_t& vertex_count, size_t& triangle_count) {
+	int nu, nv;
+	bool simple;
+	resolve_inner(levels, nu, nv, simple);
+	if (simple) {
+		vertex_count = 4;
+		triangle_count = 2;
+		return;
+	}
+
+	// 4 个角 + 各边内部的点 + 内部网格
+	vertex_count = 4 + (size_t)(nu - 1) * (nv - 1);
+	// 内部规则网格 + 四条过渡带 (每条带的三角形数 = 外侧段数 + 内侧段数)
+	triangle_count = 2 * (size_t)(nu - 2) * (nv - 2);
+	for (int s = 0; s < 4; ++s) {
+		int e = clamp_level(levels.edge[s]);
+		int inner_points = (s == 0 || s == 2) ? nu - 1 : nv - 1;
+		vertex_count += e - 1;
+		triangle_count += e + inner_points - 1;
+	}
+}
+
+void PatchTessellator::tessellate(const CubicPatch& patch, const PatchLevels& levels,
+	Vec3f* positions, Vec3f* normals, Vec2f* uvs, int* indices, int base_vertex) {
+	int nu, nv;
+	bool simple;
+	resolve_inner(levels, nu, nv, simple);
+	int e[4];
+	for (int s = 0; s < 4; ++s) e[s] = simple ? 1 : clamp_level(levels.edge[s]);
+
+	int written = 0;
+	auto emit_vertex = [&](const Vec3f& pos, float u, float v) {
+		positions[written] = pos;
+		if (normals) normals[written] = patch.normal(u, v);
+		if (uvs) uvs[written] = Vec2f(u, v);
+		return base_vertex + written++;
+	};
+	int* tri = indices;
+	auto emit_triangle = [&](int a, int b, int c) {
+		*tri++ = a; *tri++ = b; *tri++ = c;
+	};
+
+	// 1. 四个角 (就是控制点本身)：0:(0,0) 1:(1,0) 2:(1,1) 3:(0,1)
+	int corner[4];
+	corner[0] = emit_vertex(patch.cp[0], 0.0f, 0.0f);
+	corner[1] = emit_vertex(patch.cp[3], 1.0f, 0.0f);
+	corner[2] = emit_vertex(patch.cp[15], 1.0f, 1.0f);
+	corner[3] = emit_vertex(patch.cp[12], 0.0f, 1.0f);
+
+	if (simple) {
+		emit_triangle(corner[0], corner[1], corner[3]);
+		emit_triangle(corner[1], corner[2], corner[3]);
+		return;
+	}
+
+	// 2. 各边内部的点
+	const int edge_start[4] = { corner[0], corner[1], corner[3], corner[0] };
+	const int edge_end[4] = { corner[1], corner[2], corner[2], corner[3] };
+	int edge_first[4];
+	for (int s = 0; s < 4; ++s) {
+		Vec3f ep[4];
+		edge_points(patch, s, ep);
+		edge_first[s] = base_vertex + written;
+		for (int k = 1; k < e[s]; ++k) {
+			float t = (float)k / e[s];
+			float u = s == 0 || s == 2 ? t : (s == 1 ? 1.0f : 0.0f);
+			float v = s == 1 || s == 3 ? t : (s == 2 ? 1.0f : 0.0f);
+			emit_vertex(eval_edge(ep, k, e[s]), u, v);
+		}
+	}
+	auto outer = [&](int s, int k) {
+		if (k == 0) return edge_start[s];
+		if (k == e[s]) return edge_end[s];
+		return edge_first[s] + k - 1;
+	};
+
+	// 3. 内部网格 (i, j)，i ∈ [1, nu-1]，j ∈ [1, nv-1]
+	const int inner_first = base_vertex + written;
+	for (int j = 1; j < nv; ++j) {
+		for (int i = 1; i < nu; ++i) {
+			float u = (float)i / nu, v = (float)j / nv;
+			emit_vertex(patch.eval(u, v), u, v);
+		}
+	}
+	auto inner = [&](int i, int j) { return inner_first + (j - 1) * (nu - 1) + (i - 1); };
+
+	for (int j = 1; j < nv - 1; ++j) {
+		for (int i = 1; i < nu - 1; ++i) {
+			int p0 = inner(i, j), p1 = inner(i + 1, j), p2 = inner(i, j + 1), p3 = inner(i + 1, j + 1);
+			emit_triangle(p0, p1, p2);
+			emit_triangle(p1, p3, p2);
+		}
+	}
+
+	// 4. 过渡带：外侧是边上的 e[s] + 1 个点，内侧是内部网格最外一圈的一行/一列
+	// 两条折线按参数归并，每一步前进中点更靠前的那一侧
+	for (int s = 0; s < 4; ++s) {
+		const bool along_u = s == 0 || s == 2;
+		const int n = along_u ? nu : nv;  // 内侧点的参数为 k / n，k ∈ [1, n-1]
+		const int m = e[s];
+		auto inner_at = [&](int k) {
+			switch (s) {
+			case 0: return inner(k, 1);
+			case 1: return inner(nu - 1, k);
+			case 2: return inner(k, nv - 1);
+			default: return inner(1, k);
+			}
+		};
+		// 边 0、1 上按参数递增走是逆时针，边 2、3 需要反过来
+		const bool flip = s == 2 || s == 3;
+		auto band_triangle = [&](int a, int b, int c) {
+			if (flip) emit_triangle(a, c, b);
+			else emit_triangle(a, b, c);
+		};
+
+		int a = 0, b = 1;
+		while (a < m || b < n - 1) {
+			bool advance_outer = b == n - 1 || (a < m && (a + 0.5f) / m < (b + 0.5f) / n);
+			if (advance_outer) {
+				band_triangle(outer(s, a), outer(s, a + 1), inner_at(b));
+				a++;
+			}
+			else {
+				band_triangle(outer(s, a), inner_at(b + 1), inner_at(b));
+				b++;
+			}
+		}
+	}
+}
+
+// ==========================================
+// 绘制
+// ==========================================
+PatchTessellator::Stats PatchTessellator::draw(Rasterizer& r, BlinnPhongShader& shader, std::span<const CubicPatch> patches) const {
+	Stats stats;
+	const Vec2f screen = r.GetScreenSize();
+	const Mat4 mvp = shader.projection * shader.view * shader.model;
+
+	// 一批曲面片的顶点和索引都放在临时内存里，提交后复用
+	ScratchScope scratch;
+	std::pmr::vector<Vec3f> positions(scratch.resource());
+	std::pmr::vector<Vec3f> normals(scratch.resource());
+	std::pmr::vector<Vec2f> uvs(scratch.resource());
+	std::pmr::vector<int> indices(scratch.resource());
+
+	auto flush = [&]() {
+		if (indices.empty()) return;
+		shader.packed_mesh = nullptr;
+		shader.in_positions = positions;
+		shader.in_normals = normals;
+		shader.in_uvs = uvs;
+		shader.in_indices = indices;
+		r.draw(shader, indices.size());
+		stats.batches++;
+		positions.clear();
+		normals.clear();
+		uvs.clear();
+		indices.clear();
+	};
+
+	for (const CubicPatch& patch : patches) {
+		stats.patches++;
+		if (outside_frustum(patch, mvp)) {
+			stats.culled++;
+			continue;
+		}
+
+		PatchLevels levels = patch_levels(patch, mvp, screen);
+		size_t vertex_count = 0, triangle_count = 0;
+		count(levels, vertex_count, triangle_count);
+
+		size_t v0 = positions.size(), i0 = indices.size();
+		positions.resize(v0 + vertex_count);
+		normals.resize(v0 + vertex_count);
+		uvs.resize(v0 + vertex_count);
+		indices.resize(i0 + triangle_count * 3);
+		tessellate(patch, levels, positions.data() + v0, normals.data() + v0, uvs.data() + v0, indices.data() + i0, (int)v0);
+
+		stats.vertices += vertex_count;
+		stats.triangles += triangle_count;
+		if (indices.size() / 3 >= settings.batch_triangles) flush();
+	}
+	flush();
+
+	// 临时内存即将回收，不给 shader 留悬空视图
+	shader.in_positions = {};
+	shader.in_normals = {};
+	shader.in_uvs = {};
+	shader.in_indices = {};
+	return stats;
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+#include <cstddef>
+#include <span>
+#include "GMath.h"
+#include "CubicPatch.h"
+
+class Rasterizer;
+struct BlinnPhongShader;
+
+// ==========================================
+// 曲面片细分等级
+// ==========================================
+// 边的编号 (参数空间)：0: v=0，1: u=1，2: v=1，3: u=0
+// 相邻曲面片共享的边由同样 4 个控制点决定，只要等级只依赖这 4 个点 (edge_level)，
+// 并且两边都按同一个方向 (从字典序较小的端点出发) 计算，算出的等级和顶点就逐位一致，不会出现裂缝。
+// 内部等级可以更高，由边界上的过渡带 (stitching) 衔接。
+struct PatchLevels {
+	int edge[4] = { 1, 1, 1, 1 };
+	int inner_u = 1;
+	int inner_v = 1;
+
+	// 所有边取同一等级 (等价于 generate_surface_mesh 的规则网格)
+	static PatchLevels uniform(int level);
+};
+
+// ==========================================
+// 细分器
+// ==========================================
+// 1. 按屏幕空间需要为每个曲面片选等级 (边界控制多边形的投影长度)
+// 2. 生成顶点和索引：内部是规则网格，外圈和每条边按各自的等级拼接
+// 3. draw 把一批曲面片的结果放在帧内临时内存里，直接以视图绑定给 Shader 并提交光栅化，不经过 Mesh
+class PatchTessellator {
+public:
+	struct Settings {
+		float target_edge_pixels = 8.0f; // 期望的三角形边长 (像素)
+		int max_level = 64;
+		size_t batch_triangles = 65536;  // 累计到这么多三角形就提交一次
+	};
+
+	struct Stats {
+		size_t patches = 0;
+		size_t culled = 0;    // 整个控制网格都在视锥外
+		size_t vertices = 0;
+		size_t triangles = 0;
+		size_t batches = 0;
+	};
+
+	Settings settings;
+
+	// 一条边界曲线 (4 个控制点) 在屏幕上需要的细分等级
+	int edge_level(const Vec3f edge[4], const Mat4& mvp, const Vec2f& screen) const;
+	// 曲面片的等级：边由 edge_level 决定，内部再考虑中间两行/两列控制点
+	PatchLevels patch_levels(const CubicPatch& patch, const Mat4& mvp, const Vec2f& screen) const;
+
+	// 细分结果的大小
+	static void count(const PatchLevels& levels, size_t& vertex_count, size_t& triangle_count);
+
+	// 细分一个曲面片，写入调用方分配好的数组 (大小由 count 给出)
+	// indices 里的顶点编号从 base_vertex 开始；三角形的朝向与 generate_surface_mesh 一致 (du x dv 为正面)
+	// 边界顶点按边的控制点以固定方向求值，共享同一条边的曲面片得到逐位相同的坐标
+	static void tessellate(const CubicPatch& patch, const PatchLevels& levels,
+		Vec3f* positions, Vec3f* normals, Vec2f* uvs, int* indices, int base_vertex);
+
+	// 按 shader 当前的 model / view / projection 选择等级，细分并绘制
+	// 返回后 shader 的输入视图被清空 (指向的临时内存已回收)
+	Stats draw(Rasterizer& r, BlinnPhongShader& shader, std::span<const CubicPatch> patches) const;
+};
@@ -4,15 +4,33 @@
 #include <sstream>
 #include "Rasterizer.h"
 #include "Texture.h"
+#include "TextureManager.h"
+#include "VirtualTexture.h"
 #include "RenderUtils.h"
 #include "Model.h"
+#include "MeshOptimizer.h"
+#include "QuantizedMesh.h"
+#include "MeshStream.h"
+#include "MeshProcessing.h"
+#include "FrameArena.h"
+#include "ThreadPool.h"
+#include "CubicPatch.h"
+#include "Tessellator.h"
+#include "PatchMesh.h"
+#include <unordered_map>
 #include "Camera.h"
 #include "Object.h"     // 包含 AABB
 #include "Primitives.h" 
 #include "BVH.h"
+#include "LinearBVH.h"
+#include "WideBVH.h"
+#include "TriangleMesh.h"
 #include <iosfwd>
 #include "scene.h"
 #include "RayTracer.h"
+#include <chrono>
+#include <fstream>
+#include <cstdio>
 
 // ==========================================
 // 验证测试：Flat vs Gouraud vs Phong
@@ -184,18 +202,20 @@ void TestCC::run_rainbow_triangle_demo() {
 	shader.model = Mat4::identity();
 
 	// 3. 准备顶点数据 (三角形)
-	shader.in_positions = {
+	std::vector<Vec3f> positions = {
 		{0.0f, 0.5f, 0.0f},   // 上
 		{-0.5f, -0.5f, 0.0f}, // 左下
 		{0.5f, -0.5f, 0.0f}   // 右下
 	};
 
 	// 4. 准备颜色数据 (RGB)
-	shader.in_colors = {
+	std::vector<Vec3f> colors = {
 		{1.0f, 0.0f, 0.0f}, // 红
 		{0.0f, 1.0f, 0.0f}, // 绿
 		{0.0f, 0.0f, 1.0f}  // 蓝
 	};
+	shader.in_positions = positions;
+	shader.in_colors = colors;
 
 	// 5. 绘制
 	r.clear(Vec3f(0.1f, 0.1f, 0.1f)); // 深灰背景
@@ -268,9 +288,8 @@ void TestCC::run_texture_test() {
 	Rasterizer r(width, height);
 
 	// --- 1. 准备纹理 ---
-	Texture checker_tex;
-	checker_tex.setScale(10.0f); // 10x10 的格子
-	checker_tex.setColors(Vec3f(1.0f, 1.0f, 1.0f), Vec3f(0.1f, 0.1f, 0.1f)); // 白/黑格
+	auto checker_tex = std::make_shared<Texture>();
+	checker_tex->setColors(Vec3f(1.0f, 1.0f, 1.0f), Vec3f(0.1f, 0.1f, 0.1f)); // 白/黑格
 
 	// --- 2. 准备 Shader ---
 	BlinnPhongShader shader;
@@ -294,7 +313,8 @@ void TestCC::run_texture_test() {
 	shader.light.intensity = Vec3f(80.0f, 80.0f, 80.0f);
 
 	// --- 4. 设置材质与纹理 ---
-	shader.texture = &checker_tex;
+	shader.texture = checker_tex;
+	shader.sampler.uv_scale = 10.0f; // 10x10 的格子
 	shader.use_texture = true;
 	shader.p = 150.0f; // 高光锐度
 
@@ -315,7 +335,7 @@ void TestCC::run_texture_test() {
 	r.clear(Vec3f(0, 0, 0)); // 清除背景为黑色
 
 	// 注意：draw 接受的是顶点数量
-	r.draw(shader, shader.in_positions.size());
+	r.draw(shader, shader.vertex_count());
 
 	r.save_to_ppm("texture_modulation_test.ppm");
 	std::cout << "Done. Saved to texture_modulation_test.ppm" << std::endl;
@@ -333,17 +353,16 @@ void TestCC::run_integrated_test() {
 
 	// --- 准备资源 ---
 	Mesh quad = Geometry::generate_quad();
-	Texture tex;
+	auto tex = std::make_shared<Texture>();
 
 	// 配置纹理参数
-	// A. 这里的 scale 决定了棋盘格的密度
-	tex.setScale(10.0f);
-	// B. 创建一个极低分辨率的 Buffer (16x16)，用于测试 Bilinear 的模糊效果
-	tex.createTestPattern(16, 16);
+	// 创建一个极低分辨率的 Buffer (16x16)，用于测试 Bilinear 的模糊效果
+	tex->createTestPattern(16, 16);
 
 	// --- 准备 Shader ---
 	BlinnPhongShader shader;
-	shader.texture = &tex;
+	shader.texture = tex;
+	shader.sampler.uv_scale = 10.0f; // 棋盘格的密度 (双线性模式下同样平铺 10 次)
 	shader.use_texture = true;
 
 	// 设置高环境光，让纹理看得更清楚，不受光照角度影响太深
@@ -379,7 +398,7 @@ void TestCC::run_integrated_test() {
 	shader.sample_mode = BlinnPhongShader::MODE_CHECKERBOARD; // <--- 切换模式
 
 	r.clear(Vec3f(0.5f, 0.7f, 0.9f)); // 天空蓝背景
-	r.draw(shader, shader.in_positions.size());
+	r.draw(shader, shader.vertex_count());
 	r.save_to_ppm("test_01_perspective.ppm");
 
 	// ==========================================
@@ -389,7 +408,7 @@ void TestCC::run_integrated_test() {
 	shader.sample_mode = BlinnPhongShader::MODE_BILINEAR; // <--- 切换模式
 
 	r.clear(Vec3f(0.5f, 0.7f, 0.9f)); // 天空蓝背景
-	r.draw(shader, shader.in_positions.size());
+	r.draw(shader, shader.vertex_count());
 	r.save_to_ppm("test_02_bilinear.ppm");
 }
 
@@ -401,15 +420,16 @@ void TestCC::scene_image_texture_test() {
 	std::cout << "[Test] Image Texture Loading..." << std::endl;
 	Rasterizer r(800, 600);
 
-	// 1. 创建纹理并加载图片
-	Texture tex;
+	// 1. 通过缓存加载图片 (同一路径只解码一次)
 	// 尝试加载图片 (请确保文件存在!)
-	if (!tex.loadTexture("assets/textures/emoji.png")) {
+	std::shared_ptr<const Texture> tex = TextureManager::instance().load("assets/textures/emoji.png");
+	if (!tex) {
 		std::cerr << "Error: Could not load emoji.png. Make sure the file is in the working directory." << std::endl;
 		// 如果失败，生成一个测试图兜底
-		tex.createTestPattern(64, 64);
+		auto fallback = std::make_shared<Texture>();
+		fallback->createTestPattern(64, 64);
+		tex = fallback;
 	}
-	tex.setScale(10.0f);
 
 	// 2. 创建 Mesh
 	Mesh quad = Geometry::generate_quad();
@@ -425,42 +445,24 @@ void TestCC::scene_image_texture_test() {
 	shader.view = Mat4::lookAt(Vec3f(0, 0, 3), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
 	shader.camera_pos = Vec3f(0, 0, 3);
 
-	shader.texture = &tex;
+	shader.texture = tex;
+	shader.sampler.uv_scale = 10.0f; // 平铺 10 次：只改这个 shader 的采样器，缓存里的纹理保持不变
 	shader.use_texture = true;
 	shader.sample_mode = BlinnPhongShader::MODE_BILINEAR;
 
 	// 4. 绘制
 	bind_mesh_to_shader(quad, shader);
 	r.clear(Vec3f(0.5f, 0.7f, 0.9f));
-	r.draw(shader, shader.in_positions.size());
+	r.draw(shader, shader.vertex_count());
 	r.save_to_ppm("output_image_texture.ppm");
 }
 
 void TestCC::normalize_mesh(Mesh& mesh) {
 	if (mesh.positions.empty()) return;
 
-	// 1. 计算包围盒
-	Vec3f min_box(1e9, 1e9, 1e9);
-	Vec3f max_box(-1e9, -1e9, -1e9);
-
-	for (const auto& p : mesh.positions) {
-		if (p.x < min_box.x) min_box.x = p.x;
-		if (p.y < min_box.y) min_box.y = p.y;
-		if (p.z < min_box.z) min_box.z = p.z;
-
-		if (p.x > max_box.x) max_box.x = p.x;
-		if (p.y > max_box.y) max_box.y = p.y;
-		if (p.z > max_box.z) max_box.z = p.z;
-	}
-
-	// 2. 计算中心点和最大跨度
-	Vec3f center = (max_box + min_box) * 0.5f;
-	float max_dim = std::max(max_box.x - min_box.x, std::max(max_box.y - min_box.y, max_box.z - min_box.z));
-
-	// 3. 归一化所有顶点
-	for (auto& p : mesh.positions) {
-		p = (p - center) * (2.0f / max_dim); // 缩放到 [-1, 1]
-	}
+	// 平移到原点并缩放到 [-1, 1] (并行实现见 MeshProcessing)
+	MeshBounds bounds = MeshProcessing::normalize(mesh, 2.0f);
+	Vec3f center = (bounds.min + bounds.max) * 0.5f;
 
 	std::cout << "Mesh Normalized. Center moved from " << center.x << "," << center.y << " to 0,0" << std::endl;
 }
@@ -471,15 +473,10 @@ void TestCC::run_model_loading_test() {
 	Mesh mesh = model.get_mesh();
 	normalize_mesh(mesh);
 
-	// 2. 加载对应的纹理
-	Texture tex;
-	tex.loadTexture("assets/models/texture.png");
-	tex.setScale(1.0f);
-
-	// 3. 配置 Shader
+	// 2. 配置 Shader，纹理走缓存加载 (多个场景共用同一份解码结果)
 	BlinnPhongShader shader;
 	setup_base_shader(shader, 800, 600);
-	shader.texture = &tex;
+	shader.texture = TextureManager::instance().load("assets/models/texture.png");
 	shader.use_texture = true;
 
 	// 调整模型位置
@@ -492,7 +489,7 @@ void TestCC::run_model_loading_test() {
 
 	Rasterizer r(800, 600);
 	r.clear(Vec3f(0.1f, 0.1f, 0.1f));
-	r.draw(shader, shader.in_positions.size());
+	r.draw(shader, shader.vertex_count());
 	r.save_to_ppm("obj_test.ppm");
 }
 
@@ -506,12 +503,9 @@ void TestCC::run_turntable_animation() {
 
 	normalize_mesh(mesh);
 
-	Texture tex;
-	tex.loadTexture("assets/models/texture.png");
-
 	BlinnPhongShader shader;
 	setup_base_shader(shader, 800, 600);
-	shader.texture = &tex;
+	shader.texture = TextureManager::instance().load("assets/models/texture.png");
 	shader.use_texture = true;
 
 	// 2. 初始化摄像机
@@ -531,7 +525,7 @@ void TestCC::run_turntable_animation() {
 
 		// 绘制
 		bind_mesh_to_shader(mesh, shader);
-		r.draw(shader, shader.in_positions.size());
+		r.draw(shader, shader.vertex_count());
 
 		// 保存文件 (frame_000.ppm, frame_001.ppm ...)
 		std::stringstream ss;
@@ -627,6 +621,9 @@ void TestCC::run_bezier_surface_test() {
 
 	// 2. 生成网格 (细分等级 20 -> 400个小方格 -> 800个三角形)
 	Mesh mesh = Geometry::Bezier::generate_surface_mesh(cp, 20, 20);
+	FrameArena::Stats scratch = FrameArena::local().end_frame();
+	std::cout << "Surface tessellated, scratch: " << scratch.allocations << " allocs, "
+		<< scratch.bytes / 1024 << " KB, peak " << scratch.peak_bytes << " bytes, " << scratch.block_allocations << " heap blocks" << std::endl;
 
 	// 3. 渲染流程
 	Rasterizer r(800, 600);
@@ -671,7 +668,7 @@ void TestCC::run_ray_tracing_test()
 	normalize_mesh(mesh);
 
 	Scene scene;
-	scene.add_model(ace_model); // 自动转换为三角形列表
+	scene.add_model(ace_model); // 整个网格作为一个 TriangleMesh (引用 ace_model 的数据)
 	/*// 添加一个球体 (绿色小球)
 	scene.add_object(new Sphere(Vec3f(0, 0, -1), 0.5f));
 	// 添加一个巨大的球体作为地板
@@ -686,6 +683,8 @@ void TestCC::run_ray_tracing_test()
 
 	std::cout << "Building scene..." << std::endl;
 	scene.build(); // 构建加速结构
+	std::cout << "BVH: " << scene.bvh()->node_count() << " nodes, SAH cost " << scene.bvh()->sah_cost()
+		<< ", build " << scene.build_seconds() << " s" << std::endl;
 
 
 	// 4. 创建渲染器并运行
@@ -699,3 +698,1069 @@ void TestCC::run_ray_tracing_test()
 
 	return;
 }
+
+// ==========================================
+// Benchmark：纹素布局 vs 旋转 UV 采样吞吐
+// ==========================================
+void TestCC::run_texture_layout_benchmark() {
+	std::cout << "Running Texture Layout Benchmark..." << std::endl;
+
+	const int grid = 512;          // 每轮采样 grid x grid 个点
+	const int rounds = 8;
+	const float angles[] = { 0.0f, 30.0f, 45.0f, 90.0f };
+	const int sizes[] = { 1024, 1000 }; // 2 的幂 / 非 2 的幂
+	const TexelLayout layouts[] = { TexelLayout::Linear, TexelLayout::Tiled, TexelLayout::Morton };
+	const char* layout_names[] = { "Linear", "Tiled", "Morton" };
+
+	for (int size : sizes) {
+		Texture tex;
+		tex.createTestPattern(size, size);
+
+		for (int li = 0; li < 3; ++li) {
+			tex.setLayout(layouts[li]);
+			if (tex.getLayout() != layouts[li]) {
+				std::cout << "  " << size << "x" << size << " " << layout_names[li] << ": not supported, skipped" << std::endl;
+				continue;
+			}
+
+			for (float angle : angles) {
+				// 旋转后的 UV 基向量：每个采样步长约 1 个纹素，模拟 1:1 放大率下的斜向扫描
+				float rad = angle * 3.14159265f / 180.0f;
+				float step = 1.0f / size;
+				float du_x = std::cos(rad) * step, dv_x = std::sin(rad) * step;
+				float du_y = -std::sin(rad) * step, dv_y = std::cos(rad) * step;
+
+				Vec3f checksum(0, 0, 0);
+				auto t0 = std::chrono::high_resolution_clock::now();
+				for (int r = 0; r < rounds; ++r) {
+					for (int y = 0; y < grid; ++y) {
+						for (int x = 0; x < grid; ++x) {
+							float u = x * du_x + y * du_y + r * 0.37f;
+							float v = x * dv_x + y * dv_y + r * 0.11f;
+							checksum = checksum + tex.getColorBilinear(u, v);
+						}
+					}
+				}
+				auto t1 = std::chrono::high_resolution_clock::now();
+
+				double seconds = std::chrono::duration<double>(t1 - t0).count();
+				double msps = (double)grid * grid * rounds / seconds / 1e6;
+				std::cout << "  " << size << "x" << size << " " << std::setw(6) << layout_names[li]
+					<< " angle " << std::setw(2) << (int)angle << ": "
+					<< std::fixed << std::setprecision(2) << msps << " Msamples/s"
+					<< " (checksum " << checksum.x + checksum.y + checksum.z << ")" << std::endl;
+				std::cout.unsetf(std::ios::fixed);
+			}
+		}
+	}
+}
+
+// ==========================================
+// 验证测试：虚拟纹理 (缺页回退 + 帧间换页)
+// ==========================================
+void TestCC::run_virtual_texture_test() {
+	std::cout << "[Test] Virtual Texture Paging..." << std::endl;
+
+	// 1. 离线切块 (真实场景里 .vtex 由资源管线提前生成)
+	const std::string vtex_path = "output_texture.vtex";
+	if (!VirtualTexture::build("assets/models/texture.png", vtex_path, 64)) return;
+
+	// 缓存只有 128 个 Tile (约 1.5MB)，远小于整条 Mip 链
+	auto vt = std::make_shared<VirtualTexture>();
+	if (!vt->open(vtex_path, 128)) return;
+
+	// 2. 倾斜的平面：近处需要精细 Mip，远处只需要粗 Mip
+	Rasterizer r(800, 600);
+	Mesh quad = Geometry::generate_quad();
+
+	BlinnPhongShader shader;
+	setup_base_shader(shader, 800, 600);
+	shader.model = Mat4::translate(0, 0, -1.0f) * Mat4::rotateX(-70);
+	shader.view = Mat4::lookAt(Vec3f(0, 0, 3), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+	shader.camera_pos = Vec3f(0, 0, 3);
+	shader.virtual_texture = vt;
+	shader.use_texture = true;
+	bind_mesh_to_shader(quad, shader);
+
+	// 3. 连续渲染几帧：第 0 帧全部来自常驻的最粗一级，之后逐帧变清晰
+	for (int frame = 0; frame < 5; ++frame) {
+		r.clear(Vec3f(0.5f, 0.7f, 0.9f));
+		r.draw(shader, shader.vertex_count());
+
+		std::stringstream ss;
+		ss << "output_virtual_texture_" << frame << ".ppm";
+		r.save_to_ppm(ss.str().c_str());
+
+		VirtualTexture::Stats before = vt->stats();
+		int uploaded = vt->update(32);
+		VirtualTexture::Stats after = vt->stats();
+		std::cout << "  frame " << frame << ": requests " << before.pending
+			<< ", uploaded " << uploaded
+			<< ", resident " << after.resident << "/" << after.capacity
+			<< ", evictions " << after.evictions
+			<< ", fallbacks " << after.fallbacks << std::endl;
+	}
+}
+
+// ==========================================
+// 辅助：生成 N x N 的波浪网格 OBJ (v/vt/vn 齐全，四边形面)
+// ==========================================
+static void write_wave_grid_obj(const std::string& path, int n) {
+	std::ofstream out(path, std::ios::binary);
+	char line[128];
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			float u = (float)x / (n - 1), v = (float)y / (n - 1);
+			int len = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", u * 2 - 1, std::sin(u * 20.0f) * 0.1f, v * 2 - 1);
+			out.write(line, len);
+			len = snprintf(line, sizeof(line), "vt %.6f %.6f\n", u, v);
+			out.write(line, len);
+			len = snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", 0.0f, 1.0f, 0.0f);
+			out.write(line, len);
+		}
+	}
+	for (int y = 0; y < n - 1; ++y) {
+		for (int x = 0; x < n - 1; ++x) {
+			// 逆时针朝 +Y (与 vn 一致)
+			int a = y * n + x + 1, b = a + 1, c = a + n + 1, d = a + n;
+			int len = snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, d, d, d, c, c, c, b, b, b);
+			out.write(line, len);
+		}
+	}
+}
+
+// ==========================================
+// Benchmark：OBJ 解析吞吐 (Stream vs Parallel)
+// ==========================================
+void TestCC::run_obj_loader_benchmark() {
+	std::cout << "Running OBJ Loader Benchmark..." << std::endl;
+
+	// 1. 生成一个足够大的测试 OBJ
+	const std::string path = "output_benchmark.obj";
+	write_wave_grid_obj(path, 700);
+	std::ifstream probe(path, std::ios::binary | std::ios::ate);
+	double megabytes = (double)probe.tellg() / (1024.0 * 1024.0);
+
+	// 2. 两种解析器各跑一次：绕过缓存、不做重排，计时只包含解析和去重
+	auto checksum = [](const Mesh& mesh) {
+		double sum = 0.0;
+		for (int k : mesh.indices) sum += mesh.positions[k].x + mesh.positions[k].y * 3 + mesh.uvs[k].x * 5 + mesh.normals[k].y * 7;
+		return sum;
+	};
+	auto seconds_since = [](std::chrono::high_resolution_clock::time_point t0) {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+	};
+	auto report = [&](const char* name, double seconds, const Mesh& mesh, bool throughput) {
+		std::cout << "  " << std::setw(8) << name << ": " << std::fixed << std::setprecision(3) << seconds << " s";
+		if (throughput) std::cout << ", " << std::setprecision(1) << megabytes / seconds << " MB/s";
+		std::cout << " (" << mesh.indices.size() / 3 << " tris, " << mesh.positions.size() << " verts)" << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+		std::cout.precision(6);
+	};
+
+	const char* names[] = { "Stream", "Parallel" };
+	Mesh parsed[2];
+	for (int i = 0; i < 2; ++i) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		Model model(path, i == 0 ? Model::ObjParser::Stream : Model::ObjParser::Parallel, false, false);
+		double seconds = seconds_since(t0);
+		parsed[i] = model.get_mesh();
+		report(names[i], seconds, parsed[i], true);
+	}
+
+	// 3. 加载 OBJ 时的其余步骤单独计时：三角形重排、写缓存；再测命中缓存的读取
+	Mesh optimized = parsed[1];
+	auto t0 = std::chrono::high_resolution_clock::now();
+	MeshOptimizer::optimize(optimized);
+	report("optimize", seconds_since(t0), optimized, false);
+
+	std::remove(MeshCache::cache_path(path).c_str());
+	MeshBounds bounds = MeshCache::compute_bounds(optimized);
+	t0 = std::chrono::high_resolution_clock::now();
+	MeshCache::save(path, optimized, bounds);
+	report("Cache(w)", seconds_since(t0), optimized, false);
+
+	Mesh cached;
+	MeshBounds cached_bounds;
+	t0 = std::chrono::high_resolution_clock::now();
+	bool hit = MeshCache::load(path, cached, cached_bounds);
+	report("Cache(r)", seconds_since(t0), cached, true);
+
+	// 两种解析器的结果逐顶点相同；缓存读回的与重排后的相同
+	bool match = parsed[0].indices.size() == parsed[1].indices.size() && checksum(parsed[0]) == checksum(parsed[1])
+		&& hit && cached.indices == optimized.indices && checksum(cached) == checksum(optimized);
+	std::cout << "  file " << std::fixed << std::setprecision(1) << megabytes << " MB, results "
+		<< (match ? "match" : "MISMATCH") << std::endl;
+	std::cout.unsetf(std::ios::fixed);
+	std::cout.precision(6);
+}
+
+// ==========================================
+// 验证测试：压缩顶点 (误差 + 内存 + 渲染对比)
+// ==========================================
+void TestCC::run_quantized_mesh_test() {
+	std::cout << "[Test] Quantized Mesh..." << std::endl;
+
+	Mesh mesh = Geometry::generate_sphere(1.0f, 64, 64);
+	for (Vec2f& uv : mesh.uvs) uv = uv * 4.0f; // 放大 UV，检查 half 在 [0, 4] 的精度
+	QuantizedMesh packed = QuantizedMesh::from_mesh(mesh);
+
+	// 1. 误差统计
+	float max_pos_err = 0.0f, max_normal_err = 0.0f, max_uv_err = 0.0f;
+	for (size_t i = 0; i < mesh.positions.size(); ++i) {
+		max_pos_err = std::max(max_pos_err, (packed.position(i) - mesh.positions[i]).length());
+		float cos_angle = std::min(1.0f, packed.normal(i).dot(mesh.normals[i].normalize()));
+		max_normal_err = std::max(max_normal_err, std::acos(cos_angle) * 180.0f / 3.14159265f);
+		Vec2f uv = packed.uv(i);
+		max_uv_err = std::max({ max_uv_err, std::abs(uv.x - mesh.uvs[i].x), std::abs(uv.y - mesh.uvs[i].y) });
+	}
+	size_t float_bytes = mesh.positions.size() * (sizeof(Vec3f) * 2 + sizeof(Vec2f));
+	size_t packed_bytes = packed.vertices.size() * sizeof(PackedVertex);
+	std::cout << "  vertices: " << mesh.positions.size()
+		<< ", vertex memory " << float_bytes << " -> " << packed_bytes << " bytes" << std::endl;
+	std::cout << "  max error: position " << max_pos_err << ", normal " << max_normal_err
+		<< " deg, uv " << max_uv_err << std::endl;
+
+	// 2. 左边浮点，右边压缩，肉眼应当看不出区别 (光源不对称，两边本身不是镜像)
+	Rasterizer r(800, 400);
+	r.clear(Vec3f(0.1f, 0.1f, 0.1f));
+	BlinnPhongShader shader;
+	setup_base_shader(shader, 800, 400);
+	shader.view = Mat4::lookAt(Vec3f(0, 0, 4), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+	shader.camera_pos = Vec3f(0, 0, 4);
+
+	shader.model = Mat4::translate(-1.2f, 0, 0);
+	bind_mesh_to_shader(mesh, shader);
+	r.draw(shader, shader.vertex_count());
+
+	shader.model = Mat4::translate(1.2f, 0, 0);
+	bind_quantized_mesh_to_shader(packed, shader);
+	r.draw(shader, packed.indices.size());
+
+	r.save_to_ppm("output_quantized_mesh.ppm");
+
+	// 3. 光线追踪：TriangleMesh 直接建在压缩顶点上 (不解码出浮点 Mesh)，与浮点版本逐条光线比较
+	TriangleMesh float_rt(mesh);
+	TriangleMesh packed_rt(packed);
+	const int grid = 128;
+	int hits = 0, mismatched = 0;
+	float max_t_err = 0.0f, max_rt_normal_err = 0.0f;
+	for (int y = 0; y < grid; ++y) {
+		for (int x = 0; x < grid; ++x) {
+			Ray ray(Vec3f(2.4f * x / grid - 1.2f, 2.4f * y / grid - 1.2f, 4.0f), Vec3f(0, 0, -1));
+			HitRecord a, b;
+			bool hit_a = float_rt.intersect(ray, 0.001f, 100.0f, a);
+			bool hit_b = packed_rt.intersect(ray, 0.001f, 100.0f, b);
+			if (hit_a != hit_b) { mismatched++; continue; }
+			if (!hit_a) continue;
+			hits++;
+			max_t_err = std::max(max_t_err, std::abs(a.t - b.t));
+			max_rt_normal_err = std::max(max_rt_normal_err, std::acos(std::min(1.0f, a.normal.dot(b.normal))) * 180.0f / 3.14159265f);
+		}
+	}
+	std::cout << "  ray traced: " << hits << " hits, " << mismatched << " mismatched (silhouette), max t error " << max_t_err
+		<< ", max normal error " << max_rt_normal_err << " deg" << std::endl;
+	std::cout << "  TriangleMesh data excluding vertices: float " << float_rt.memory_bytes() << " bytes, quantized "
+		<< packed_rt.memory_bytes() << " bytes; vertices " << float_bytes << " -> " << packed_bytes << " bytes" << std::endl;
+}
+
+// ==========================================
+// 验证测试：流式 Mesh (分块光栅化 + 分块 BVH)
+// ==========================================
+void TestCC::run_streaming_mesh_test() {
+	std::cout << "[Test] Streaming Mesh..." << std::endl;
+
+	const std::string path = "output_stream.obj";
+	write_wave_grid_obj(path, 400);
+	std::remove(MeshCache::cache_path(path).c_str());
+
+	// 1. 光栅化：预算故意设得很小 (4MB)，每块读入 -> 绘制 -> 丢弃
+	// 第一遍直接读 OBJ；随后让 Model 生成 .srmesh 缓存，第二遍走二进制映射
+	for (int pass = 0; pass < 2; ++pass) {
+		if (pass == 1) Model warm_cache(path);
+
+		MeshStream stream;
+		if (!stream.open(path, 4 << 20)) return;
+
+		Rasterizer r(800, 600);
+		r.clear(Vec3f(0.5f, 0.7f, 0.9f));
+		BlinnPhongShader shader;
+		setup_base_shader(shader, 800, 600);
+		shader.view = Mat4::lookAt(Vec3f(0, 1.5f, 2.5f), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+		shader.camera_pos = Vec3f(0, 1.5f, 2.5f);
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		Mesh chunk;
+		size_t chunks = 0;
+		while (stream.next(chunk)) {
+			bind_mesh_to_shader(chunk, shader);
+			r.draw(shader, shader.vertex_count());
+			chunks++;
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		r.save_to_ppm(pass == 0 ? "output_stream_obj.ppm" : "output_stream_binary.ppm");
+		std::cout << "  " << (stream.is_binary() ? "binary" : "obj") << ": " << stream.triangles_read() << " tris in "
+			<< chunks << " chunks, peak resident " << stream.peak_resident_bytes() / 1024 << " KB, "
+			<< std::chrono::duration<double>(t1 - t0).count() << " s" << std::endl;
+	}
+
+	// 2. 光线追踪：分块 BVH (所有块最终都常驻在 Scene 里，流式只省掉了加载时的整份拷贝)
+	MeshStream stream;
+	if (!stream.open(path, 4 << 20)) return;
+	Scene scene;
+	auto t0 = std::chrono::high_resolution_clock::now();
+	scene.add_stream(stream);
+	scene.build();
+	auto t1 = std::chrono::high_resolution_clock::now();
+	std::cout << "  chunked BVH build: " << std::chrono::duration<double>(t1 - t0).count() << " s" << std::endl;
+
+	Rasterizer rst(400, 300);
+	OrbitCamera camera(Vec3f(0, 0, 0), 3.0f);
+	camera.aspect = 400.0f / 300.0f;
+	camera.phi = 0.5f;
+	RayTracer tracer(&rst, &scene, &camera);
+	tracer.render();
+	rst.save_to_ppm("output_stream_rt.ppm");
+}
+
+// ==========================================
+// 验证测试：Mesh 预处理 (法线 / 切线 / 包围盒)
+// ==========================================
+void TestCC::run_mesh_processing_test() {
+	std::cout << "[Test] Mesh Processing..." << std::endl;
+
+	Model model("assets/models/ace.obj");
+	Mesh mesh = model.get_mesh();
+	normalize_mesh(mesh);
+
+	// 1. 重新生成法线，和文件里的法线比较 (两种加权)
+	auto angle_error = [&](const std::vector<Vec3f>& normals) {
+		double sum = 0.0;
+		for (size_t i = 0; i < normals.size(); ++i) {
+			float c = std::clamp(normals[i].dot(mesh.normals[i].normalize()), -1.0f, 1.0f);
+			sum += std::acos(c) * 180.0 / 3.14159265;
+		}
+		return normals.empty() ? 0.0 : sum / normals.size();
+	};
+	const MeshProcessing::NormalWeighting modes[] = { MeshProcessing::NormalWeighting::Area, MeshProcessing::NormalWeighting::Angle };
+	const char* names[] = { "area", "angle" };
+	std::vector<Vec3f> generated;
+	for (int m = 0; m < 2; ++m) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		generated = MeshProcessing::vertex_normals(mesh, modes[m]);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		std::cout << "  normals (" << names[m] << "): " << std::chrono::duration<double>(t1 - t0).count()
+			<< " s, mean deviation from file " << angle_error(generated) << " deg" << std::endl;
+	}
+
+	// 2. 切线：与法线正交、单位长度
+	auto t0 = std::chrono::high_resolution_clock::now();
+	MeshProcessing::compute_tangents(mesh);
+	auto t1 = std::chrono::high_resolution_clock::now();
+	float max_dot = 0.0f;
+	for (size_t i = 0; i < mesh.tangents.size(); ++i) {
+		Vec3f t(mesh.tangents[i].x, mesh.tangents[i].y, mesh.tangents[i].z);
+		max_dot = std::max(max_dot, std::abs(t.dot(mesh.normals[i].normalize())));
+	}
+	std::cout << "  tangents: " << std::chrono::duration<double>(t1 - t0).count()
+		<< " s, max |dot(T, N)| " << max_dot << std::endl;
+
+	// 3. 用生成的法线渲染 (角度加权)
+	mesh.normals = generated;
+	BlinnPhongShader shader;
+	setup_base_shader(shader, 800, 600);
+	shader.texture = TextureManager::instance().load("assets/models/texture.png");
+	shader.use_texture = true;
+	shader.model = Mat4::translate(0, 0, -3.0f);
+	shader.view = Mat4::lookAt(Vec3f(0, 0, 0), Vec3f(0, 0, -1), Vec3f(0, 1, 0));
+	bind_mesh_to_shader(mesh, shader);
+
+	Rasterizer r(800, 600);
+	r.clear(Vec3f(0.1f, 0.1f, 0.1f));
+	r.draw(shader, shader.vertex_count());
+	r.save_to_ppm("output_generated_normals.ppm");
+}
+
+// ==========================================
+// Benchmark：Bezier 曲面细分 (De Casteljau + 有限差分 vs CubicPatch)
+// ==========================================
+void TestCC::run_bezier_tessellation_benchmark() {
+	std::cout << "Running Bezier Tessellation Benchmark..." << std::endl;
+
+	// 与 run_bezier_surface_test 相同的波浪曲面
+	std::vector<Vec3f> cp;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			float y = 0.0f;
+			if ((i == 1 || i == 2) && (j == 1 || j == 2)) y = 1.5f;
+			if ((i == 0 && j == 0) || (i == 3 && j == 3)) y = -1.0f;
+			cp.push_back(Vec3f(-2.0f + j * 4.0f / 3.0f, y, -2.0f + i * 4.0f / 3.0f));
+		}
+	}
+
+	const int div = 256;
+	const size_t count = (size_t)(div + 1) * (div + 1);
+
+	// 1. 旧做法：每个顶点 5 次 eval_surface (位置 + 4 次差分求法线)
+	std::vector<Vec3f> ref_pos(count), ref_nor(count);
+	auto t0 = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i <= div; ++i) {
+		float v = (float)i / div;
+		for (int j = 0; j <= div; ++j) {
+			float u = (float)j / div;
+			const float eps = 0.001f;
+			Vec3f p_L = Geometry::Bezier::eval_surface(cp, std::max(0.0f, u - eps), v);
+			Vec3f p_R = Geometry::Bezier::eval_surface(cp, std::min(1.0f, u + eps), v);
+			Vec3f p_B = Geometry::Bezier::eval_surface(cp, u, std::max(0.0f, v - eps));
+			Vec3f p_T = Geometry::Bezier::eval_surface(cp, u, std::min(1.0f, v + eps));
+			ref_pos[i * (div + 1) + j] = Geometry::Bezier::eval_surface(cp, u, v);
+			ref_nor[i * (div + 1) + j] = (p_R - p_L).normalize().cross((p_T - p_B).normalize()).normalize();
+		}
+	}
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	// 2. CubicPatch：解析导数 + 前向差分 + 按行并行
+	std::vector<Vec3f> pos(count), nor(count);
+	std::vector<Vec2f> uvs(count);
+	CubicPatch patch(cp);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	patch.tessellate(div, div, pos.data(), nor.data(), uvs.data());
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	float max_pos_err = 0.0f, max_angle = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		max_pos_err = std::max(max_pos_err, (pos[i] - ref_pos[i]).length());
+		float c = std::clamp(nor[i].dot(ref_nor[i]), -1.0f, 1.0f);
+		max_angle = std::max(max_angle, std::acos(c) * 180.0f / 3.14159265f);
+	}
+
+	double old_s = std::chrono::duration<double>(t1 - t0).count();
+	double new_s = std::chrono::duration<double>(t3 - t2).count();
+	std::cout << "  " << div << "x" << div << " grid, " << count << " verts" << std::endl;
+	std::cout << "  De Casteljau + finite diff: " << old_s << " s" << std::endl;
+	std::cout << "  CubicPatch:                 " << new_s << " s (" << old_s / new_s << "x)" << std::endl;
+	std::cout << "  max position error " << max_pos_err << ", max normal difference " << max_angle << " deg" << std::endl;
+}
+
+// ==========================================
+// 验证测试：屏幕空间自适应细分 (Bezier 地形)
+// ==========================================
+// 地形由 N x N 个曲面片拼成，控制点取自同一张 (3N+1)^2 的高度格点，相邻曲面片共享边界控制点
+void TestCC::run_adaptive_tessellation_test() {
+	std::cout << "[Test] Adaptive Tessellation..." << std::endl;
+
+	const int N = 16;
+	const float extent = 40.0f;
+	const int lattice = 3 * N + 1;
+	auto height = [](float x, float z) { return std::sin(x * 0.35f) * std::cos(z * 0.3f) * 1.5f + std::sin(x * 0.9f + z * 1.3f) * 0.3f; };
+
+	std::vector<CubicPatch> patches;
+	for (int pj = 0; pj < N; ++pj) {
+		for (int pi = 0; pi < N; ++pi) {
+			CubicPatch patch;
+			for (int r = 0; r < 4; ++r) {
+				for (int c = 0; c < 4; ++c) {
+					float x = ((float)(3 * pi + c) / (lattice - 1) - 0.5f) * extent;
+					float z = (0.5f - (float)(3 * pj + r) / (lattice - 1)) * extent; // v 沿 -z，du x dv 朝上
+					patch.cp[r * 4 + c] = Vec3f(x, height(x, z), z);
+				}
+			}
+			patches.push_back(patch);
+		}
+	}
+
+	PatchTessellator tessellator;
+	tessellator.settings.target_edge_pixels = 6.0f;
+
+	// 近处贴地和远处俯视两个机位：三角形数量应随屏幕上的大小变化
+	// 每个机位算一帧：细分结果放在帧内临时内存里，帧末回收并报告这一帧的临时分配
+	// (第一帧向堆申请内存块，之后的帧复用，heap 应为 0)
+	FrameArena::local().end_frame(); // 不把之前测试的分配算进第一帧
+	const Vec3f eyes[2] = { Vec3f(0, 4, 18), Vec3f(0, 40, 60) };
+	for (int k = 0; k < 2; ++k) {
+		Rasterizer r(800, 600);
+		r.clear(Vec3f(0.5f, 0.7f, 0.9f));
+		BlinnPhongShader shader;
+		setup_base_shader(shader, 800, 600);
+		shader.view = Mat4::lookAt(eyes[k], Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+		shader.camera_pos = eyes[k];
+		shader.light.position = Vec3f(10, 30, 10);
+		shader.light.intensity = Vec3f(700, 700, 700);
+		shader.k_d = Vec3f(0.4f, 0.7f, 0.3f);
+		shader.p = 20.0f;
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		PatchTessellator::Stats stats = tessellator.draw(r, shader, patches);
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		std::stringstream ss;
+		ss << "output_adaptive_tessellation_" << k << ".ppm";
+		r.save_to_ppm(ss.str().c_str());
+		std::cout << "  view " << k << ": " << stats.patches - stats.culled << "/" << stats.patches << " patches, "
+			<< stats.triangles << " tris in " << stats.batches << " batches ("
+			<< std::chrono::duration<double>(t1 - t0).count() << " s); uniform at max level would be "
+			<< patches.size() * 2 * tessellator.settings.max_level * tessellator.settings.max_level << std::endl;
+
+		FrameArena::Stats scratch = FrameArena::local().end_frame();
+		std::cout << "    scratch: " << scratch.allocations << " allocs, " << scratch.bytes / 1024 << " KB, peak "
+			<< scratch.peak_bytes / 1024 << " KB, " << scratch.block_allocations << " heap blocks" << std::endl;
+	}
+}
+
+// 生成一个胶囊体的 .bpt 文件：旋转曲面，轮廓 3 段 (上半球 / 圆柱 / 下半球) x 4 个象限 = 12 个曲面片
+// 两极的曲面片有一条边收缩成一点，用来检验焊接和退化三角形的处理
+static void write_capsule_bpt(const std::string& path, float radius, float half_height) {
+	const float k = 0.5522847f; // 三次 Bezier 近似四分之一圆
+	const float R = radius, h = half_height;
+	// 轮廓控制点 (r, y)，从上往下
+	const Vec2f profile[3][4] = {
+		{ Vec2f(0, h + R), Vec2f(k * R, h + R), Vec2f(R, h + k * R), Vec2f(R, h) },
+		{ Vec2f(R, h), Vec2f(R, h / 3), Vec2f(R, -h / 3), Vec2f(R, -h) },
+		{ Vec2f(R, -h), Vec2f(R, -h - k * R), Vec2f(k * R, -h - R), Vec2f(0, -h - R) }
+	};
+
+	std::ofstream out(path);
+	out << 12 << "\n";
+	char line[128];
+	for (int seg = 0; seg < 3; ++seg) {
+		for (int q = 0; q < 4; ++q) {
+			// 第一象限的圆弧控制点 (x, z)，旋转 q 个 90 度 (精确：(x, z) -> (-z, x))
+			Vec2f arc[4] = { Vec2f(1, 0), Vec2f(1, k), Vec2f(k, 1), Vec2f(0, 1) };
+			for (int r = 0; r < q; ++r) {
+				for (Vec2f& a : arc) a = Vec2f(-a.y, a.x);
+			}
+			out << "3 3\n";
+			for (int row = 0; row < 4; ++row) {
+				for (int col = 0; col < 4; ++col) {
+					const Vec2f& p = profile[seg][row];
+					int len = snprintf(line, sizeof(line), "%.9g %.9g %.9g\n", p.x * arc[col].x, p.y, p.x * arc[col].y);
+					out.write(line, len);
+				}
+			}
+		}
+	}
+}
+
+// ==========================================
+// 验证测试：多曲面片模型 (读取 + 并行细分 + 焊接)
+// ==========================================
+void TestCC::run_patch_mesh_test() {
+	std::cout << "[Test] Patch Mesh..." << std::endl;
+
+	const std::string path = "output_capsule.bpt";
+	write_capsule_bpt(path, 0.8f, 0.6f);
+
+	PatchMesh model;
+	if (!model.load(path)) return;
+
+	// 1. 统一等级细分，检查焊接后是否封闭：每条边恰好被两个三角形共享
+	const int level = 12;
+	size_t verts_per_patch = 0, tris_per_patch = 0;
+	PatchTessellator::count(PatchLevels::uniform(level), verts_per_patch, tris_per_patch);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	Mesh mesh = model.tessellate(level);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	std::unordered_map<uint64_t, int> edge_use;
+	for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+		for (int k = 0; k < 3; ++k) {
+			uint32_t a = mesh.indices[t + k], b = mesh.indices[t + (k + 1) % 3];
+			edge_use[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+		}
+	}
+	size_t open_edges = 0;
+	for (const auto& e : edge_use) open_edges += e.second != 2;
+
+	std::cout << "  level " << level << ": " << verts_per_patch * model.patch_count() << " -> " << mesh.positions.size()
+		<< " verts after welding, " << mesh.indices.size() / 3 << " tris, non-manifold edges " << open_edges
+		<< " (" << std::chrono::duration<double>(t1 - t0).count() << " s)" << std::endl;
+
+	// 2. 左：焊接后的网格；右：同一组曲面片走自适应细分直接绘制
+	Rasterizer r(800, 400);
+	r.clear(Vec3f(0.1f, 0.1f, 0.1f));
+	BlinnPhongShader shader;
+	setup_base_shader(shader, 800, 400);
+	shader.view = Mat4::lookAt(Vec3f(0, 1, 5), Vec3f(0, 0, 0), Vec3f(0, 1, 0));
+	shader.camera_pos = Vec3f(0, 1, 5);
+
+	shader.model = Mat4::translate(-1.3f, 0, 0);
+	bind_mesh_to_shader(mesh, shader);
+	r.draw(shader, shader.vertex_count());
+
+	shader.model = Mat4::translate(1.3f, 0, 0);
+	std::vector<CubicPatch> patches = model.to_patches();
+	PatchTessellator tessellator;
+	PatchTessellator::Stats stats = tessellator.draw(r, shader, patches);
+	std::cout << "  adaptive: " << stats.triangles << " tris" << std::endl;
+
+	r.save_to_ppm("output_patch_mesh.ppm");
+}
+
+// ==========================================
+// 验证测试：光线直接求交 Bezier 曲面片 vs 细分成三角形
+// ==========================================
+void TestCC::run_bezier_ray_tracing_test() {
+	std::cout << "[Test] Bezier Patch Ray Tracing..." << std::endl;
+
+	const std::string path = "output_capsule.bpt";
+	write_capsule_bpt(path, 0.8f, 0.6f);
+	PatchMesh model;
+	if (!model.load(path)) return;
+	std::vector<CubicPatch> patches = model.to_patches();
+
+	const int width = 400, height = 300;
+	OrbitCamera camera(Vec3f(0, 0, 0), 4.0f);
+	camera.aspect = (float)width / height;
+	camera.phi = 0.4f;
+	camera.theta = 0.6f;
+
+	auto render = [&](Scene& scene, const char* name, const char* file) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		scene.build();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		Rasterizer rst(width, height);
+		RayTracer tracer(&rst, &scene, &camera);
+		tracer.render();
+		auto t2 = std::chrono::high_resolution_clock::now();
+		rst.save_to_ppm(file);
+		std::cout << "  " << name << ": build " << std::chrono::duration<double>(t1 - t0).count() << " s, trace "
+			<< std::chrono::duration<double>(t2 - t1).count() << " s" << std::endl;
+	};
+
+	// 1. 直接求交：每个曲面片一个物体
+	{
+		Scene scene;
+		size_t bytes = 0, nodes = 0;
+		for (const CubicPatch& p : patches) {
+			BezierPatch* object = new BezierPatch(p);
+			nodes += object->node_count();
+			bytes += object->memory_bytes();
+			scene.add_object(object);
+		}
+		std::cout << "  patches: " << patches.size() << " objects, " << nodes << " hierarchy nodes, ~" << bytes / 1024 << " KB" << std::endl;
+		render(scene, "direct", "output_bezier_rt.ppm");
+	}
+
+	// 2. 对照：先细分成三角形 (细分等级要足够高，轮廓才不会看出折线)
+	{
+		Mesh mesh = model.tessellate(32);
+		Scene scene;
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			scene.add_object(new Triangle(mesh.positions[mesh.indices[i]], mesh.positions[mesh.indices[i + 1]],
+				mesh.positions[mesh.indices[i + 2]]));
+		}
+		std::cout << "  tessellated: " << mesh.indices.size() / 3 << " triangles, ~"
+			<< mesh.indices.size() / 3 * sizeof(Triangle) / 1024 << " KB (without BVH)" << std::endl;
+		render(scene, "tessellated", "output_bezier_rt_tessellated.ppm");
+	}
+}
+
+// 把 Mesh 的三角形逐个加入场景 (平移 offset)
+static void add_mesh_triangles(Scene& scene, const Mesh& mesh, const Vec3f& offset) {
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		scene.add_object(new Triangle(mesh.positions[mesh.indices[i]] + offset, mesh.positions[mesh.indices[i + 1]] + offset,
+			mesh.positions[mesh.indices[i + 2]] + offset));
+	}
+}
+
+// 把 src 的三角形接到 dst 后面 (平移 offset)
+static void append_mesh(Mesh& dst, const Mesh& src, const Vec3f& offset) {
+	const int base = (int)dst.positions.size();
+	for (const Vec3f& p : src.positions) dst.positions.push_back(p + offset);
+	for (int i : src.indices) dst.indices.push_back(base + i);
+}
+
+// BVH 基准网格：疏密不均的三角形 (大片波浪地面 + 高密度胶囊 + 高密度球)
+// 地面是 n x n 的顶点网格，n 决定场景规模
+static Mesh build_bvh_benchmark_mesh(int n) {
+	Mesh ground;
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			float u = (float)x / (n - 1), v = (float)y / (n - 1);
+			ground.positions.push_back(Vec3f(u * 8 - 4, std::sin(u * 12.0f) * std::cos(v * 9.0f) * 0.15f - 1.2f, v * 8 - 4));
+		}
+	}
+	for (int y = 0; y + 1 < n; ++y) {
+		for (int x = 0; x + 1 < n; ++x) {
+			int a = y * n + x, b = a + 1, c = a + n + 1, d = a + n;
+			ground.indices.insert(ground.indices.end(), { a, d, c, a, c, b });
+		}
+	}
+
+	PatchMesh capsule;
+	const std::string path = "output_capsule.bpt";
+	write_capsule_bpt(path, 0.5f, 0.4f);
+	if (capsule.load(path)) append_mesh(ground, capsule.tessellate(40), Vec3f(-0.8f, -0.3f, 0));
+
+	append_mesh(ground, Geometry::generate_sphere(0.5f, 200, 100), Vec3f(0.8f, -0.6f, 0.3f));
+	return ground;
+}
+
+// BVH 基准场景：基准网格的三角形逐个加入，再加几个解析球
+static void build_bvh_benchmark_scene(Scene& scene, int n = 160) {
+	add_mesh_triangles(scene, build_bvh_benchmark_mesh(n), Vec3f(0, 0, 0));
+	for (int i = 0; i < 8; ++i) {
+		float a = i * 0.785398f;
+		scene.add_object(new Sphere(Vec3f(std::cos(a) * 2.5f, -0.9f, std::sin(a) * 2.5f), 0.3f));
+	}
+}
+
+// ==========================================
+// Benchmark：BVH 构建质量与遍历 (指针树 vs 扁平数组 vs 4 / 8 路宽 BVH)
+// ==========================================
+void TestCC::run_bvh_benchmark() {
+	std::cout << "[Benchmark] BVH..." << std::endl;
+
+	const int width = 400, height = 300;
+	OrbitCamera camera(Vec3f(0, -0.5f, 0), 4.0f);
+	camera.aspect = (float)width / height;
+	camera.phi = 0.35f;
+	camera.theta = 0.4f;
+
+	Scene scene;
+	build_bvh_benchmark_scene(scene);
+	std::vector<Object*> objects = scene.get_objects();
+	std::cout << "  " << objects.size() << " primitives" << std::endl;
+
+	// 只测遍历：每个像素一条主光线 (预先生成，不计入时间)，不着色
+	std::vector<Ray> rays;
+	rays.reserve((size_t)width * height);
+	for (int j = 0; j < height; ++j) {
+		for (int i = 0; i < width; ++i) rays.push_back(camera.get_ray((float)i / (width - 1), (float)j / (height - 1)));
+	}
+	auto trace = [&](const Object& root, const char* name, double build_seconds, size_t nodes, float sah) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		size_t hits = 0;
+		for (const Ray& r : rays) {
+			HitRecord rec;
+			hits += root.intersect(r, 0.001f, std::numeric_limits<float>::max(), rec);
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(t1 - t0).count();
+		std::cout << "  " << name << ": " << nodes << " nodes, SAH cost " << sah << ", build " << build_seconds
+			<< " s, trace " << seconds << " s (" << (width * height) / seconds / 1e6 << " Mrays/s, " << hits << " hits)" << std::endl;
+	};
+
+	BVHNode::Settings single;
+	single.max_leaf_size = 1;
+	const BVHNode::Settings configs[2] = { single, BVHNode::Settings() };
+	const char* names[2] = { "BVHNode, 1 prim/leaf", "BVHNode, <=4 prims/leaf" };
+	for (int i = 0; i < 2; ++i) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		BVHNode tree(objects, configs[i]);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		trace(tree, names[i], std::chrono::duration<double>(t1 - t0).count(), tree.node_count(), tree.sah_cost());
+	}
+	const LinearBVH::Builder builders[2] = { LinearBVH::Builder::SAH, LinearBVH::Builder::HLBVH };
+	const char* builder_names[2] = { "LinearBVH (SAH)", "LinearBVH (HLBVH)" };
+	for (int i = 0; i < 2; ++i) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		LinearBVH flat(objects, BVHNode::Settings(), builders[i]);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		trace(flat, builder_names[i], std::chrono::duration<double>(t1 - t0).count(), flat.node_count(), flat.sah_cost());
+		if (builders[i] != LinearBVH::Builder::SAH) continue;
+
+		// 同一棵 SAH 树收缩成 4 路 / 8 路 (构建时间只算收缩)
+		auto t2 = std::chrono::high_resolution_clock::now();
+		BVH4 bvh4(flat);
+		auto t3 = std::chrono::high_resolution_clock::now();
+		BVH8 bvh8(flat);
+		auto t4 = std::chrono::high_resolution_clock::now();
+		trace(bvh4, "BVH4 (collapsed SAH)", std::chrono::duration<double>(t3 - t2).count(), bvh4.node_count(), flat.sah_cost());
+		trace(bvh8, "BVH8 (collapsed SAH)", std::chrono::duration<double>(t4 - t3).count(), bvh8.node_count(), flat.sah_cost());
+	}
+
+	// 三角形网格：同一个 TriangleMesh，二叉树 + 逐个三角形 vs 宽 BVH + SIMD 叶子 (TriangleMesh::intersect)
+	{
+		const Mesh mesh = build_bvh_benchmark_mesh(160);
+		TriangleMesh object(mesh);
+		const LinearBVH& binary = object.bvh();
+		const std::vector<uint32_t>& order = binary.get_order();
+		std::cout << "  TriangleMesh: " << object.triangle_count() << " triangles" << std::endl;
+
+		// 二叉树遍历 + 逐个三角形的标量 Moller-Trumbore
+		struct BinaryMesh : Object {
+			const Mesh& mesh;
+			const LinearBVH& tree;
+			const std::vector<uint32_t>& order;
+			BinaryMesh(const Mesh& m, const LinearBVH& t, const std::vector<uint32_t>& o) : mesh(m), tree(t), order(o) {}
+			bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override {
+				bool hit = tree.traverse(r, tmin, tmax, [&](size_t first, size_t count, float t_min, float& t_max) {
+					bool found = false;
+					for (size_t i = first; i < first + count; ++i) {
+						const int* idx = &mesh.indices[order[i] * 3];
+						const Vec3f& v0 = mesh.positions[idx[0]];
+						Vec3f e1 = mesh.positions[idx[1]] - v0, e2 = mesh.positions[idx[2]] - v0;
+						Vec3f h = r.dir.cross(e2);
+						float a = e1.dot(h);
+						if (a > -1e-6f && a < 1e-6f) continue;
+						float f = 1.0f / a;
+						Vec3f s = r.orig - v0;
+						float u = f * s.dot(h);
+						if (u < 0.0f || u > 1.0f) continue;
+						Vec3f q = s.cross(e1);
+						float v = f * r.dir.dot(q);
+						if (v < 0.0f || u + v > 1.0f) continue;
+						float t = f * e2.dot(q);
+						if (t < t_min || t > t_max) continue;
+						t_max = rec.t = t;
+						found = true;
+					}
+					return found;
+				});
+				return hit;
+			}
+			AABB get_bounding_box() const override { return tree.get_bounding_box(); }
+		} binary_mesh(mesh, binary, order);
+
+		trace(binary_mesh, "binary BVH, scalar leaves", 0.0, binary.node_count(), binary.sah_cost(TriangleMesh::default_settings()));
+		trace(object, "wide BVH, SIMD leaves", 0.0, object.wide_bvh().node_count(), binary.sah_cost(TriangleMesh::default_settings()));
+	}
+
+	// 大场景：只比较构建时间 (约 200 万个三角形)
+	{
+		Scene large;
+		build_bvh_benchmark_scene(large, 1000);
+		std::vector<Object*> large_objects = large.get_objects();
+		std::cout << "  large scene: " << large_objects.size() << " primitives" << std::endl;
+		for (int i = 0; i < 2; ++i) {
+			auto t0 = std::chrono::high_resolution_clock::now();
+			LinearBVH flat(large_objects, BVHNode::Settings(), builders[i]);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			trace(flat, builder_names[i], std::chrono::duration<double>(t1 - t0).count(), flat.node_count(), flat.sah_cost());
+		}
+	}
+
+	// 完整渲染一帧 (Scene 内部用 LinearBVH 构建，收缩成宽 BVH 遍历)
+	scene.build();
+	Rasterizer rst(width, height);
+	RayTracer tracer(&rst, &scene, &camera);
+	tracer.render();
+	rst.save_to_ppm("output_bvh_benchmark.ppm");
+}
+
+// ==========================================
+// 验证测试：TriangleMesh (整网格一个物体) vs 逐个 Triangle 物体
+// ==========================================
+void TestCC::run_triangle_mesh_test() {
+	std::cout << "[Test] TriangleMesh..." << std::endl;
+
+	// 同一组网格：平滑法线的球 + 胶囊 (焊接后带平均法线)
+	std::vector<Mesh> meshes;
+	meshes.push_back(Geometry::generate_sphere(0.8f, 256, 128));
+	PatchMesh capsule;
+	write_capsule_bpt("output_capsule.bpt", 0.5f, 0.4f);
+	if (capsule.load("output_capsule.bpt")) meshes.push_back(capsule.tessellate(48));
+	const Vec3f offsets[2] = { Vec3f(0.9f, 0, 0), Vec3f(-0.9f, 0, 0) };
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		for (Vec3f& p : meshes[m].positions) p = p + offsets[m];
+	}
+
+	const int width = 400, height = 300;
+	OrbitCamera camera(Vec3f(0, 0, 0), 3.5f);
+	camera.aspect = (float)width / height;
+	camera.phi = 0.3f;
+
+	auto render = [&](Scene& scene, const char* file) {
+		scene.build();
+		Rasterizer rst(width, height);
+		RayTracer tracer(&rst, &scene, &camera);
+		tracer.render();
+		rst.save_to_ppm(file);
+	};
+
+	// 1. 逐个 Triangle：每个三角形一次堆分配 + 场景 BVH 里的一个图元
+	size_t triangles = 0;
+	{
+		Scene scene;
+		for (const Mesh& mesh : meshes) add_mesh_triangles(scene, mesh, Vec3f(0, 0, 0));
+		triangles = scene.get_objects().size();
+		render(scene, "output_triangles_rt.ppm");
+		size_t bytes = triangles * (sizeof(Triangle) + sizeof(Object*)) + scene.bvh()->node_count() * sizeof(LinearBVH::Node);
+		std::cout << "  Triangle objects: " << triangles << " tris, " << (double)bytes / triangles << " bytes/tri (+ heap overhead)" << std::endl;
+	}
+
+	// 2. TriangleMesh：引用 Mesh 的顶点和索引，旁路只存求交用的三角形 SoA + 自己的 BVH
+	{
+		Scene scene;
+		size_t bytes = 0;
+		for (const Mesh& mesh : meshes) {
+			TriangleMesh* object = new TriangleMesh(mesh);
+			bytes += object->memory_bytes();
+			scene.add_object(object);
+		}
+		render(scene, "output_triangle_mesh_rt.ppm");
+		std::cout << "  TriangleMesh: " << (double)bytes / triangles << " bytes/tri (Mesh arrays shared, not copied)" << std::endl;
+
+		// 重心坐标 / 三角形编号 / 插值 UV
+		HitRecord rec;
+		if (scene.intersect(camera.get_ray(0.7f, 0.5f), rec)) {
+			std::cout << "  center ray: tri " << rec.prim_id << ", bary (" << rec.u << ", " << rec.v << "), uv ("
+				<< rec.uv.x << ", " << rec.uv.y << ")" << std::endl;
+		}
+	}
+}
+
+// ==========================================
+// 验证测试：动画场景的 BVH 重新拟合 (refit) vs 完整重建
+// ==========================================
+void TestCC::run_bvh_refit_test() {
+	std::cout << "[Test] BVH Refit..." << std::endl;
+
+	// 1. 场景：起伏的波浪地面 (逐帧变形) + 从左飞到右的胶囊 (平移) + 绕圈的球
+	Scene scene;
+	const int n = 120;
+	auto ground_point = [&](int x, int y, float time) {
+		float u = (float)x / (n - 1), v = (float)y / (n - 1);
+		return Vec3f(u * 8 - 4, std::sin(u * 12.0f + time) * std::cos(v * 9.0f) * 0.2f - 1.2f, v * 8 - 4);
+	};
+	std::vector<Triangle*> ground;
+	for (int y = 0; y + 1 < n; ++y) {
+		for (int x = 0; x + 1 < n; ++x) {
+			ground.push_back(new Triangle(ground_point(x, y, 0), ground_point(x, y + 1, 0), ground_point(x + 1, y + 1, 0)));
+			ground.push_back(new Triangle(ground_point(x, y, 0), ground_point(x + 1, y + 1, 0), ground_point(x + 1, y, 0)));
+		}
+	}
+	for (Triangle* t : ground) scene.add_object(t);
+
+	PatchMesh capsule_model;
+	write_capsule_bpt("output_capsule.bpt", 0.4f, 0.3f);
+	if (!capsule_model.load("output_capsule.bpt")) return;
+	Mesh capsule = capsule_model.tessellate(24);
+	std::vector<Triangle*> capsule_tris;
+	for (size_t i = 0; i + 2 < capsule.indices.size(); i += 3) {
+		capsule_tris.push_back(new Triangle(capsule.positions[capsule.indices[i]], capsule.positions[capsule.indices[i + 1]],
+			capsule.positions[capsule.indices[i + 2]]));
+		scene.add_object(capsule_tris.back());
+	}
+
+	std::vector<Sphere*> spheres;
+	for (int i = 0; i < 8; ++i) {
+		spheres.push_back(new Sphere(Vec3f(0, 0, 0), 0.3f));
+		scene.add_object(spheres.back());
+	}
+
+	auto animate = [&](int frame) {
+		float time = frame * 0.4f;
+		ThreadPool::instance().parallel_for(ground.size() / 2, 0, [&](size_t b, size_t e) {
+			for (size_t k = b; k < e; ++k) {
+				int x = (int)(k % (n - 1)), y = (int)(k / (n - 1));
+				*ground[k * 2] = Triangle(ground_point(x, y, time), ground_point(x, y + 1, time), ground_point(x + 1, y + 1, time));
+				*ground[k * 2 + 1] = Triangle(ground_point(x, y, time), ground_point(x + 1, y + 1, time), ground_point(x + 1, y, time));
+			}
+		});
+		Vec3f offset(-3.0f + frame * 0.5f, 0.2f * std::sin(time), 0);
+		for (size_t t = 0; t < capsule_tris.size(); ++t) {
+			const int* tri = &capsule.indices[t * 3];
+			*capsule_tris[t] = Triangle(capsule.positions[tri[0]] + offset, capsule.positions[tri[1]] + offset, capsule.positions[tri[2]] + offset);
+		}
+		for (int i = 0; i < 8; ++i) {
+			float a = i * 0.785398f + time * 0.5f;
+			spheres[i]->center = Vec3f(std::cos(a) * 2.5f, -0.7f, std::sin(a) * 2.5f);
+		}
+	};
+
+	// 2. 逐帧：改几何 -> mark_moved -> build (重新拟合，代价退化太多时自动完整重建)
+	const int width = 200, height = 150;
+	OrbitCamera camera(Vec3f(0, -0.5f, 0), 5.0f);
+	camera.aspect = (float)width / height;
+	camera.phi = 0.4f;
+	const char* kinds[3] = { "none", "full", "refit" };
+	for (int frame = 0; frame < 12; ++frame) {
+		animate(frame);
+		if (frame > 0) scene.mark_moved();
+		scene.build();
+		std::cout << "  frame " << frame << ": " << kinds[(int)scene.build_kind()] << " " << scene.build_seconds() * 1000.0
+			<< " ms, SAH cost " << scene.bvh()->sah_cost() << std::endl;
+
+		Rasterizer rst(width, height);
+		RayTracer tracer(&rst, &scene, &camera);
+		tracer.render();
+		std::stringstream ss;
+		ss << "output_refit_" << std::setw(3) << std::setfill('0') << frame << ".ppm";
+		rst.save_to_ppm(ss.str().c_str());
+	}
+
+	// 3. 对照：同一帧完整重建的耗时
+	std::vector<Object*> objects = scene.get_objects();
+	auto t0 = std::chrono::high_resolution_clock::now();
+	LinearBVH rebuilt(objects);
+	auto t1 = std::chrono::high_resolution_clock::now();
+	std::cout << "  full rebuild for comparison: " << std::chrono::duration<double>(t1 - t0).count() * 1000.0
+		<< " ms, SAH cost " << rebuilt.sah_cost() << std::endl;
+}
+
+// ==========================================
+// 验证测试：Bezier 曲线自适应展平 (单条 + 批量发丝)
+// ==========================================
+void TestCC::run_curve_flattening_test() {
+	std::cout << "[Test] Curve Flattening..." << std::endl;
+
+	const int width = 800, height = 600;
+	Rasterizer r(width, height);
+	r.clear(Vec3f(0.05f, 0.05f, 0.08f));
+
+	// 屏幕坐标下画折线 (简单 DDA)
+	auto draw_polyline = [&](const Vec3f* pts, size_t n, const Vec3f& color) {
+		for (size_t i = 0; i + 1 < n; ++i) {
+			Vec3f d = pts[i + 1] - pts[i];
+			int steps = std::max(1, (int)std::ceil(std::max(std::abs(d.x), std::abs(d.y))));
+			for (int k = 0; k <= steps; ++k) {
+				Vec3f p = pts[i] + d * ((float)k / steps);
+				r.set_pixel((int)p.x, (int)p.y, color);
+			}
+		}
+	};
+
+	// 1. 单条三次曲线：与 run_bezier_curve_test 相同的控制点 (像素单位)
+	std::vector<Vec3f> cubic = { Vec3f(100, 100, 0), Vec3f(200, 400, 0), Vec3f(600, 400, 0), Vec3f(700, 100, 0) };
+	for (float tolerance : { 2.0f, 0.5f, 0.1f }) {
+		std::vector<Vec3f> pts = Geometry::Bezier::flatten(cubic, tolerance);
+		std::cout << "  cubic, tolerance " << tolerance << " px: " << pts.size() - 1 << " segments (uniform test uses 1000)" << std::endl;
+	}
+	std::vector<Vec3f> line = Geometry::Bezier::flatten(cubic, 0.25f);
+	draw_polyline(line.data(), line.size(), Vec3f(1, 1, 1));
+
+	// 2. 批量：大量五次曲线 (发丝)，长短、弯曲程度各不相同
+	const size_t strands = 20000;
+	std::vector<Vec3f> points;
+	std::vector<uint32_t> offsets = { 0 };
+	srand(7);
+	auto frand = []() { return (float)rand() / RAND_MAX; };
+	for (size_t i = 0; i < strands; ++i) {
+		Vec3f root(100.0f + 600.0f * frand(), 580.0f - 60.0f * frand(), 0.0f);
+		float length = 40.0f + 200.0f * frand();
+		float curl = (frand() - 0.5f) * 2.0f;
+		for (int k = 0; k < 6; ++k) {
+			float t = k / 5.0f;
+			points.push_back(root + Vec3f(curl * length * t * t + (frand() - 0.5f) * 10.0f, -length * t, 0.0f));
+		}
+		offsets.push_back((uint32_t)points.size());
+	}
+
+	std::vector<Vec3f> flat_points;
+	std::vector<uint32_t> flat_offsets;
+	auto t0 = std::chrono::high_resolution_clock::now();
+	Geometry::Bezier::flatten_batch(points, offsets, 0.5f, flat_points, flat_offsets);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	// 对照：每条固定 32 段
+	auto t2 = std::chrono::high_resolution_clock::now();
+	size_t uniform_points = 0;
+	for (size_t i = 0; i < strands; ++i) {
+		std::vector<Vec3f> strand(points.begin() + offsets[i], points.begin() + offsets[i + 1]);
+		uniform_points += Geometry::Bezier::generate_curve(strand, 32).size();
+	}
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	std::cout << "  " << strands << " strands: adaptive " << flat_points.size() << " points in "
+		<< std::chrono::duration<double>(t1 - t0).count() << " s, uniform(32) " << uniform_points << " points in "
+		<< std::chrono::duration<double>(t3 - t2).count() << " s" << std::endl;
+
+	for (size_t i = 0; i < strands; i += 10) {
+		draw_polyline(flat_points.data() + flat_offsets[i], flat_offsets[i + 1] - flat_offsets[i], Vec3f(0.9f, 0.7f, 0.3f));
+	}
+	r.save_to_ppm("output_curve_flattening.ppm");
+}
@@ -12,10 +12,25 @@ public:
 	static void scene_image_texture_test();
 	static void normalize_mesh(Mesh& mesh);
 	static void run_model_loading_test();
+	static void run_obj_loader_benchmark();
+	static void run_quantized_mesh_test();
+	static void run_streaming_mesh_test();
+	static void run_mesh_processing_test();
 	static void run_turntable_animation();
 
 	static void run_bezier_curve_test();
+	static void run_curve_flattening_test();
 	static void run_bezier_surface_test();
+	static void run_bezier_tessellation_benchmark();
+	static void run_adaptive_tessellation_test();
+	static void run_patch_mesh_test();
 
 	static void run_ray_tracing_test();
+	static void run_bezier_ray_tracing_test();
+	static void run_bvh_benchmark();
+	static void run_bvh_refit_test();
+	static void run_triangle_mesh_test();
+
+	static void run_texture_layout_benchmark();
+	static void run_virtual_texture_test();
 };
\ No newline at end of file
@@ -6,20 +6,35 @@
 #include <cmath>
 #include <algorithm>
 
+// SIMD 批量采样需要 SSE4.1 (floor / mullo / min/max epi32)，AVX2 额外提供 gather 和 8 路
+#if defined(__AVX2__)
+#define SR_SIMD_AVX2
+#endif
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define SR_SIMD_SSE4
+#include <immintrin.h>
+#endif
+
 
 Texture::Texture()
-	: colorA(1.0f, 1.0f, 1.0f), colorB(0.0f, 0.0f, 0.0f), scale(1.0f) {
+	: colorA(1.0f, 1.0f, 1.0f), colorB(0.0f, 0.0f, 0.0f) {
 }
 
 // ==========================================
 // 核心：加载纹理
 // ==========================================
 bool Texture::loadTexture(const std::string& path) {
+	TextureLoadOptions options;
+	options.layout = preferred_layout;
+	return loadTexture(path, options);
+}
+
+bool Texture::loadTexture(const std::string& path, const TextureLoadOptions& options) {
 	int w, h, channels;
 
 	// 1. 设置翻转 (OpenGL 习惯 UV 原点在左下，图片通常在左上)
-	// 开启这个可以让图片方向正确
-	stbi_set_flip_vertically_on_load(true);
+	// 开启这个可以让图片方向正确 (按线程设置，多线程加载互不干扰)
+	stbi_set_flip_vertically_on_load_thread(options.flip_vertically ? 1 : 0);
 
 	// 2. 加载图片
 	// 最后一个参数 3 强制要求加载为 RGB (忽略 Alpha 通道，或者把 Grey 转为 RGB)
@@ -33,7 +48,7 @@ bool Texture::loadTexture(const std::string& path) {
 	// 3. 更新尺寸
 	width = w;
 	height = h;
-	buffer.resize(w * h);
+	std::vector<Vec3f> row_major(w * h);
 
 	// 4. 填充 Buffer (转换 unsigned char [0-255] -> float [0.0-1.0])
 	for (int i = 0; i < w * h; ++i) {
@@ -42,12 +57,18 @@ bool Texture::loadTexture(const std::string& path) {
 		float g = data[i * 3 + 1] / 255.0f;
 		float b = data[i * 3 + 2] / 255.0f;
 
-		buffer[i] = Vec3f(r, g, b);
+		row_major[i] = Vec3f(r, g, b);
 	}
 
 	// 5. 释放 stb 内存
 	stbi_image_free(data);
 
+	// 6. 重排为缓存友好的布局 (只在加载时做一次)
+	preferred_layout = options.layout;
+	image.build(w, h, row_major, preferred_layout);
+	mips.clear();
+	if (options.generate_mipmaps) generateMipmaps();
+
 	std::cout << "Texture loaded: " << path << " (" << w << "x" << h << ")" << std::endl;
 	return true;
 }
@@ -57,31 +78,29 @@ bool Texture::loadTexture(const std::string& path) {
 // ==========================================
 Vec3f Texture::sample(float u, float v) const {
 	// 如果 Buffer 有数据，就用双线性插值采样图片
-	if (!buffer.empty()) {
+	if (!image.empty()) {
 		return getColorBilinear(u, v);
 	}
 	return getColorCheckerboard(u, v);
 }
 
+size_t Texture::memoryBytes() const {
+	size_t bytes = image.texels.size() * sizeof(Vec3f);
+	for (const TexelImage& level : mips) bytes += level.texels.size() * sizeof(Vec3f);
+	return bytes;
+}
+
 void Texture::setColors(const Vec3f& c1, const Vec3f& c2) {
 	colorA = c1;
 	colorB = c2;
 }
 
-void Texture::setScale(float s) {
-	scale = s;
-}
-
 Vec3f Texture::getColorCheckerboard(float u, float v) const {
-	// 1. 缩放 UV
-	float u_scaled = u * scale;
-	float v_scaled = v * scale;
-
-	// 2. 使用 floor 向下取整，确保负数区间正确处理
-	int x = (int)std::floor(u_scaled);
-	int y = (int)std::floor(v_scaled);
+	// 1. 使用 floor 向下取整，确保负数区间正确处理
+	int x = (int)std::floor(u);
+	int y = (int)std::floor(v);
 
-	// 3. 奇偶校验
+	// 2. 奇偶校验
 	// C++ 中负数取模结果可能为负 (例如 -1 % 2 = -1)，但 != 0 依然成立，所以逻辑是通用的
 	if ((x + y) % 2 == 0) {
 		return colorA;
@@ -92,89 +111,518 @@ Vec3f Texture::getColorCheckerboard(float u, float v) const {
 }
 
 // ==========================================
-// 辅助：处理边界 (Repeat 模式)
+// 编译期特化的采样实现
 // ==========================================
-Vec3f Texture::getTexel(int x, int y) const {
-	if (width == 0 || height == 0) return { 0, 0, 0 };
+// 模板参数：
+//   W    寻址模式        L    纹素布局
+//   Pow2 宽高是否为 2 的幂 (Repeat 时用掩码代替取模)
+// 所有模式判断都在编译期完成，运行时只剩下浮点 floor 和整数加减/比较。
+struct TextureSampling {
+	// 布局相关的寻址 (坐标已经落在图像内)
+	template<TexelLayout L>
+	static int address(const TexelImage& img, int x, int y) {
+		if constexpr (L == TexelLayout::Tiled) return img.tiled_index(x, y);
+		else if constexpr (L == TexelLayout::Morton) return img.morton_index(x, y);
+		else return y * img.width + x;
+	}
+
+	// 把参数坐标 c 规约到一个周期内
+	// Repeat: [0, 1)    Mirror: [0, 1] (已镜像)    Clamp: [0, 1]    Border: 不变
+	template<WrapMode W>
+	static float reduce(float c) {
+		if constexpr (W == WrapMode::Repeat) {
+			return c - std::floor(c);
+		}
+		else if constexpr (W == WrapMode::Mirror) {
+			float m = c * 0.5f;
+			m = (m - std::floor(m)) * 2.0f; // [0, 2)
+			return m > 1.0f ? 2.0f - m : m;
+		}
+		else if constexpr (W == WrapMode::Clamp) {
+			return std::max(0.0f, std::min(c, 1.0f));
+		}
+		else {
+			return c;
+		}
+	}
+
+	// 规约后的坐标经过 floor 最多越界一个纹素 ([-1, size])，这里只需要加减修正
+	template<WrapMode W, bool Pow2>
+	static int wrap(int x, int size, int mask) {
+		if constexpr (W == WrapMode::Repeat) {
+			if constexpr (Pow2) return x & mask;
+			else return x + (x < 0 ? size : 0) - (x >= size ? size : 0);
+		}
+		else if constexpr (W == WrapMode::Border) {
+			return x; // 由 fetch 判断是否越界
+		}
+		else {
+			// Clamp / Mirror：边界外的那一个纹素就是边缘纹素本身
+			return std::max(0, std::min(x, size - 1));
+		}
+	}
+
+	template<WrapMode W, TexelLayout L>
+	static Vec3f fetch(const TexelImage& img, const Sampler& s, int x, int y) {
+		if constexpr (W == WrapMode::Border) {
+			bool inside = (unsigned)x < (unsigned)img.width && (unsigned)y < (unsigned)img.height;
+			int cx = std::max(0, std::min(x, img.width - 1));
+			int cy = std::max(0, std::min(y, img.height - 1));
+			const Vec3f& c = img.texels[address<L>(img, cx, cy)];
+			return inside ? c : s.border_color;
+		}
+		else {
+			return img.texels[address<L>(img, x, y)];
+		}
+	}
+
+	// 最近邻
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static Vec3f nearest(const TexelImage& img, const Sampler& s, float u, float v) {
+		int x = (int)std::floor(reduce<W>(u) * img.width);
+		int y = (int)std::floor(reduce<W>(v) * img.height);
+		x = wrap<W, Pow2>(x, img.width, img.width_mask);
+		y = wrap<W, Pow2>(y, img.height, img.height_mask);
+		return fetch<W, L>(img, s, x, y);
+	}
+
+	// 双线性 (与原 getColorBilinear 的纹素中心对齐方式一致)
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static Vec3f bilinear(const TexelImage& img, const Sampler& s, float u, float v) {
+		float x_prime = reduce<W>(u) * img.width - 0.5f;
+		float y_prime = reduce<W>(v) * img.height - 0.5f;
+
+		float fx = std::floor(x_prime);
+		float fy = std::floor(y_prime);
+		float sx = x_prime - fx;
+		float ty = y_prime - fy;
+
+		int x0 = (int)fx, y0 = (int)fy;
+		int x1 = wrap<W, Pow2>(x0 + 1, img.width, img.width_mask);
+		int y1 = wrap<W, Pow2>(y0 + 1, img.height, img.height_mask);
+		x0 = wrap<W, Pow2>(x0, img.width, img.width_mask);
+		y0 = wrap<W, Pow2>(y0, img.height, img.height_mask);
+
+		Vec3f c00 = fetch<W, L>(img, s, x0, y0);
+		Vec3f c10 = fetch<W, L>(img, s, x1, y0);
+		Vec3f c01 = fetch<W, L>(img, s, x0, y1);
+		Vec3f c11 = fetch<W, L>(img, s, x1, y1);
+
+		Vec3f c_top = c00 * (1.0f - sx) + c10 * sx;
+		Vec3f c_bot = c01 * (1.0f - sx) + c11 * sx;
+		return c_top * (1.0f - ty) + c_bot * ty;
+	}
+
+	// ------------------------------------------
+	// 统一签名的入口 (放进函数表)
+	// ------------------------------------------
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static Vec3f sample_nearest(const Texture& tex, const Sampler& s, float u, float v, float) {
+		return nearest<W, L, Pow2>(tex.image, s, u * s.uv_scale, v * s.uv_scale);
+	}
+
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static Vec3f sample_bilinear(const Texture& tex, const Sampler& s, float u, float v, float) {
+		return bilinear<W, L, Pow2>(tex.image, s, u * s.uv_scale, v * s.uv_scale);
+	}
+
+	// 三线性：在相邻两级 Mipmap 上各做一次双线性再插值
+	// Mip 层级尺寸各不相同，这里统一走加减修正的非 2 的幂路径 (同样没有除法)
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static Vec3f sample_trilinear(const Texture& tex, const Sampler& s, float u, float v, float lod) {
+		u *= s.uv_scale;
+		v *= s.uv_scale;
+		float max_lod = (float)tex.mips.size();
+		lod = std::max(0.0f, std::min(lod, max_lod));
+		if (lod == 0.0f) return bilinear<W, L, Pow2>(tex.image, s, u, v);
+
+		int l0 = (int)lod;
+		int l1 = std::min(l0 + 1, (int)tex.mips.size());
+		float t = lod - (float)l0;
+
+		Vec3f c0 = bilinear<W, L, false>(tex.getLevel(l0), s, u, v);
+		Vec3f c1 = bilinear<W, L, false>(tex.getLevel(l1), s, u, v);
+		return c0 * (1.0f - t) + c1 * t;
+	}
+
+	// ------------------------------------------
+	// 函数表：[wrap][layout][pow2][filter]
+	// ------------------------------------------
+	using SampleFn = Vec3f(*)(const Texture&, const Sampler&, float, float, float);
+	static const int WRAP_COUNT = 4, LAYOUT_COUNT = 3, FILTER_COUNT = 3;
+
+	static int layout_slot(TexelLayout l) {
+		return l == TexelLayout::Tiled ? 1 : (l == TexelLayout::Morton ? 2 : 0);
+	}
+
+	template<WrapMode W, TexelLayout L, bool Pow2>
+	static void fill(SampleFn* out) {
+		out[(int)FilterMode::Nearest] = &sample_nearest<W, L, Pow2>;
+		out[(int)FilterMode::Bilinear] = &sample_bilinear<W, L, Pow2>;
+		out[(int)FilterMode::Trilinear] = &sample_trilinear<W, L, Pow2>;
+	}
+
+	template<WrapMode W, TexelLayout L>
+	static void fill(SampleFn* out) {
+		fill<W, L, false>(out);
+		fill<W, L, true>(out + FILTER_COUNT);
+	}
 
-	// 实现 Repeat (Wrap) 模式
-	// 保证坐标在 [0, width-1] 和 [0, height-1] 范围内
-	int x_wrap = ((x % width) + width) % width;
-	int y_wrap = ((y % height) + height) % height;
+	template<WrapMode W>
+	static void fill(SampleFn* out) {
+		fill<W, TexelLayout::Linear>(out);
+		fill<W, TexelLayout::Tiled>(out + 2 * FILTER_COUNT);
+		fill<W, TexelLayout::Morton>(out + 4 * FILTER_COUNT);
+	}
+
+	static const SampleFn* table() {
+		static SampleFn fns[WRAP_COUNT * LAYOUT_COUNT * 2 * FILTER_COUNT] = {};
+		static bool initialized = [] {
+			const int stride = LAYOUT_COUNT * 2 * FILTER_COUNT;
+			fill<WrapMode::Repeat>(fns + (int)WrapMode::Repeat * stride);
+			fill<WrapMode::Clamp>(fns + (int)WrapMode::Clamp * stride);
+			fill<WrapMode::Mirror>(fns + (int)WrapMode::Mirror * stride);
+			fill<WrapMode::Border>(fns + (int)WrapMode::Border * stride);
+			return true;
+		}();
+		(void)initialized;
+		return fns;
+	}
 
-	// Clamp to Edge 模式(解决黑边问题)
-	/*int x_clamp = std::max(0, std::min(x, width - 1));
-	int y_clamp = std::max(0, std::min(y, height - 1));*/
+	static SampleFn select(const Texture& tex, const Sampler& s) {
+		int slot = (((int)s.wrap * LAYOUT_COUNT + layout_slot(tex.image.layout)) * 2 + (tex.image.pow2 ? 1 : 0)) * FILTER_COUNT + (int)s.filter;
+		return table()[slot];
+	}
+};
 
-	// 获取 Buffer 索引
-	int index = y_wrap * width + x_wrap;
-	//int index = y_clamp * width + x_clamp;
-	return buffer[index];
+Vec3f Texture::sample(const Sampler& sampler, float u, float v, float lod) const {
+	if (image.empty()) return getColorCheckerboard(u * sampler.uv_scale, v * sampler.uv_scale);
+	return TextureSampling::select(*this, sampler)(*this, sampler, u, v, lod);
 }
 
 // ==========================================
-// 核心：双线性插值 (Bilinear Interpolation)
+// 批量采样 (SIMD)
 // ==========================================
-Vec3f Texture::getColorBilinear(float u, float v) const {
-	// 如果没有 buffer 数据，回退到默认颜色或程序化纹理
-	if (buffer.empty()) return getColorCheckerboard(u, v);
+// 一次处理 N 组 UV：floor、权重、寻址都在向量寄存器里完成，
+// AVX2 下用 gather 一次取 N 个纹素的同一通道。
+// 数据按通道拆成 SoA (r[N], g[N], b[N])，最后再写回 Vec3f。
+#if defined(SR_SIMD_SSE4)
+
+struct SimdSSE4 {
+	static const int N = 4;
+	using F = __m128;
+	using I = __m128i;
+
+	static F load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, F x) { _mm_storeu_ps(p, x); }
+	static F set1(float x) { return _mm_set1_ps(x); }
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+	static F min(F a, F b) { return _mm_min_ps(a, b); }
+	static F max(F a, F b) { return _mm_max_ps(a, b); }
+	static F floor(F x) { return _mm_floor_ps(x); }
+	static I cvt(F x) { return _mm_cvttps_epi32(x); }
+
+	static I iset1(int x) { return _mm_set1_epi32(x); }
+	static I iadd(I a, I b) { return _mm_add_epi32(a, b); }
+	static I isub(I a, I b) { return _mm_sub_epi32(a, b); }
+	static I iand(I a, I b) { return _mm_and_si128(a, b); }
+	static I ior(I a, I b) { return _mm_or_si128(a, b); }
+	static I imin(I a, I b) { return _mm_min_epi32(a, b); }
+	static I imax(I a, I b) { return _mm_max_epi32(a, b); }
+	static I imul(I a, I b) { return _mm_mullo_epi32(a, b); }
+	static I icmplt(I a, I b) { return _mm_cmplt_epi32(a, b); }
+	static I icmpgt(I a, I b) { return _mm_cmpgt_epi32(a, b); }
+	static I shl(I x, int n) { return _mm_sll_epi32(x, _mm_cvtsi32_si128(n)); }
+	static I shr(I x, int n) { return _mm_srl_epi32(x, _mm_cvtsi32_si128(n)); }
+	template<int n> static I shli(I x) { return _mm_slli_epi32(x, n); }
+
+	static F gather(const float* base, I idx) {
+#if defined(SR_SIMD_AVX2)
+		return _mm_i32gather_ps(base, idx, 4);
+#else
+		alignas(16) int i[4];
+		_mm_store_si128((I*)i, idx);
+		return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+#endif
+	}
+};
+
+#if defined(SR_SIMD_AVX2)
+struct SimdAVX2 {
+	static const int N = 8;
+	using F = __m256;
+	using I = __m256i;
+
+	static F load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, F x) { _mm256_storeu_ps(p, x); }
+	static F set1(float x) { return _mm256_set1_ps(x); }
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+	static F min(F a, F b) { return _mm256_min_ps(a, b); }
+	static F max(F a, F b) { return _mm256_max_ps(a, b); }
+	static F floor(F x) { return _mm256_floor_ps(x); }
+	static I cvt(F x) { return _mm256_cvttps_epi32(x); }
+
+	static I iset1(int x) { return _mm256_set1_epi32(x); }
+	static I iadd(I a, I b) { return _mm256_add_epi32(a, b); }
+	static I isub(I a, I b) { return _mm256_sub_epi32(a, b); }
+	static I iand(I a, I b) { return _mm256_and_si256(a, b); }
+	static I ior(I a, I b) { return _mm256_or_si256(a, b); }
+	static I imin(I a, I b) { return _mm256_min_epi32(a, b); }
+	static I imax(I a, I b) { return _mm256_max_epi32(a, b); }
+	static I imul(I a, I b) { return _mm256_mullo_epi32(a, b); }
+	static I icmplt(I a, I b) { return _mm256_cmpgt_epi32(b, a); }
+	static I icmpgt(I a, I b) { return _mm256_cmpgt_epi32(a, b); }
+	static I shl(I x, int n) { return _mm256_sll_epi32(x, _mm_cvtsi32_si128(n)); }
+	static I shr(I x, int n) { return _mm256_srl_epi32(x, _mm_cvtsi32_si128(n)); }
+	template<int n> static I shli(I x) { return _mm256_slli_epi32(x, n); }
+
+	static F gather(const float* base, I idx) { return _mm256_i32gather_ps(base, idx, 4); }
+};
+#endif
+
+struct TextureBatchSampling {
+	template<class V, WrapMode W>
+	static typename V::F reduce(typename V::F c) {
+		using F = typename V::F;
+		if constexpr (W == WrapMode::Repeat) {
+			return V::sub(c, V::floor(c));
+		}
+		else if constexpr (W == WrapMode::Mirror) {
+			F m = V::mul(c, V::set1(0.5f));
+			m = V::mul(V::sub(m, V::floor(m)), V::set1(2.0f)); // [0, 2)
+			return V::min(m, V::sub(V::set1(2.0f), m));        // 镜像回 [0, 1]
+		}
+		else {
+			return V::min(V::max(c, V::set1(0.0f)), V::set1(1.0f));
+		}
+	}
 
-	// ==========================================
-	// 1. 处理 UV 平铺 (Tiling / Repeat)
-	// ==========================================
-	// 先放大 UV (应用 scale)
-	float u_scaled = u * scale;
-	float v_scaled = v * scale;
+	template<class V, WrapMode W, bool Pow2>
+	static typename V::I wrap(typename V::I x, int size, int mask) {
+		using I = typename V::I;
+		if constexpr (W == WrapMode::Repeat) {
+			if constexpr (Pow2) return V::iand(x, V::iset1(mask));
+			I n = V::iset1(size);
+			x = V::iadd(x, V::iand(V::icmplt(x, V::iset1(0)), n));
+			return V::isub(x, V::iand(V::icmpgt(x, V::iset1(size - 1)), n));
+		}
+		else {
+			return V::imax(V::iset1(0), V::imin(x, V::iset1(size - 1)));
+		}
+	}
+
+	template<class V>
+	static typename V::I part1by1(typename V::I v) {
+		v = V::iand(v, V::iset1(0x0000ffff));
+		v = V::iand(V::ior(v, V::template shli<8>(v)), V::iset1(0x00ff00ff));
+		v = V::iand(V::ior(v, V::template shli<4>(v)), V::iset1(0x0f0f0f0f));
+		v = V::iand(V::ior(v, V::template shli<2>(v)), V::iset1(0x33333333));
+		v = V::iand(V::ior(v, V::template shli<1>(v)), V::iset1(0x55555555));
+		return v;
+	}
+
+	template<class V, TexelLayout L>
+	static typename V::I address(const TexelImage& img, typename V::I x, typename V::I y) {
+		using I = typename V::I;
+		if constexpr (L == TexelLayout::Tiled) {
+			const int ts = TexelImage::TILE_SHIFT;
+			I ty = V::shr(y, ts);
+			I row = img.pow2_tiles ? V::shl(ty, img.tiles_x_shift) : V::imul(ty, V::iset1(img.tiles_x));
+			I tile = V::iadd(row, V::shr(x, ts));
+			I tm = V::iset1(TexelImage::TILE_MASK);
+			return V::ior(V::shl(tile, 2 * ts), V::ior(V::shl(V::iand(y, tm), ts), V::iand(x, tm)));
+		}
+		else if constexpr (L == TexelLayout::Morton) {
+			I block = V::ior(V::shr(x, img.morton_bits), V::shr(y, img.morton_bits));
+			I m = V::iset1(img.morton_mask);
+			I code = V::ior(part1by1<V>(V::iand(x, m)), V::template shli<1>(part1by1<V>(V::iand(y, m))));
+			return V::ior(V::shl(block, 2 * img.morton_bits), code);
+		}
+		else {
+			return V::iadd(V::imul(y, V::iset1(img.width)), x);
+		}
+	}
 
-	// 取小数部分 (Fract)，让坐标永远循环在 [0, 1) 之间
-	// 例如：u=1.5 -> 0.5, u=2.1 -> 0.1
-	float u_img = u_scaled - std::floor(u_scaled);
-	float v_img = v_scaled - std::floor(v_scaled);
+	// 在一张 TexelImage 上做 N 路双线性
+	template<class V, WrapMode W, TexelLayout L, bool Pow2>
+	static void bilinear(const TexelImage& img, typename V::F u, typename V::F v,
+		typename V::F& r, typename V::F& g, typename V::F& b) {
+		using F = typename V::F;
+		using I = typename V::I;
+
+		F half = V::set1(0.5f);
+		F xp = V::sub(V::mul(reduce<V, W>(u), V::set1((float)img.width)), half);
+		F yp = V::sub(V::mul(reduce<V, W>(v), V::set1((float)img.height)), half);
+
+		F fx = V::floor(xp);
+		F fy = V::floor(yp);
+		F sx = V::sub(xp, fx);
+		F ty = V::sub(yp, fy);
+
+		I one = V::iset1(1);
+		I x0 = V::cvt(fx), y0 = V::cvt(fy);
+		I x1 = wrap<V, W, Pow2>(V::iadd(x0, one), img.width, img.width_mask);
+		I y1 = wrap<V, W, Pow2>(V::iadd(y0, one), img.height, img.height_mask);
+		x0 = wrap<V, W, Pow2>(x0, img.width, img.width_mask);
+		y0 = wrap<V, W, Pow2>(y0, img.height, img.height_mask);
+
+		// 纹素下标 -> float 下标 (Vec3f 占 3 个 float)
+		auto to_float_index = [](I i) { return V::iadd(V::template shli<1>(i), i); };
+		I i00 = to_float_index(address<V, L>(img, x0, y0));
+		I i10 = to_float_index(address<V, L>(img, x1, y0));
+		I i01 = to_float_index(address<V, L>(img, x0, y1));
+		I i11 = to_float_index(address<V, L>(img, x1, y1));
+
+		const float* base = &img.texels[0].x;
+		F channel[3];
+		for (int c = 0; c < 3; ++c) {
+			F c00 = V::gather(base + c, i00);
+			F c10 = V::gather(base + c, i10);
+			F c01 = V::gather(base + c, i01);
+			F c11 = V::gather(base + c, i11);
+			F top = V::add(c00, V::mul(V::sub(c10, c00), sx));
+			F bot = V::add(c01, V::mul(V::sub(c11, c01), sx));
+			channel[c] = V::add(top, V::mul(V::sub(bot, top), ty));
+		}
+		r = channel[0]; g = channel[1]; b = channel[2];
+	}
 
-	// ==========================================
-	// 2. 映射到纹理尺寸
-	// ==========================================
-	float x_prime = u_img * width;
-	float y_prime = v_img * height;
+	// 按该层的布局 / 尺寸选择特化版本 (每批一次)
+	template<class V, WrapMode W>
+	static void bilinear_level(const TexelImage& img, typename V::F u, typename V::F v,
+		typename V::F& r, typename V::F& g, typename V::F& b) {
+		switch (img.layout) {
+		case TexelLayout::Morton: bilinear<V, W, TexelLayout::Morton, true>(img, u, v, r, g, b); break;
+		case TexelLayout::Tiled:
+			if (img.pow2) bilinear<V, W, TexelLayout::Tiled, true>(img, u, v, r, g, b);
+			else bilinear<V, W, TexelLayout::Tiled, false>(img, u, v, r, g, b);
+			break;
+		default:
+			if (img.pow2) bilinear<V, W, TexelLayout::Linear, true>(img, u, v, r, g, b);
+			else bilinear<V, W, TexelLayout::Linear, false>(img, u, v, r, g, b);
+			break;
+		}
+	}
+
+	template<class V, WrapMode W>
+	static void sample(const Texture& tex, float uv_scale, const float* u_in, const float* v_in, float lod, Vec3f* out) {
+		using F = typename V::F;
+		F scale = V::set1(uv_scale);
+		F u = V::mul(V::load(u_in), scale);
+		F v = V::mul(V::load(v_in), scale);
+
+		F r, g, b;
+		lod = std::max(0.0f, std::min(lod, (float)tex.mips.size()));
+		if (lod == 0.0f) {
+			bilinear_level<V, W>(tex.image, u, v, r, g, b);
+		}
+		else {
+			// 三线性：整批共用同一个 lod，两层各做一次 N 路双线性
+			int l0 = (int)lod;
+			int l1 = std::min(l0 + 1, (int)tex.mips.size());
+			F t = V::set1(lod - (float)l0);
+			F r1, g1, b1;
+			bilinear_level<V, W>(tex.getLevel(l0), u, v, r, g, b);
+			bilinear_level<V, W>(tex.getLevel(l1), u, v, r1, g1, b1);
+			r = V::add(r, V::mul(V::sub(r1, r), t));
+			g = V::add(g, V::mul(V::sub(g1, g), t));
+			b = V::add(b, V::mul(V::sub(b1, b), t));
+		}
 
-	// 2. 找到左下角整数坐标 (x0, y0)
-	// std::floor 确保负数也能正确向下取整 (e.g. -0.5 -> -1)
-	int x0 = (int)std::floor(x_prime - 0.5f);
-	int y0 = (int)std::floor(y_prime - 0.5f);
+		alignas(32) float rs[V::N], gs[V::N], bs[V::N];
+		V::store(rs, r); V::store(gs, g); V::store(bs, b);
+		for (int i = 0; i < V::N; ++i) out[i] = Vec3f(rs[i], gs[i], bs[i]);
+	}
 
-	// 3. 找到其他 3 个邻居
-	int x1 = x0 + 1;
-	int y1 = y0 + 1;
+	// 返回 false 表示该组合不走 SIMD，由调用方回退到标量
+	template<class V>
+	static bool run(const Texture& tex, const Sampler& s, const float* u, const float* v, Vec3f* out, float lod) {
+		if (tex.image.empty() || s.filter == FilterMode::Nearest) return false;
+		if (s.filter == FilterMode::Bilinear) lod = 0.0f;
+
+		switch (s.wrap) {
+		case WrapMode::Repeat: sample<V, WrapMode::Repeat>(tex, s.uv_scale, u, v, lod, out); return true;
+		case WrapMode::Clamp:  sample<V, WrapMode::Clamp>(tex, s.uv_scale, u, v, lod, out); return true;
+		case WrapMode::Mirror: sample<V, WrapMode::Mirror>(tex, s.uv_scale, u, v, lod, out); return true;
+		default: return false; // Border 需要逐纹素判断越界，走标量路径
+		}
+	}
+};
 
-	// 4. 计算权重 (s, t) -> 也就是小数部分
-	// 这里的中心点对齐修正：s = (u * w) - (x0 + 0.5)
-	float s = (x_prime - 0.5f) - std::floor(x_prime - 0.5f);
-	float t = (y_prime - 0.5f) - std::floor(y_prime - 0.5f);
+#endif // SR_SIMD_SSE4
 
-	// 5. 获取 4 个 Texel 的颜色
-	// c00 -- c10
-	//  |      |
-	// c01 -- c11  (注意：通常图片数据 y 向下增加还是向上增加取决于你的坐标系)
-	// 这里假设 y 向下增加:
-	// (x0, y0) (x1, y0)
-	// (x0, y1) (x1, y1)
+void Texture::sample4(const Sampler& sampler, const float* u, const float* v, Vec3f* out, float lod) const {
+#if defined(SR_SIMD_SSE4)
+	if (TextureBatchSampling::run<SimdSSE4>(*this, sampler, u, v, out, lod)) return;
+#endif
+	for (int i = 0; i < 4; ++i) out[i] = sample(sampler, u[i], v[i], lod);
+}
 
-	Vec3f c00 = getTexel(x0, y0); // 左上
-	Vec3f c10 = getTexel(x1, y0); // 右上
-	Vec3f c01 = getTexel(x0, y1); // 左下
-	Vec3f c11 = getTexel(x1, y1); // 右下
+void Texture::sample8(const Sampler& sampler, const float* u, const float* v, Vec3f* out, float lod) const {
+#if defined(SR_SIMD_AVX2)
+	if (TextureBatchSampling::run<SimdAVX2>(*this, sampler, u, v, out, lod)) return;
+#elif defined(SR_SIMD_SSE4)
+	if (TextureBatchSampling::run<SimdSSE4>(*this, sampler, u, v, out, lod) &&
+		TextureBatchSampling::run<SimdSSE4>(*this, sampler, u + 4, v + 4, out + 4, lod)) return;
+#endif
+	for (int i = 0; i < 8; ++i) out[i] = sample(sampler, u[i], v[i], lod);
+}
 
-	// 6. 三次 Lerp (线性插值)
-	// 水平插值 1 (Top)
-	Vec3f c_top = c00 * (1.0f - s) + c10 * s;
+float Texture::computeLod(float du_dx, float dv_dx, float du_dy, float dv_dy) const {
+	if (image.empty()) return 0.0f;
 
-	// 水平插值 2 (Bottom)
-	Vec3f c_bot = c01 * (1.0f - s) + c11 * s;
+	// 换算到纹素单位，取两个屏幕方向中变化更快的那个
+	float sx = (float)width, sy = (float)height;
+	float len_x = std::sqrt(du_dx * du_dx * sx * sx + dv_dx * dv_dx * sy * sy);
+	float len_y = std::sqrt(du_dy * du_dy * sx * sx + dv_dy * dv_dy * sy * sy);
+	float rho = std::max(len_x, len_y);
+	return rho > 1.0f ? std::log2(rho) : 0.0f;
+}
 
-	// 垂直插值 (Final)
-	Vec3f c_final = c_top * (1.0f - t) + c_bot * t;
+// ==========================================
+// 核心：双线性插值 (Bilinear Interpolation)
+// ==========================================
+// 默认采样器：Repeat + Bilinear
+Vec3f Texture::getColorBilinear(float u, float v) const {
+	// 如果没有 buffer 数据，回退到默认颜色或程序化纹理
+	if (image.empty()) return getColorCheckerboard(u, v);
 
-	return c_final;
+	static const Sampler default_sampler;
+	return TextureSampling::select(*this, default_sampler)(*this, default_sampler, u, v, 0.0f);
+}
+
+// ==========================================
+// Mipmap 生成 (2x2 盒式滤波)
+// ==========================================
+void Texture::generateMipmaps() {
+	mips.clear();
+	if (image.empty()) return;
+
+	const TexelImage* prev = &image;
+	while (prev->width > 1 || prev->height > 1) {
+		int w = std::max(1, prev->width / 2);
+		int h = std::max(1, prev->height / 2);
+
+		std::vector<Vec3f> row_major((size_t)w * h);
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				// 奇数尺寸时最后一列/行钳制到边缘
+				int sx0 = std::min(2 * x, prev->width - 1), sx1 = std::min(2 * x + 1, prev->width - 1);
+				int sy0 = std::min(2 * y, prev->height - 1), sy1 = std::min(2 * y + 1, prev->height - 1);
+				Vec3f sum = prev->fetch(sx0, sy0) + prev->fetch(sx1, sy0) + prev->fetch(sx0, sy1) + prev->fetch(sx1, sy1);
+				row_major[y * w + x] = sum * 0.25f;
+			}
+		}
+
+		TexelImage level;
+		level.build(w, h, row_major, image.layout); // 与原图保持相同布局
+		mips.push_back(std::move(level));
+		prev = &mips.back();
+	}
 }
 
 // ==========================================
@@ -183,7 +631,7 @@ Vec3f Texture::getColorBilinear(float u, float v) const {
 void Texture::createTestPattern(int w, int h) {
 	width = w;
 	height = h;
-	buffer.resize(w * h);
+	std::vector<Vec3f> buffer(w * h);
 
 	for (int y = 0; y < h; ++y) {
 		for (int x = 0; x < w; ++x) {
@@ -206,4 +654,68 @@ void Texture::createTestPattern(int w, int h) {
 			}
 		}
 	}
+
+	image.build(w, h, buffer, preferred_layout);
+	mips.clear();
+}
+
+void Texture::setLayout(TexelLayout l) {
+	preferred_layout = l;
+	if (image.empty()) return;
+
+	// 已有数据：先还原成行优先，再按新布局重建
+	std::vector<Vec3f> row_major(width * height);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			row_major[y * width + x] = image.fetch(x, y);
+		}
+	}
+	image.build(width, height, row_major, l);
+	if (!mips.empty()) generateMipmaps();
+}
+
+// ==========================================
+// TexelImage：布局转换
+// ==========================================
+static bool is_pow2(int v) {
+	return v > 0 && (v & (v - 1)) == 0;
+}
+
+static int log2_int(int v) {
+	int r = 0;
+	while ((1 << (r + 1)) <= v) ++r;
+	return r;
+}
+
+void TexelImage::build(int w, int h, const std::vector<Vec3f>& row_major, TexelLayout requested) {
+	width = w;
+	height = h;
+
+	// 1. 确定实际布局：Morton 只支持 2 的幂尺寸，否则退化为 Tiled
+	pow2 = is_pow2(w) && is_pow2(h);
+	layout = requested;
+	if (layout == TexelLayout::Auto) layout = pow2 ? TexelLayout::Morton : TexelLayout::Tiled;
+	if (layout == TexelLayout::Morton && !pow2) layout = TexelLayout::Tiled;
+
+	// 2. 预计算寻址参数
+	tiles_x = (w + TILE_MASK) >> TILE_SHIFT;
+	int tiles_y = (h + TILE_MASK) >> TILE_SHIFT;
+	pow2_tiles = is_pow2(tiles_x);
+	tiles_x_shift = pow2_tiles ? log2_int(tiles_x) : 0;
+	morton_bits = pow2 ? std::min(log2_int(w), log2_int(h)) : 0;
+	morton_mask = (1 << morton_bits) - 1;
+	width_mask = pow2 ? w - 1 : 0;
+	height_mask = pow2 ? h - 1 : 0;
+
+	// 3. 分配存储 (Tiled 需要把边缘补齐到整块)
+	size_t count = (size_t)w * h;
+	if (layout == TexelLayout::Tiled) count = (size_t)tiles_x * tiles_y * TILE_SIZE * TILE_SIZE;
+	texels.assign(count, Vec3f(0, 0, 0));
+
+	// 4. 重排
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			texels[index(x, y)] = row_major[y * w + x];
+		}
+	}
 }
\ No newline at end of file
@@ -1,7 +1,102 @@
 ﻿#pragma once
 #include "GMath.h"
+#include "Sampler.h"
 #include <vector>
 #include <string>
+#include <cstdint>
+
+// ==========================================
+// 纹素内存布局
+// ==========================================
+// 行优先 (Linear) 布局下，双线性采样的上下两行相距 width 个纹素，
+// UV 沿对角线或竖直方向扫过三角形时几乎每次采样都会 cache miss。
+// Tiled / Morton 布局把二维邻域放进连续内存，提高缓存命中率。
+enum class TexelLayout {
+	Auto,   // 自动：2 的幂尺寸用 Morton，其余用 Tiled
+	Linear, // 行优先 (y * width + x)
+	Tiled,  // 4x4 分块，块内行优先，块之间行优先
+	Morton  // Z-order (仅限宽高都是 2 的幂)
+};
+
+// ==========================================
+// 纹素存储：负责布局转换与寻址
+// ==========================================
+struct TexelImage {
+	static const int TILE_SHIFT = 2;              // 4x4 分块
+	static const int TILE_SIZE = 1 << TILE_SHIFT;
+	static const int TILE_MASK = TILE_SIZE - 1;
+
+	int width = 0;
+	int height = 0;
+	TexelLayout layout = TexelLayout::Linear;
+	std::vector<Vec3f> texels; // 按 layout 排列的 r,g,b 数据 (Tiled 模式下含 padding)
+
+	// 从行优先数据构建 (加载时调用一次)
+	void build(int w, int h, const std::vector<Vec3f>& row_major, TexelLayout requested);
+
+	// 布局相关的寻址：输入必须已经落在 [0, width) x [0, height) 内
+	int index(int x, int y) const {
+		switch (layout) {
+		case TexelLayout::Tiled:  return tiled_index(x, y);
+		case TexelLayout::Morton: return morton_index(x, y);
+		default:                  return y * width + x;
+		}
+	}
+
+	Vec3f fetch(int x, int y) const { return texels[index(x, y)]; }
+
+	bool empty() const { return texels.empty(); }
+
+	// 平铺用的掩码：宽高是 2 的幂时 x & width_mask 等价于取模
+	bool pow2 = false;
+	int width_mask = 0;
+	int height_mask = 0;
+
+	// 各布局的寻址函数 (公开，方便按布局特化的采样路径直接调用)
+	int tiled_index(int x, int y) const {
+		int tile = (pow2_tiles ? ((y >> TILE_SHIFT) << tiles_x_shift) : (y >> TILE_SHIFT) * tiles_x) + (x >> TILE_SHIFT);
+		return (tile << (2 * TILE_SHIFT)) | ((y & TILE_MASK) << TILE_SHIFT) | (x & TILE_MASK);
+	}
+
+	int morton_index(int x, int y) const {
+		// 低 morton_bits 位交织，高位 (只有较长的那条边才有) 作为方块序号
+		int block = (x >> morton_bits) | (y >> morton_bits);
+		return (block << (2 * morton_bits)) | (int)(part1by1(x & morton_mask) | (part1by1(y & morton_mask) << 1));
+	}
+
+	// 把 16 位整数的各位隔位展开：abcd -> 0a0b0c0d
+	static uint32_t part1by1(uint32_t v) {
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+private:
+	friend struct TextureBatchSampling;
+
+	// 寻址参数 (build 时预计算)
+	int tiles_x = 0;
+	int tiles_x_shift = 0;
+	bool pow2_tiles = false;
+	int morton_bits = 0;
+	int morton_mask = 0;
+};
+
+// ==========================================
+// 加载选项 (同时也是 TextureManager 缓存键的一部分)
+// ==========================================
+struct TextureLoadOptions {
+	bool flip_vertically = true;            // UV 原点在左下，图片通常在左上
+	TexelLayout layout = TexelLayout::Auto; // 纹素布局
+	bool generate_mipmaps = false;          // 加载后生成 Mipmap (Trilinear 需要)
+
+	bool operator==(const TextureLoadOptions& o) const {
+		return flip_vertically == o.flip_vertically && layout == o.layout && generate_mipmaps == o.generate_mipmaps;
+	}
+};
 
 class Texture {
 public:
@@ -9,16 +104,37 @@ public:
 
 	// 从文件加载
 	bool loadTexture(const std::string& path);
+	bool loadTexture(const std::string& path, const TextureLoadOptions& options);
+
+	// 纹素数据 (含 Mipmap) 占用的内存，单位字节
+	size_t memoryBytes() const;
 
 	// 采样函数
 	Vec3f sample(float u, float v) const;
 
+	// 按采样器状态采样
+	// lod: Mipmap 层级 (只有 Trilinear 会用到)，0 为原图
+	Vec3f sample(const Sampler& sampler, float u, float v, float lod = 0.0f) const;
+
+	// 批量采样：一次处理 4 / 8 组 UV，结果写入 out
+	// Bilinear/Trilinear + Repeat/Clamp/Mirror 走 SIMD 路径 (SSE4.1 / AVX2 gather)，
+	// 其余组合 (或不支持 SIMD 的平台) 逐个回退到 sample
+	// lod 对整批采样共用 (一个像素的 4 个采样点或一个 2x2 quad)
+	void sample4(const Sampler& sampler, const float* u, const float* v, Vec3f* out, float lod = 0.0f) const;
+	void sample8(const Sampler& sampler, const float* u, const float* v, Vec3f* out, float lod = 0.0f) const;
+
+	// 根据屏幕空间 UV 导数 (每像素) 估算 Mip 层级；导数需已乘上 Sampler::uv_scale
+	float computeLod(float du_dx, float dv_dx, float du_dy, float dv_dy) const;
+
+	// 生成 Mipmap 链 (2x2 盒式滤波)，Trilinear 采样依赖它
+	void generateMipmaps();
+	int getMipCount() const { return (int)mips.size() + 1; }
+	const TexelImage& getLevel(int level) const { return level == 0 ? image : mips[level - 1]; }
+
 	// 设置棋盘格颜色
 	void setColors(const Vec3f& c1, const Vec3f& c2);
-	// 设置缩放（格子密度）
-	void setScale(float s);
 
-	// 核心采样函数
+	// 核心采样函数：每个单位 UV 一格 (格子密度由调用方缩放 UV，见 Sampler::uv_scale)
 	Vec3f getColorCheckerboard(float u, float v) const;
 
 
@@ -28,17 +144,25 @@ public:
 	// 【核心目标】双线性插值采样
 	Vec3f getColorBilinear(float u, float v) const;
 
+	// 设置纹素布局 (已加载的数据会按新布局重排)
+	void setLayout(TexelLayout l);
+	TexelLayout getLayout() const { return image.layout; }
+
 public:
 	// 图片纹理支持
 	int width = 0;
 	int height = 0;
-	std::vector<Vec3f> buffer; // 存储 r,g,b 数据
+	TexelImage image; // 存储 r,g,b 数据 (布局见 image.layout)
 
 private:
 	Vec3f colorA;
 	Vec3f colorB;
-	float scale;
+	TexelLayout preferred_layout = TexelLayout::Auto;
+
+	// Mipmap 链：mips[0] 是 1/2 分辨率，依次减半直到 1x1
+	std::vector<TexelImage> mips;
 
-	// 辅助：获取整数坐标的颜色（处理边界/平铺）
-	Vec3f getTexel(int x, int y) const;
+	// 编译期特化的采样函数实现 (见 Texture.cpp)
+	friend struct TextureSampling;
+	friend struct TextureBatchSampling;
 };
\ No newline at end of file
@@ -0,0 +1,97 @@
+﻿#include "TextureManager.h"
+#include <iostream>
+
+TextureManager::TextureManager(size_t memory_budget_bytes) : budget(memory_budget_bytes) {
+}
+
+TextureManager& TextureManager::instance() {
+	static TextureManager manager;
+	return manager;
+}
+
+std::string TextureManager::make_key(const std::string& path, const TextureLoadOptions& options) {
+	// 路径 + 影响解码结果的选项
+	return path + "|" + (options.flip_vertically ? "f" : "n")
+		+ std::to_string((int)options.layout)
+		+ (options.generate_mipmaps ? "m" : "-");
+}
+
+std::shared_ptr<const Texture> TextureManager::load(const std::string& path, const TextureLoadOptions& options) {
+	const std::string key = make_key(path, options);
+
+	// 1. 命中：移到 LRU 头部
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = lookup.find(key);
+		if (it != lookup.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			counters.hits++;
+			return it->second->texture;
+		}
+	}
+
+	// 2. 未命中：在锁外解码 (stb 解码 + Mip + 布局转换很慢，不能把其他纹理的加载也挡住)
+	auto texture = std::make_shared<Texture>();
+	const bool loaded = texture->loadTexture(path, options);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	counters.misses++;
+	if (!loaded) return nullptr;
+
+	// 3. 解码期间其他线程可能已经放入了同一张：沿用缓存里的，保证所有使用者共享同一份
+	auto it = lookup.find(key);
+	if (it != lookup.end()) {
+		lru.splice(lru.begin(), lru, it->second);
+		return it->second->texture;
+	}
+
+	// 4. 放入缓存并检查预算
+	Entry entry;
+	entry.key = key;
+	entry.texture = texture;
+	entry.bytes = texture->memoryBytes();
+	lru.push_front(std::move(entry));
+	lookup[key] = lru.begin();
+	usage += lru.front().bytes;
+
+	evict_locked();
+	return texture;
+}
+
+void TextureManager::set_memory_budget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = bytes;
+	evict_locked();
+}
+
+size_t TextureManager::memory_usage() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return usage;
+}
+
+void TextureManager::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	lru.clear();
+	lookup.clear();
+	usage = 0;
+}
+
+TextureManager::Stats TextureManager::stats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+void TextureManager::evict_locked() {
+	// 从最久未使用的一端开始，跳过还有外部句柄的条目
+	auto it = lru.end();
+	while (usage > budget && it != lru.begin()) {
+		--it;
+		if (it->texture.use_count() > 1) continue;
+
+		std::cout << "Texture evicted: " << it->key << " (" << it->bytes / 1024 << " KB)" << std::endl;
+		usage -= it->bytes;
+		lookup.erase(it->key);
+		it = lru.erase(it);
+		counters.evictions++;
+	}
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+#include "Texture.h"
+#include <memory>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+// ==========================================
+// 纹理缓存 / 资源注册表
+// ==========================================
+// 以 (路径, 加载选项) 为键，同一张图片只解码一次，返回共享句柄。
+// 超出内存预算时按 LRU 淘汰缓存条目：
+//   - 只淘汰没有外部使用者的条目 (还在用的纹理淘汰了也省不下内存)
+//   - 被淘汰的纹理下次 load 会重新解码
+// 句柄是只读的 (shared_ptr<const Texture>)：同一张纹理被所有使用者共享，
+// UV 缩放等使用方式放在各自的 Sampler 里。
+// 解码在锁外进行，不同纹理可以并行加载；同一张纹理被同时请求时可能重复解码，但只保留先放入缓存的那份。
+class TextureManager {
+public:
+	struct Stats {
+		size_t hits = 0;      // 命中缓存
+		size_t misses = 0;    // 需要解码
+		size_t evictions = 0; // 被 LRU 淘汰的条目
+	};
+
+	explicit TextureManager(size_t memory_budget_bytes = DEFAULT_BUDGET);
+
+	// 全局实例 (批量渲染任务共享同一份缓存)
+	static TextureManager& instance();
+
+	// 加载纹理：命中缓存直接返回；失败返回 nullptr
+	std::shared_ptr<const Texture> load(const std::string& path, const TextureLoadOptions& options = TextureLoadOptions());
+
+	// 内存预算 (字节)，调小会立即触发淘汰
+	void set_memory_budget(size_t bytes);
+	size_t memory_budget() const { return budget; }
+
+	// 当前缓存条目占用的内存 (字节)
+	size_t memory_usage() const;
+
+	// 清空缓存 (外部持有的句柄依然有效)
+	void clear();
+
+	Stats stats() const;
+
+	static const size_t DEFAULT_BUDGET = 512ull * 1024 * 1024;
+
+private:
+	struct Entry {
+		std::string key;
+		std::shared_ptr<const Texture> texture;
+		size_t bytes = 0;
+	};
+
+	static std::string make_key(const std::string& path, const TextureLoadOptions& options);
+
+	// 在持有锁的情况下按 LRU 淘汰，直到回到预算以内
+	void evict_locked();
+
+	mutable std::mutex mutex;
+	std::list<Entry> lru; // 头部是最近使用的
+	std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+	size_t budget;
+	size_t usage = 0;
+	Stats counters;
+};
@@ -0,0 +1,101 @@
+﻿#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+	if (threads == 0) {
+		unsigned hw = std::thread::hardware_concurrency();
+		threads = hw > 1 ? hw - 1 : 0;
+	}
+	workers.reserve(threads);
+	for (unsigned i = 0; i < threads; ++i) {
+		workers.emplace_back([this] { worker_loop(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::instance() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+	if (count == 0) return;
+
+	// 1. 自动粒度：每个线程大约分到 4 块，兼顾负载均衡和调度开销
+	if (grain == 0) grain = std::max<size_t>(1, count / ((size_t)concurrency() * 4));
+	size_t chunks = (count + grain - 1) / grain;
+
+	// 只有一块或没有工作线程：直接在当前线程执行
+	if (chunks == 1 || workers.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	// 2. 发布任务：每个工作线程最多一个入口，实际的块通过原子计数领取
+	auto job = std::make_shared<Job>();
+	job->fn = &fn;
+	job->count = count;
+	job->grain = grain;
+	job->chunks = chunks;
+
+	size_t helpers = std::min(workers.size(), chunks - 1);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < helpers; ++i) queue.push_back(job);
+	}
+	if (helpers == workers.size()) wake.notify_all();
+	else for (size_t i = 0; i < helpers; ++i) wake.notify_one();
+
+	// 3. 调用线程也参与，然后等待其他线程手里的块完成
+	run_chunks(*job);
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&] { return job->done.load() == job->chunks; });
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+	parallel_for(count, 0, [&fn](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) fn(i);
+	});
+}
+
+void ThreadPool::run_chunks(Job& job) {
+	size_t finished = 0;
+	for (;;) {
+		size_t chunk = job.next.fetch_add(1);
+		if (chunk >= job.chunks) break;
+		size_t begin = chunk * job.grain;
+		size_t end = std::min(job.count, begin + job.grain);
+		(*job.fn)(begin, end);
+		finished++;
+	}
+	if (finished == 0) return;
+
+	// 最后一个完成的线程负责唤醒调用者
+	if (job.done.fetch_add(finished) + finished == job.chunks) {
+		std::lock_guard<std::mutex> lock(job.mutex);
+		job.finished.notify_all();
+	}
+}
+
+void ThreadPool::worker_loop() {
+	for (;;) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping && queue.empty()) return;
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+		// 任务可能已经被其他线程领完，这时 run_chunks 立即返回
+		run_chunks(*job);
+	}
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ==========================================
+// 线程池 + parallel_for
+// ==========================================
+// 只提供数据并行：把 [0, count) 切成若干块，由工作线程和调用线程一起领取执行。
+// 调用线程自己也领块干活，所以在任务内部再次调用 parallel_for (嵌套) 也不会死锁，
+// 最坏情况下退化为调用线程串行跑完。
+class ThreadPool {
+public:
+	// threads 为工作线程数，0 表示 hardware_concurrency - 1 (调用线程算一个)
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// 全局实例
+	static ThreadPool& instance();
+
+	// 参与计算的线程数 (工作线程 + 调用线程)
+	unsigned concurrency() const { return (unsigned)workers.size() + 1; }
+
+	// fn(begin, end) 处理一段连续区间；grain 为每块的最小长度 (0 表示自动)
+	// 返回时所有块都已执行完毕
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+	// 逐元素版本
+	void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+	struct Job {
+		const std::function<void(size_t, size_t)>* fn = nullptr;
+		size_t count = 0;
+		size_t grain = 1;
+		size_t chunks = 0;
+		std::atomic<size_t> next{ 0 };  // 下一个待领取的块
+		std::atomic<size_t> done{ 0 };  // 已完成的块
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	// 领取并执行块，直到没有剩余
+	static void run_chunks(Job& job);
+	void worker_loop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::shared_ptr<Job>> queue;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
@@ -0,0 +1,232 @@
+﻿#include "TriangleMesh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+TriangleMesh::TriangleMesh(const Mesh& mesh, const BVHNode::Settings& settings) {
+	bind(mesh);
+	build(settings);
+}
+
+TriangleMesh::TriangleMesh(Mesh&& mesh, const BVHNode::Settings& settings)
+	: owned(std::move(mesh)) {
+	bind(owned);
+	build(settings);
+}
+
+TriangleMesh::TriangleMesh(const QuantizedMesh& mesh, const BVHNode::Settings& settings) {
+	bind(mesh);
+	build(settings);
+}
+
+TriangleMesh::TriangleMesh(QuantizedMesh&& mesh, const BVHNode::Settings& settings)
+	: owned_quantized(std::move(mesh)) {
+	bind(owned_quantized);
+	build(settings);
+}
+
+void TriangleMesh::bind(const QuantizedMesh& mesh) {
+	quantized = &mesh;
+	indices = std::span<const int>(mesh.indices.data(), mesh.indices.size() - mesh.indices.size() % 3);
+}
+
+void TriangleMesh::bind(const Mesh& mesh) {
+	positions = mesh.positions;
+	indices = std::span<const int>(mesh.indices.data(), mesh.indices.size() - mesh.indices.size() % 3);
+	// 法线 / UV 只有和顶点一一对应时才插值
+	if (mesh.normals.size() == mesh.positions.size()) normals = mesh.normals;
+	if (mesh.uvs.size() == mesh.positions.size()) uvs = mesh.uvs;
+}
+
+void TriangleMesh::build(const BVHNode::Settings& settings) {
+	const size_t count = triangle_count();
+	std::vector<AABB> boxes(count);
+	ThreadPool::instance().parallel_for(count, 0, [&](size_t b, size_t e) {
+		for (size_t t = b; t < e; ++t) {
+			boxes[t].expand(vertex(t, 0));
+			boxes[t].expand(vertex(t, 1));
+			boxes[t].expand(vertex(t, 2));
+		}
+	});
+	tree = LinearBVH(boxes, settings, LinearBVH::Builder::Auto);
+	wide = DefaultWideBVH(tree);
+	for (int a = 0; a < 3; ++a) {
+		tris.v0[a].assign(count + PADDING, 0.0f);
+		tris.e1[a].assign(count + PADDING, 0.0f);
+		tris.e2[a].assign(count + PADDING, 0.0f);
+	}
+	update_triangles();
+}
+
+void TriangleMesh::update_triangles() {
+	const std::vector<uint32_t>& order = tree.get_order();
+	ThreadPool::instance().parallel_for(order.size(), 0, [&](size_t b, size_t e) {
+		for (size_t i = b; i < e; ++i) {
+			size_t t = order[i];
+			Vec3f v0 = vertex(t, 0);
+			Vec3f e1 = vertex(t, 1) - v0;
+			Vec3f e2 = vertex(t, 2) - v0;
+			tris.v0[0][i] = v0.x; tris.v0[1][i] = v0.y; tris.v0[2][i] = v0.z;
+			tris.e1[0][i] = e1.x; tris.e1[1][i] = e1.y; tris.e1[2][i] = e1.z;
+			tris.e2[0][i] = e2.x; tris.e2[1][i] = e2.y; tris.e2[2][i] = e2.z;
+		}
+	});
+}
+
+void TriangleMesh::refit() {
+	update_triangles();
+	const std::vector<uint32_t>& order = tree.get_order();
+	tree.refit([&](size_t i) {
+		AABB box;
+		box.expand(vertex(order[i], 0));
+		box.expand(vertex(order[i], 1));
+		box.expand(vertex(order[i], 2));
+		return box;
+	});
+	wide.refit(tree);
+}
+
+// ==========================================
+// 叶子求交：Moller-Trumbore (与 Triangle::intersect 相同的运算顺序)
+// ==========================================
+// SSE 下 4 个三角形一组，每个通道一个三角形；通过测试的通道再按顺序收紧 t_max，
+// 结果与逐个测试完全一致 (相同的 t 时后面的覆盖前面的)。
+bool TriangleMesh::intersect_leaf(const Ray& r, size_t first, size_t count, float t_min, float& t_max, size_t& hit_index, float& hit_u, float& hit_v) const {
+	const float EPSILON = 1e-6f;
+	bool found = false;
+
+#if defined(SR_BVH_SSE)
+	const __m128 ox = _mm_set1_ps(r.orig.x), oy = _mm_set1_ps(r.orig.y), oz = _mm_set1_ps(r.orig.z);
+	const __m128 dx = _mm_set1_ps(r.dir.x), dy = _mm_set1_ps(r.dir.y), dz = _mm_set1_ps(r.dir.z);
+	const __m128 eps = _mm_set1_ps(EPSILON), neg_eps = _mm_set1_ps(-EPSILON);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	const __m128 lo = _mm_set1_ps(t_min);
+
+	for (size_t base = first; base < first + count; base += 4) {
+		const __m128 e1x = _mm_loadu_ps(&tris.e1[0][base]), e1y = _mm_loadu_ps(&tris.e1[1][base]), e1z = _mm_loadu_ps(&tris.e1[2][base]);
+		const __m128 e2x = _mm_loadu_ps(&tris.e2[0][base]), e2y = _mm_loadu_ps(&tris.e2[1][base]), e2z = _mm_loadu_ps(&tris.e2[2][base]);
+
+		// h = dir x e2, a = e1 . h
+		const __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		const __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		const __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+		const __m128 f = _mm_div_ps(one, a);
+
+		// s = orig - v0, u = f * (s . h)
+		const __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(&tris.v0[0][base]));
+		const __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(&tris.v0[1][base]));
+		const __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(&tris.v0[2][base]));
+		const __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+		// q = s x e1, v = f * (dir . q), t = f * (e2 . q)
+		const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		const __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+		const __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+		__m128 valid = _mm_or_ps(_mm_cmple_ps(a, neg_eps), _mm_cmpge_ps(a, eps));
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(t, lo));
+
+		const size_t lanes = std::min<size_t>(4, first + count - base);
+		unsigned mask = (unsigned)_mm_movemask_ps(valid) & ((1u << lanes) - 1);
+		if (!mask) continue;
+
+		alignas(16) float ts[4], us[4], vs[4];
+		_mm_store_ps(ts, t);
+		_mm_store_ps(us, u);
+		_mm_store_ps(vs, v);
+		while (mask) {
+			const int l = std::countr_zero(mask);
+			mask &= mask - 1;
+			if (ts[l] > t_max) continue;
+			t_max = ts[l];
+			hit_index = base + l;
+			hit_u = us[l];
+			hit_v = vs[l];
+			found = true;
+		}
+	}
+#else
+	for (size_t i = first; i < first + count; ++i) {
+		const Vec3f e1(tris.e1[0][i], tris.e1[1][i], tris.e1[2][i]);
+		const Vec3f e2(tris.e2[0][i], tris.e2[1][i], tris.e2[2][i]);
+		Vec3f h = r.dir.cross(e2);
+		float a = e1.dot(h);
+		if (a > -EPSILON && a < EPSILON) continue;
+
+		float f = 1.0f / a;
+		Vec3f s = r.orig - Vec3f(tris.v0[0][i], tris.v0[1][i], tris.v0[2][i]);
+		float u = f * s.dot(h);
+		if (u < 0.0f || u > 1.0f) continue;
+
+		Vec3f q = s.cross(e1);
+		float v = f * r.dir.dot(q);
+		if (v < 0.0f || u + v > 1.0f) continue;
+
+		float t = f * e2.dot(q);
+		if (t < t_min || t > t_max) continue;
+
+		t_max = t;
+		hit_index = i;
+		hit_u = u;
+		hit_v = v;
+		found = true;
+	}
+#endif
+	return found;
+}
+
+bool TriangleMesh::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const {
+	size_t hit_index = 0;
+	float hit_t = tmax, hit_u = 0.0f, hit_v = 0.0f;
+
+	// traverse 按值接收 tmax，最近的交点距离要在叶子回调里自己记下
+	bool hit = wide.traverse(r, tmin, tmax, [&](size_t first, size_t count, float t_min, float& t_max) {
+		if (!intersect_leaf(r, first, count, t_min, t_max, hit_index, hit_u, hit_v)) return false;
+		hit_t = t_max;
+		return true;
+	});
+	if (!hit) return false;
+
+	const size_t tri = tree.get_order()[hit_index];
+	const Vec3f e1(tris.e1[0][hit_index], tris.e1[1][hit_index], tris.e1[2][hit_index]);
+	const Vec3f e2(tris.e2[0][hit_index], tris.e2[1][hit_index], tris.e2[2][hit_index]);
+	rec.t = hit_t;
+	rec.p = r.pointAt(rec.t);
+	rec.u = hit_u;
+	rec.v = hit_v;
+	rec.prim_id = (int)tri;
+
+	// 正反面由几何法线决定；有顶点法线时用插值法线着色 (翻到与几何法线同一侧)
+	Vec3f geometric = e1.cross(e2).normalize();
+	rec.front_face = r.dir.dot(geometric) < 0;
+	Vec3f n = geometric;
+	const float w = 1.0f - hit_u - hit_v;
+	const int* idx = &indices[tri * 3];
+	if (has_normals()) {
+		Vec3f smooth = vertex_normal(idx[0]) * w + vertex_normal(idx[1]) * hit_u + vertex_normal(idx[2]) * hit_v;
+		if (smooth.length() > 1e-12f) n = smooth.dot(geometric) < 0.0f ? smooth.normalize() * -1.0f : smooth.normalize();
+	}
+	rec.normal = rec.front_face ? n : n * -1.0f;
+	if (has_uvs()) {
+		const Vec2f a = vertex_uv(idx[0]);
+		const Vec2f b = vertex_uv(idx[1]);
+		const Vec2f c = vertex_uv(idx[2]);
+		rec.uv = Vec2f(a.x * w + b.x * hit_u + c.x * hit_v, a.y * w + b.y * hit_u + c.y * hit_v);
+	}
+	return true;
+}
+
+AABB TriangleMesh::get_bounding_box() const {
+	return tree.get_bounding_box();
+}
+
+size_t TriangleMesh::memory_bytes() const {
+	return sizeof(*this) + tris.v0[0].capacity() * sizeof(float) * 9 + tree.node_count() * sizeof(LinearBVH::Node)
+		+ wide.memory_bytes() + tree.get_order().capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <span>
+#include <vector>
+#include "Geometry.h"
+#include "LinearBVH.h"
+#include "WideBVH.h"
+#include "QuantizedMesh.h"
+
+// ========================================================================
+// 三角形网格 (TriangleMesh)：整个 Mesh 作为一个物体，内部自带 BVH
+// ========================================================================
+// 相比每个三角形 new 一个 Triangle (虚表指针 + 3 个顶点副本 + 法线，散落在堆上)：
+//   - 顶点位置和索引直接引用 Mesh 的数组 (视图，不复制)
+//   - 旁路数组只存 Moller-Trumbore 需要的起点和两条边 (按 BVH 叶子顺序、按分量 SoA 排列，遍历时连续访问)
+//   - 遍历走收缩后的宽 BVH (BVH4 / BVH8)，叶子一次用 SSE 测 4 个三角形，没有虚调用
+// 击中时在 HitRecord 里给出重心坐标和三角形编号，有顶点法线 / UV 时插值出平滑法线和纹理坐标。
+// 也可以直接建在 QuantizedMesh 上：位置只在填 SoA 时解码，法线 / UV 在击中时按需解码，不生成浮点 Mesh。
+class TriangleMesh : public Object {
+public:
+	// 叶子里的三角形求交没有虚调用，比访问一个节点贵不了多少：叶子放得更多，节点数 (和内存) 减少
+	static BVHNode::Settings default_settings() { return BVHNode::Settings{ 16, 8, 3.0f, 1.0f }; }
+
+	// 引用外部 Mesh：调用方保证 Mesh 比 TriangleMesh 活得久，且期间不改变数组大小
+	explicit TriangleMesh(const Mesh& mesh, const BVHNode::Settings& settings = default_settings());
+	// 接管 Mesh
+	explicit TriangleMesh(Mesh&& mesh, const BVHNode::Settings& settings = default_settings());
+	// 引用外部压缩 Mesh (同样要求比 TriangleMesh 活得久)
+	explicit TriangleMesh(const QuantizedMesh& mesh, const BVHNode::Settings& settings = default_settings());
+	// 接管压缩 Mesh
+	explicit TriangleMesh(QuantizedMesh&& mesh, const BVHNode::Settings& settings = default_settings());
+
+	TriangleMesh(const TriangleMesh&) = delete;
+	TriangleMesh& operator=(const TriangleMesh&) = delete;
+
+	virtual bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override;
+	virtual AABB get_bounding_box() const override;
+
+	// 顶点被移动 / 变形 (数量和索引不变) 后调用：重算边向量，内部 BVH (二叉和宽的) 重新拟合
+	void refit();
+
+	size_t triangle_count() const { return indices.size() / 3; }
+	const LinearBVH& bvh() const { return tree; }
+	const DefaultWideBVH& wide_bvh() const { return wide; }
+	// 加速数据 (三角形 SoA + BVH 节点 + 顺序表) 占用的字节数，不含 Mesh 本身
+	size_t memory_bytes() const;
+
+private:
+	// 按分量拆开的三角形数据，下标是 BVH 顺序：第 i 个属于三角形 tree.get_order()[i]。
+	// 末尾多留 3 个 0，叶子尾部不足 4 个时 SIMD 照样整组读取
+	static const size_t PADDING = 3;
+	struct TriangleSoA {
+		std::vector<float> v0[3]; // 第一个顶点
+		std::vector<float> e1[3]; // v1 - v0
+		std::vector<float> e2[3]; // v2 - v0
+	};
+
+	bool intersect_leaf(const Ray& r, size_t first, size_t count, float t_min, float& t_max, size_t& hit_index, float& hit_u, float& hit_v) const;
+	void bind(const Mesh& mesh);
+	void bind(const QuantizedMesh& mesh);
+	void build(const BVHNode::Settings& settings);
+	void update_triangles();
+	Vec3f vertex(size_t tri, int k) const {
+		const int i = indices[tri * 3 + k];
+		return quantized ? quantized->position(i) : positions[i];
+	}
+	bool has_normals() const { return quantized || !normals.empty(); }
+	bool has_uvs() const { return quantized || !uvs.empty(); }
+	Vec3f vertex_normal(int i) const { return quantized ? quantized->normal(i) : normals[i]; }
+	Vec2f vertex_uv(int i) const { return quantized ? quantized->uv(i) : uvs[i]; }
+
+	Mesh owned; // 接管时使用；引用外部 Mesh 时为空
+	QuantizedMesh owned_quantized;
+	const QuantizedMesh* quantized = nullptr; // 非空时顶点数据都从这里解码，positions / normals / uvs 为空
+	std::span<const Vec3f> positions;
+	std::span<const Vec3f> normals;
+	std::span<const Vec2f> uvs;
+	std::span<const int> indices;
+
+	LinearBVH tree;     // 二叉树：负责构建、顺序表和 refit
+	DefaultWideBVH wide; // 由 tree 收缩而来，求交时遍历它
+	TriangleSoA tris;
+};
@@ -0,0 +1,402 @@
+﻿#include "VirtualTexture.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ==========================================
+// .vtex 文件布局 (小端)
+// ==========================================
+// Header  : magic, version, width, height, tile_size, mip_count, reserved(8) = 32 字节
+// MipDesc : width, height, tiles_x, tiles_y, offset(8)                         = 24 字节
+// Tile 数据从 4KB 对齐处开始，同一级的 Tile 按行优先连续存放
+namespace {
+	const size_t HEADER_BYTES = 32;
+	const size_t MIP_DESC_BYTES = 24;
+	const uint64_t DATA_ALIGN = 4096;
+
+	template <typename T>
+	void put(std::vector<uint8_t>& buf, T value) {
+		uint8_t bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		buf.insert(buf.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T>
+	T get(const uint8_t* p) {
+		T value;
+		std::memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	bool is_pow2(int x) { return x > 0 && (x & (x - 1)) == 0; }
+}
+
+// ==========================================
+// 离线构建
+// ==========================================
+bool VirtualTexture::build(const std::string& image_path, const std::string& out_path, int tile_size, bool flip_vertically) {
+	if (tile_size < 8 || !is_pow2(tile_size)) {
+		std::cerr << "Virtual texture tile size must be a power of two >= 8: " << tile_size << std::endl;
+		return false;
+	}
+
+	// 1. 解码源图片 (与 Texture 保持同样的 UV 朝向)
+	int w, h, channels;
+	stbi_set_flip_vertically_on_load_thread(flip_vertically ? 1 : 0);
+	unsigned char* data = stbi_load(image_path.c_str(), &w, &h, &channels, 3);
+	if (!data) {
+		std::cerr << "Failed to load texture: " << image_path << std::endl;
+		return false;
+	}
+
+	// 2. 生成 Mip 链 (2x2 Box Filter)，直到整级能放进一个 Tile
+	struct Image { int w, h; std::vector<uint8_t> rgb; };
+	std::vector<Image> chain;
+	chain.push_back({ w, h, std::vector<uint8_t>(data, data + (size_t)w * h * 3) });
+	stbi_image_free(data);
+
+	while (chain.back().w > tile_size || chain.back().h > tile_size) {
+		const Image& prev = chain.back();
+		Image next;
+		next.w = std::max(1, prev.w / 2);
+		next.h = std::max(1, prev.h / 2);
+		next.rgb.resize((size_t)next.w * next.h * 3);
+		for (int y = 0; y < next.h; ++y) {
+			// 奇数尺寸时最后一列/行钳制到边缘
+			int sy0 = std::min(2 * y, prev.h - 1), sy1 = std::min(2 * y + 1, prev.h - 1);
+			for (int x = 0; x < next.w; ++x) {
+				int sx0 = std::min(2 * x, prev.w - 1), sx1 = std::min(2 * x + 1, prev.w - 1);
+				for (int c = 0; c < 3; ++c) {
+					int sum = prev.rgb[((size_t)sy0 * prev.w + sx0) * 3 + c] + prev.rgb[((size_t)sy0 * prev.w + sx1) * 3 + c]
+						+ prev.rgb[((size_t)sy1 * prev.w + sx0) * 3 + c] + prev.rgb[((size_t)sy1 * prev.w + sx1) * 3 + c];
+					next.rgb[((size_t)y * next.w + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+		chain.push_back(std::move(next));
+	}
+
+	// 3. 写 Header 和 MipDesc
+	const uint64_t tile_bytes = (uint64_t)tile_size * tile_size * 3;
+	std::vector<uint8_t> header;
+	put<uint32_t>(header, MAGIC);
+	put<uint32_t>(header, VERSION);
+	put<uint32_t>(header, (uint32_t)w);
+	put<uint32_t>(header, (uint32_t)h);
+	put<uint32_t>(header, (uint32_t)tile_size);
+	put<uint32_t>(header, (uint32_t)chain.size());
+	put<uint64_t>(header, 0);
+
+	uint64_t offset = HEADER_BYTES + MIP_DESC_BYTES * chain.size();
+	offset = (offset + DATA_ALIGN - 1) / DATA_ALIGN * DATA_ALIGN;
+	for (const Image& img : chain) {
+		uint32_t tiles_x = (uint32_t)((img.w + tile_size - 1) / tile_size);
+		uint32_t tiles_y = (uint32_t)((img.h + tile_size - 1) / tile_size);
+		put<uint32_t>(header, (uint32_t)img.w);
+		put<uint32_t>(header, (uint32_t)img.h);
+		put<uint32_t>(header, tiles_x);
+		put<uint32_t>(header, tiles_y);
+		put<uint64_t>(header, offset);
+		offset += tile_bytes * tiles_x * tiles_y;
+	}
+	header.resize((header.size() + DATA_ALIGN - 1) / DATA_ALIGN * DATA_ALIGN, 0);
+
+	std::ofstream out(out_path, std::ios::binary);
+	if (!out) {
+		std::cerr << "Failed to create virtual texture: " << out_path << std::endl;
+		return false;
+	}
+	out.write((const char*)header.data(), (std::streamsize)header.size());
+
+	// 4. 逐 Tile 写出 (越界部分复制边缘纹素)
+	std::vector<uint8_t> tile((size_t)tile_bytes);
+	for (const Image& img : chain) {
+		int tiles_x = (img.w + tile_size - 1) / tile_size;
+		int tiles_y = (img.h + tile_size - 1) / tile_size;
+		for (int ty = 0; ty < tiles_y; ++ty) {
+			for (int tx = 0; tx < tiles_x; ++tx) {
+				for (int y = 0; y < tile_size; ++y) {
+					int sy = std::min(ty * tile_size + y, img.h - 1);
+					for (int x = 0; x < tile_size; ++x) {
+						int sx = std::min(tx * tile_size + x, img.w - 1);
+						std::memcpy(&tile[((size_t)y * tile_size + x) * 3], &img.rgb[((size_t)sy * img.w + sx) * 3], 3);
+					}
+				}
+				out.write((const char*)tile.data(), (std::streamsize)tile.size());
+			}
+		}
+	}
+
+	if (!out) {
+		std::cerr << "Failed to write virtual texture: " << out_path << std::endl;
+		return false;
+	}
+	std::cout << "Virtual texture built: " << out_path << " (" << w << "x" << h
+		<< ", " << chain.size() << " mips, tile " << tile_size << ")" << std::endl;
+	return true;
+}
+
+// ==========================================
+// 打开 / 关闭
+// ==========================================
+bool VirtualTexture::open(const std::string& path, size_t cache_tiles) {
+	close();
+	if (!file.open(path, MappedFile::Access::Random)) return false;
+
+	const uint8_t* base = file.data();
+	if (file.size() < HEADER_BYTES || get<uint32_t>(base) != MAGIC || get<uint32_t>(base + 4) != VERSION) {
+		std::cerr << "Not a virtual texture (bad header): " << path << std::endl;
+		close();
+		return false;
+	}
+
+	width = (int)get<uint32_t>(base + 8);
+	height = (int)get<uint32_t>(base + 12);
+	tile_size = (int)get<uint32_t>(base + 16);
+	uint32_t mip_count = get<uint32_t>(base + 20);
+	if (tile_size < 8 || !is_pow2(tile_size) || mip_count == 0 || mip_count > 32
+		|| file.size() < HEADER_BYTES + MIP_DESC_BYTES * mip_count) {
+		std::cerr << "Corrupt virtual texture header: " << path << std::endl;
+		close();
+		return false;
+	}
+	while ((1 << tile_shift) < tile_size) ++tile_shift;
+	tile_bytes = (size_t)tile_size * tile_size * 3;
+
+	// 1. 读取每级 Mip 描述，并检查 Tile 数据没有越过文件末尾
+	levels.resize(mip_count);
+	for (uint32_t i = 0; i < mip_count; ++i) {
+		const uint8_t* desc = base + HEADER_BYTES + MIP_DESC_BYTES * i;
+		Level& level = levels[i];
+		level.width = (int)get<uint32_t>(desc);
+		level.height = (int)get<uint32_t>(desc + 4);
+		level.tiles_x = (int)get<uint32_t>(desc + 8);
+		level.tiles_y = (int)get<uint32_t>(desc + 12);
+		level.offset = get<uint64_t>(desc + 16);
+
+		uint64_t tiles = (uint64_t)level.tiles_x * level.tiles_y;
+		if (level.width <= 0 || level.height <= 0
+			|| level.tiles_x != (level.width + tile_size - 1) / tile_size
+			|| level.tiles_y != (level.height + tile_size - 1) / tile_size
+			|| level.offset + tiles * tile_bytes > file.size()) {
+			std::cerr << "Corrupt virtual texture mip " << i << ": " << path << std::endl;
+			close();
+			return false;
+		}
+		level.page.assign((size_t)tiles, -1);
+		level.requested.assign((size_t)tiles, 0);
+	}
+
+	// 2. 分配驻留缓存，常驻最粗一级
+	const Level& top = levels.back();
+	size_t pinned = (size_t)top.tiles_x * top.tiles_y;
+	size_t capacity = std::max(cache_tiles, pinned + 1);
+	slots.assign(capacity, Slot());
+	slot_texels.assign(capacity * tile_bytes, 0);
+	free_slots.clear();
+	for (int i = (int)capacity - 1; i >= 0; --i) free_slots.push_back(i);
+
+	int top_level = (int)levels.size() - 1;
+	for (int t = 0; t < (int)pinned; ++t) {
+		int slot = acquire_slot();
+		load_tile(slot, top_level, t);
+		slots[slot].pinned = true;
+	}
+
+	std::cout << "Virtual texture opened: " << path << " (" << width << "x" << height
+		<< ", " << levels.size() << " mips, cache " << capacity << " tiles)" << std::endl;
+	return true;
+}
+
+void VirtualTexture::close() {
+	file.close();
+	width = height = 0;
+	tile_size = tile_shift = 0;
+	tile_bytes = 0;
+	levels.clear();
+	slots.clear();
+	slot_texels.clear();
+	slot_texels.shrink_to_fit();
+	free_slots.clear();
+	pending.clear();
+	frame = 1;
+	fallback_count = 0;
+	upload_count = 0;
+	eviction_count = 0;
+}
+
+// ==========================================
+// 采样
+// ==========================================
+Vec3f VirtualTexture::sample(float u, float v, float lod) const {
+	if (levels.empty()) return Vec3f(1.0f, 1.0f, 1.0f);
+
+	int last = (int)levels.size() - 1;
+	int level = std::clamp((int)std::floor(lod + 0.5f), 0, last);
+
+	// 目标级别缺页时只对目标级别发请求，然后逐级变粗，最粗一级常驻必然成功
+	Vec3f color;
+	for (int l = level; l <= last; ++l) {
+		if (sample_level(l, u, v, l == level, color)) {
+			if (l != level) fallback_count++;
+			return color;
+		}
+	}
+	return color;
+}
+
+bool VirtualTexture::sample_level(int l, float u, float v, bool want, Vec3f& out) const {
+	const Level& level = levels[l];
+
+	// 1. Repeat 寻址 + 纹素中心对齐 (与 Texture 的双线性一致)
+	float x = (u - std::floor(u)) * level.width - 0.5f;
+	float y = (v - std::floor(v)) * level.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float tx = x - fx, ty = y - fy;
+
+	int x0 = (int)fx, y0 = (int)fy;
+	if (x0 < 0) x0 += level.width;
+	if (y0 < 0) y0 += level.height;
+	int x1 = x0 + 1 >= level.width ? 0 : x0 + 1;
+	int y1 = y0 + 1 >= level.height ? 0 : y0 + 1;
+
+	// 2. 查页表，4 个纹素可能落在最多 4 个不同的 Tile 上
+	const int xs[4] = { x0, x1, x0, x1 };
+	const int ys[4] = { y0, y0, y1, y1 };
+	const uint8_t* texel[4];
+	bool resident = true;
+	int mask = tile_size - 1;
+	for (int k = 0; k < 4; ++k) {
+		int tile = (ys[k] >> tile_shift) * level.tiles_x + (xs[k] >> tile_shift);
+		int slot = level.page[tile];
+		if (slot < 0) {
+			if (want) request(l, tile);
+			resident = false;
+			continue;
+		}
+		slots[slot].last_used = frame;
+		texel[k] = slot_texels.data() + (size_t)slot * tile_bytes
+			+ ((size_t)((ys[k] & mask) << tile_shift) + (xs[k] & mask)) * 3;
+	}
+	if (!resident) return false;
+
+	// 3. 双线性混合 (RGB8 -> float)
+	float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty);
+	float w01 = (1.0f - tx) * ty, w11 = tx * ty;
+	const float inv = 1.0f / 255.0f;
+	for (int c = 0; c < 3; ++c) {
+		out[c] = (texel[0][c] * w00 + texel[1][c] * w10 + texel[2][c] * w01 + texel[3][c] * w11) * inv;
+	}
+	return true;
+}
+
+float VirtualTexture::computeLod(float du_dx, float dv_dx, float du_dy, float dv_dy) const {
+	if (levels.empty()) return 0.0f;
+
+	float sx = (float)width, sy = (float)height;
+	float len_x = std::sqrt(du_dx * du_dx * sx * sx + dv_dx * dv_dx * sy * sy);
+	float len_y = std::sqrt(du_dy * du_dy * sx * sx + dv_dy * dv_dy * sy * sy);
+	float rho = std::max(len_x, len_y);
+	return rho > 1.0f ? std::log2(rho) : 0.0f;
+}
+
+void VirtualTexture::request(int level, int tile) const {
+	uint8_t& flag = levels[level].requested[tile];
+	if (flag) return;
+	flag = 1;
+	pending.push_back(((uint64_t)level << 32) | (uint32_t)tile);
+}
+
+// ==========================================
+// 换页
+// ==========================================
+int VirtualTexture::update(int max_uploads) {
+	// 粗的级别优先：一个粗 Tile 覆盖的屏幕面积更大，先到先改善更多像素
+	std::sort(pending.begin(), pending.end(), std::greater<uint64_t>());
+
+	int uploaded = 0;
+	for (uint64_t key : pending) {
+		int level = (int)(key >> 32);
+		int tile = (int)(key & 0xFFFFFFFFu);
+		// 清掉去重标记：这次没处理到的请求，下一帧采样时会重新发出
+		levels[level].requested[tile] = 0;
+
+		if (uploaded >= max_uploads || levels[level].page[tile] >= 0) continue;
+		int slot = acquire_slot();
+		if (slot < 0) continue; // 缓存里全是本帧用过的 Tile，容量不够，放弃剩余请求
+		load_tile(slot, level, tile);
+		uploaded++;
+	}
+	pending.clear();
+	frame++;
+	return uploaded;
+}
+
+int VirtualTexture::prefetch(int lod) {
+	if (levels.empty()) return 0;
+	int level = std::clamp(lod, 0, (int)levels.size() - 1);
+
+	int loaded = 0;
+	const Level& target = levels[level];
+	for (int tile = 0; tile < (int)target.page.size(); ++tile) {
+		if (target.page[tile] >= 0) continue;
+		int slot = acquire_slot();
+		if (slot < 0) break;
+		load_tile(slot, level, tile);
+		loaded++;
+	}
+	return loaded;
+}
+
+int VirtualTexture::acquire_slot() {
+	if (!free_slots.empty()) {
+		int slot = free_slots.back();
+		free_slots.pop_back();
+		return slot;
+	}
+
+	// LRU：找最久没用过、且不是本帧刚用过的槽位
+	int victim = -1;
+	uint64_t oldest = frame;
+	for (int i = 0; i < (int)slots.size(); ++i) {
+		const Slot& s = slots[i];
+		if (s.pinned || s.last_used >= oldest) continue;
+		oldest = s.last_used;
+		victim = i;
+	}
+	if (victim < 0) return -1;
+
+	Slot& s = slots[victim];
+	levels[s.level].page[s.tile] = -1;
+	s.level = -1;
+	s.tile = -1;
+	eviction_count++;
+	return victim;
+}
+
+void VirtualTexture::load_tile(int slot, int level, int tile) {
+	// 从映射区拷贝：这里才真正触发缺页读盘
+	const uint8_t* src = file.data() + levels[level].offset + (uint64_t)tile * tile_bytes;
+	std::memcpy(slot_texels.data() + (size_t)slot * tile_bytes, src, tile_bytes);
+
+	Slot& s = slots[slot];
+	s.level = level;
+	s.tile = tile;
+	s.last_used = frame;
+	levels[level].page[tile] = slot;
+	upload_count++;
+}
+
+VirtualTexture::Stats VirtualTexture::stats() const {
+	Stats s;
+	s.capacity = slots.size();
+	s.resident = slots.size() - free_slots.size();
+	s.uploads = upload_count;
+	s.evictions = eviction_count;
+	s.fallbacks = fallback_count;
+	s.pending = pending.size();
+	return s;
+}
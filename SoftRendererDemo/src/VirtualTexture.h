@@ -0,0 +1,112 @@
+﻿#pragma once
+#include "GMath.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ==========================================
+// 虚拟纹理 (Virtual Texture)
+// ==========================================
+// 面向 16k~64k 的超大纹理：普通 Texture 要把整张图以 float 放进内存，这里不需要。
+//
+// 1. 磁盘格式 (.vtex)：离线切好的 Tile，每级 Mip 单独切块，RGB8 存储
+//    [Header][MipDesc x mip_count][Tile 数据 ...]
+//    Tile 为 tile_size x tile_size，边缘不足的部分复制边缘纹素补齐
+// 2. 运行时整个文件用 MappedFile 映射，只有被拷进驻留缓存的 Tile 才真正读盘
+// 3. 页表 (Page Table)：每级 Mip 每个 Tile 一项，记录它在驻留缓存中的槽位 (-1 表示未驻留)
+// 4. 采样时目标 Tile 不在缓存：记录一次请求 (Feedback)，并退回到更粗的已驻留 Mip
+//    最粗一级只有一个 Tile，打开时就常驻，保证总能采到颜色
+// 5. 帧与帧之间调用 update()，按请求把 Tile 换入缓存，缓存满时按 LRU 淘汰
+//
+// 注意：sample() 会写请求标记和 LRU 时间戳，没有加锁，只能在单线程里采样。
+class VirtualTexture {
+public:
+	struct Stats {
+		size_t resident = 0;   // 当前驻留的 Tile 数
+		size_t capacity = 0;   // 缓存槽位总数
+		size_t uploads = 0;    // 累计换入的 Tile 数
+		size_t evictions = 0;  // 累计被淘汰的 Tile 数
+		size_t fallbacks = 0;  // 累计退回粗 Mip 的采样次数
+		size_t pending = 0;    // 等待下一次 update() 处理的请求数
+	};
+
+	VirtualTexture() = default;
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// 离线构建：把一张图片切成 .vtex (带完整 Mip 链)
+	// tile_size 必须是 2 的幂 (>= 8)
+	// 注意：构建时源图片仍需一次性解码到内存 (RGB8)，真正巨大的源图应由外部工具分块生成同样的格式
+	static bool build(const std::string& image_path, const std::string& out_path,
+		int tile_size = 128, bool flip_vertically = true);
+
+	// 打开 .vtex，cache_tiles 为驻留缓存能容纳的 Tile 数 (至少会保留 2 个)
+	bool open(const std::string& path, size_t cache_tiles = 256);
+	void close();
+	bool is_open() const { return file.is_open(); }
+
+	// 双线性采样 (Repeat 寻址)，lod 选择 Mip 级别 (四舍五入到最近一级)
+	Vec3f sample(float u, float v, float lod = 0.0f) const;
+
+	// 与 Texture::computeLod 相同：由 UV 的屏幕空间导数估算 LOD
+	float computeLod(float du_dx, float dv_dx, float du_dy, float dv_dy) const;
+
+	// 处理采样期间积累的请求，最多换入 max_uploads 个 Tile，返回实际换入数
+	// 在两帧之间调用；同时推进 LRU 的帧计数
+	int update(int max_uploads = 64);
+
+	// 立即换入覆盖 [lod] 级整张图的 Tile (预热/离线渲染用)，受缓存容量限制
+	int prefetch(int lod);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getTileSize() const { return tile_size; }
+	int getMipCount() const { return (int)levels.size(); }
+	Stats stats() const;
+
+	// 文件格式
+	static const uint32_t MAGIC = 0x54565253; // "SRVT"
+	static const uint32_t VERSION = 1;
+
+private:
+	struct Level {
+		int width = 0, height = 0;
+		int tiles_x = 0, tiles_y = 0;
+		uint64_t offset = 0;              // 第一个 Tile 在文件中的偏移
+		std::vector<int32_t> page;        // 页表：Tile -> 槽位
+		mutable std::vector<uint8_t> requested; // 本帧是否已经发出过请求 (去重)
+	};
+
+	struct Slot {
+		int level = -1;
+		int tile = -1;
+		bool pinned = false;
+		mutable uint64_t last_used = 0;
+	};
+
+	// 在第 l 级做双线性采样；有纹素所在 Tile 未驻留时返回 false 并记录请求
+	bool sample_level(int l, float u, float v, bool request, Vec3f& out) const;
+
+	// 把 (level, tile) 拷进槽位 slot，更新页表
+	void load_tile(int slot, int level, int tile);
+	// 选一个可以放新 Tile 的槽位 (空闲优先，否则 LRU)；没有可用槽位返回 -1
+	int acquire_slot();
+	void request(int level, int tile) const;
+
+	MappedFile file;
+	int width = 0, height = 0;
+	int tile_size = 0, tile_shift = 0;
+	size_t tile_bytes = 0;
+
+	std::vector<Level> levels;
+	std::vector<Slot> slots;
+	std::vector<uint8_t> slot_texels; // 所有槽位的 RGB8 数据连续存放
+	std::vector<int> free_slots;
+
+	mutable std::vector<uint64_t> pending; // (level << 32) | tile
+	mutable uint64_t frame = 1;
+	mutable size_t fallback_count = 0;
+	size_t upload_count = 0;
+	size_t eviction_count = 0;
+};
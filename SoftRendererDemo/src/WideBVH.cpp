@@ -0,0 +1,133 @@
+﻿#include "WideBVH.h"
+#include "ThreadPool.h"
+#include <limits>
+
+template <int Width>
+WideBVH<Width>::WideBVH(const LinearBVH& binary)
+	: primitives(binary.get_primitives()) {
+	if (binary.node_count() == 0) return;
+	nodes.reserve(binary.node_count() / 2 + 1);
+	source.reserve((binary.node_count() / 2 + 1) * Width);
+	collapse(binary, 0);
+}
+
+template <int Width>
+void WideBVH<Width>::set_slot(int node, int slot, const LinearBVH::Node& source_node) {
+	Node& n = nodes[node];
+	n.bounds[0][0][slot] = source_node.min.x;
+	n.bounds[1][0][slot] = source_node.min.y;
+	n.bounds[2][0][slot] = source_node.min.z;
+	n.bounds[0][1][slot] = source_node.max.x;
+	n.bounds[1][1][slot] = source_node.max.y;
+	n.bounds[2][1][slot] = source_node.max.z;
+}
+
+// ==========================================
+// 收缩：二叉节点 -> Width 叉节点
+// ==========================================
+// 从二叉节点的两个孩子开始，反复把表面积最大的内部孩子换成它的两个孩子，直到凑满 Width 个
+// (或者剩下的全是叶子)。表面积大的盒子被光线击中的概率高，先展开它能让一次 SIMD 测试剔除更多。
+template <int Width>
+int WideBVH<Width>::collapse(const LinearBVH& binary, int binary_index) {
+	const std::vector<LinearBVH::Node>& bin = binary.get_nodes();
+
+	int children[Width];
+	int child_count = 0;
+	if (bin[binary_index].count > 0) {
+		children[child_count++] = binary_index; // 整棵树只有一个叶子
+	}
+	else {
+		children[child_count++] = binary_index + 1;
+		children[child_count++] = bin[binary_index].offset;
+	}
+	while (child_count < Width) {
+		int best = -1;
+		float best_area = -1.0f;
+		for (int i = 0; i < child_count; ++i) {
+			const LinearBVH::Node& c = bin[children[i]];
+			if (c.count > 0) continue;
+			float area = AABB(c.min, c.max).surface_area();
+			if (area > best_area) {
+				best_area = area;
+				best = i;
+			}
+		}
+		if (best < 0) break;
+		const int opened = children[best];
+		children[best] = opened + 1;
+		children[child_count++] = bin[opened].offset;
+	}
+
+	const int index = (int)nodes.size();
+	nodes.emplace_back();
+	source.resize(source.size() + Width, -1);
+
+	const float inf = std::numeric_limits<float>::infinity();
+	for (int i = 0; i < Width; ++i) {
+		for (int a = 0; a < 3; ++a) {
+			nodes[index].bounds[a][0][i] = inf;
+			nodes[index].bounds[a][1][i] = -inf;
+		}
+		nodes[index].child[i] = 0;
+		nodes[index].count[i] = 0;
+	}
+
+	for (int i = 0; i < child_count; ++i) {
+		const LinearBVH::Node& c = bin[children[i]];
+		set_slot(index, i, c);
+		source[(size_t)index * Width + i] = children[i];
+		if (c.count > 0) {
+			nodes[index].child[i] = c.offset;
+			nodes[index].count[i] = c.count;
+		}
+		else {
+			// 递归会让 nodes 扩容，先算出下标再写回
+			const int child_index = collapse(binary, children[i]);
+			nodes[index].child[i] = child_index;
+		}
+	}
+	return index;
+}
+
+template <int Width>
+void WideBVH<Width>::refit(const LinearBVH& binary) {
+	const std::vector<LinearBVH::Node>& bin = binary.get_nodes();
+	ThreadPool::instance().parallel_for(nodes.size(), 0, [&](size_t b, size_t e) {
+		for (size_t n = b; n < e; ++n) {
+			for (int i = 0; i < Width; ++i) {
+				const int32_t s = source[n * Width + i];
+				if (s >= 0) set_slot((int)n, i, bin[s]);
+			}
+		}
+	});
+}
+
+template <int Width>
+bool WideBVH<Width>::intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const {
+	return traverse(r, tmin, tmax, [&](size_t first, size_t count, float t_min, float& t_max) {
+		bool hit = false;
+		for (size_t i = first; i < first + count; ++i) {
+			if (primitives[i]->intersect(r, t_min, t_max, rec)) {
+				hit = true;
+				t_max = rec.t;
+			}
+		}
+		return hit;
+	});
+}
+
+template <int Width>
+AABB WideBVH<Width>::get_bounding_box() const {
+	AABB box;
+	if (nodes.empty()) return box;
+	const Node& root = nodes[0];
+	for (int i = 0; i < Width; ++i) {
+		if (root.bounds[0][0][i] > root.bounds[0][1][i]) continue; // 空槽
+		box.expand(Vec3f(root.bounds[0][0][i], root.bounds[1][0][i], root.bounds[2][0][i]));
+		box.expand(Vec3f(root.bounds[0][1][i], root.bounds[1][1][i], root.bounds[2][1][i]));
+	}
+	return box;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,199 @@
+﻿#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include "LinearBVH.h"
+
+// 4 路只需要 SSE (min/max/cmp/movemask)，x64 默认就有；8 路需要 AVX
+#if defined(__AVX__)
+#define SR_BVH_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(__AVX__)
+#define SR_BVH_SSE
+#include <immintrin.h>
+#endif
+
+// ========================================================================
+// 宽 BVH (BVH4 / BVH8)
+// ========================================================================
+// 由二叉的 LinearBVH 收缩而来：每个节点直接挂 Width 个孩子，孩子的包围盒按分量拆成 SoA
+// (bounds[轴][min/max][孩子])，一次 SSE (4 路) / AVX (8 路) slab 测试就能算出所有孩子的进入距离。
+// 命中的孩子按距离排序压栈，最近的先访问；出栈时进入距离已经超过 tmax 的直接丢弃。
+// 叶子沿用 LinearBVH 的图元顺序，所以按二叉树顺序排好的旁路数据可以直接复用。
+template <int Width>
+class WideBVH : public Object {
+public:
+	static_assert(Width == 4 || Width == 8, "WideBVH supports 4 or 8 children per node");
+	static constexpr int WIDTH = Width;
+
+	struct Node {
+		float bounds[3][2][Width]; // [轴][0 = min, 1 = max][孩子]；空槽为 +inf / -inf，永远不会命中
+		int32_t child[Width];      // 内部孩子：节点下标；叶子：第一个图元的下标
+		uint16_t count[Width];     // 叶子的图元数，0 表示内部孩子 (或空槽)
+	};
+
+	// 收缩一棵二叉 BVH (图元指针一并复制；只按包围盒建的二叉树没有图元，叶子顺序看 binary.get_order())
+	explicit WideBVH(const LinearBVH& binary);
+	WideBVH() = default;
+
+	virtual bool intersect(const Ray& r, float tmin, float tmax, HitRecord& rec) const override;
+	virtual AABB get_bounding_box() const override;
+
+	// 与 LinearBVH::traverse 相同的叶子回调：leaf_test(first, count, tmin, tmax)
+	template <typename LeafTest>
+	bool traverse(const Ray& r, float tmin, float tmax, LeafTest&& leaf_test) const;
+
+	// 二叉树 refit 之后调用：拓扑不变，每个孩子槽直接取它对应的二叉节点的包围盒
+	void refit(const LinearBVH& binary);
+
+	const std::vector<Node>& get_nodes() const { return nodes; }
+	size_t node_count() const { return nodes.size(); }
+	size_t memory_bytes() const { return nodes.capacity() * sizeof(Node) + source.capacity() * sizeof(int32_t); }
+
+	// 每条光线只算一次的量：进入 / 离开平面在 bounds 里的下标 (按方向符号选 min 或 max)
+	struct RayInfo {
+		float orig[3];
+		float inv_dir[3];
+		int near_side[3];
+	};
+
+	// 所有孩子的 slab 测试：返回命中掩码 (第 i 位对应孩子 i)，tnear 写入进入距离
+	static unsigned intersect_children(const Node& node, const RayInfo& ray, float tmin, float tmax, float* tnear);
+
+private:
+	int collapse(const LinearBVH& binary, int binary_index);
+	void set_slot(int node, int slot, const LinearBVH::Node& source_node);
+
+	std::vector<Node> nodes;          // nodes[0] 是根
+	std::vector<int32_t> source;      // 孩子槽 -> 二叉节点下标 (nodes[n] 的第 i 个槽在 source[n * Width + i])，refit 用
+	std::vector<Object*> primitives;  // 与二叉树相同的叶子顺序
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+// 当前编译目标上最合适的宽度：有 AVX 用 8 路，否则 4 路
+#if defined(SR_BVH_AVX)
+using DefaultWideBVH = BVH8;
+#else
+using DefaultWideBVH = BVH4;
+#endif
+
+template <int Width>
+inline unsigned WideBVH<Width>::intersect_children(const Node& node, const RayInfo& ray, float tmin, float tmax, float* tnear) {
+	const int nx = ray.near_side[0], ny = ray.near_side[1], nz = ray.near_side[2];
+	// t = (平面 - 起点) * inv_dir，max / min 的第一个参数放 t：0 * inf 得到 NaN 时取第二个参数，
+	// 与 LinearBVH::slab_test 里 std::max / std::min 忽略 NaN 的行为一致
+#if defined(SR_BVH_AVX)
+	if constexpr (Width == 8) {
+		const __m256 ox = _mm256_set1_ps(ray.orig[0]), oy = _mm256_set1_ps(ray.orig[1]), oz = _mm256_set1_ps(ray.orig[2]);
+		const __m256 ix = _mm256_set1_ps(ray.inv_dir[0]), iy = _mm256_set1_ps(ray.inv_dir[1]), iz = _mm256_set1_ps(ray.inv_dir[2]);
+		__m256 t_near = _mm256_set1_ps(tmin);
+		__m256 t_far = _mm256_set1_ps(tmax);
+		t_near = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[0][nx]), ox), ix), t_near);
+		t_far = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[0][1 - nx]), ox), ix), t_far);
+		t_near = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[1][ny]), oy), iy), t_near);
+		t_far = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[1][1 - ny]), oy), iy), t_far);
+		t_near = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[2][nz]), oz), iz), t_near);
+		t_far = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[2][1 - nz]), oz), iz), t_far);
+		_mm256_storeu_ps(tnear, t_near);
+		return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ));
+	}
+#endif
+#if defined(SR_BVH_SSE)
+	if constexpr (Width == 4) {
+		const __m128 ox = _mm_set1_ps(ray.orig[0]), oy = _mm_set1_ps(ray.orig[1]), oz = _mm_set1_ps(ray.orig[2]);
+		const __m128 ix = _mm_set1_ps(ray.inv_dir[0]), iy = _mm_set1_ps(ray.inv_dir[1]), iz = _mm_set1_ps(ray.inv_dir[2]);
+		__m128 t_near = _mm_set1_ps(tmin);
+		__m128 t_far = _mm_set1_ps(tmax);
+		t_near = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[0][nx]), ox), ix), t_near);
+		t_far = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[0][1 - nx]), ox), ix), t_far);
+		t_near = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1][ny]), oy), iy), t_near);
+		t_far = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1][1 - ny]), oy), iy), t_far);
+		t_near = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[2][nz]), oz), iz), t_near);
+		t_far = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[2][1 - nz]), oz), iz), t_far);
+		_mm_storeu_ps(tnear, t_near);
+		return (unsigned)_mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+	}
+#endif
+	// 标量回退 (不支持对应宽度 SIMD 的平台)
+	unsigned mask = 0;
+	for (int i = 0; i < Width; ++i) {
+		float t0 = tmin, t1 = tmax;
+		for (int a = 0; a < 3; ++a) {
+			float n = (node.bounds[a][ray.near_side[a]][i] - ray.orig[a]) * ray.inv_dir[a];
+			float f = (node.bounds[a][1 - ray.near_side[a]][i] - ray.orig[a]) * ray.inv_dir[a];
+			t0 = std::max(t0, n);
+			t1 = std::min(t1, f);
+		}
+		tnear[i] = t0;
+		if (t0 <= t1) mask |= 1u << i;
+	}
+	return mask;
+}
+
+template <int Width>
+template <typename LeafTest>
+bool WideBVH<Width>::traverse(const Ray& r, float tmin, float tmax, LeafTest&& leaf_test) const {
+	if (nodes.empty()) return false;
+
+	RayInfo ray;
+	ray.orig[0] = r.orig.x; ray.orig[1] = r.orig.y; ray.orig[2] = r.orig.z;
+	ray.inv_dir[0] = r.invDir.x; ray.inv_dir[1] = r.invDir.y; ray.inv_dir[2] = r.invDir.z;
+	for (int a = 0; a < 3; ++a) ray.near_side[a] = ray.inv_dir[a] < 0.0f ? 1 : 0;
+
+	// 栈里放孩子槽本身 (节点下标或叶子区间) 和它的进入距离；
+	// 二叉树深度不超过 BVHNode::MAX_DEPTH (构建时保证)，收缩后层数只会更少，每层最多多压 Width - 1 个
+	struct Entry {
+		int32_t index;
+		uint32_t count;
+		float t;
+	};
+	Entry stack[BVHNode::MAX_DEPTH * (Width - 1) + 1];
+	int top = 0;
+	Entry current = { 0, 0, tmin };
+	bool hit = false;
+	alignas(32) float tnear[Width];
+
+	while (true) {
+		if (current.count > 0) {
+			if (leaf_test((size_t)current.index, (size_t)current.count, tmin, tmax)) hit = true;
+		}
+		else {
+			const Node& node = nodes[current.index];
+			unsigned mask = intersect_children(node, ray, tmin, tmax, tnear);
+			if (mask) {
+				int i = std::countr_zero(mask);
+				mask &= mask - 1;
+				if (!mask) {
+					// 只命中一个孩子 (最常见)：不进栈，直接下去
+					current = { node.child[i], node.count[i], tnear[i] };
+					continue;
+				}
+				// 插入排序：[first, top) 按距离从远到近，最近的在栈顶
+				const int first = top;
+				while (true) {
+					const Entry e = { node.child[i], node.count[i], tnear[i] };
+					int j = top++;
+					while (j > first && stack[j - 1].t < e.t) {
+						stack[j] = stack[j - 1];
+						--j;
+					}
+					stack[j] = e;
+					if (!mask) break;
+					i = std::countr_zero(mask);
+					mask &= mask - 1;
+				}
+			}
+		}
+
+		// 出栈，跳过进入距离已经超过 tmax 的 (压栈之后 tmax 又收紧了)
+		do {
+			if (top == 0) return hit;
+			current = stack[--top];
+		} while (current.t > tmax);
+	}
+}
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
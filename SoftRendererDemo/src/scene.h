@@ -1,9 +1,16 @@
 ﻿#pragma once
+#include <chrono>
 #include <vector>
 #include "Object.h"
 #include "BVH.h"
+#include "LinearBVH.h"
+#include "WideBVH.h"
 #include "Model.h"
 #include "Primitives.h"
+#include "BezierPatch.h"
+#include "TriangleMesh.h"
+#include "QuantizedMesh.h"
+#include "MeshStream.h"
 
 //管理物体的生命周期和 BVH
 class Scene {
@@ -11,7 +18,7 @@ public:
 	~Scene() {
 		// 简单的内存清理，或者使用智能指针
 		for (auto obj : objects) delete obj;
-		if (bvh_root) delete bvh_root;
+		delete bvh_root;
 	}
 
 	void add_object(Object* obj) {
@@ -19,40 +26,100 @@ public:
 		dirty = true; // 标记需要重建 BVH
 	}
 
-	// 将 Model 转换并加入场景
+	// 将 Model 加入场景：整个网格是一个 TriangleMesh，直接引用 Model 的顶点和索引 (Model 必须比 Scene 活得久)
 	void add_model(const Model& model) {
-		const Mesh& mesh = model.get_mesh();
-		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
-			int idx0 = mesh.indices[i];
-			int idx1 = mesh.indices[i + 1];
-			int idx2 = mesh.indices[i + 2];
-
-			Vec3f v0 = mesh.positions[idx0];
-			Vec3f v1 = mesh.positions[idx1];
-			Vec3f v2 = mesh.positions[idx2];
-
-			// 这里可以把法线也传进去，如果你的 Triangle 支持的话
-			add_object(new Triangle(v0, v1, v2));
-		}
+		if (!model.get_mesh().indices.empty()) add_object(new TriangleMesh(model.get_mesh()));
+	}
+
+	// 接管一份 Mesh (例如程序生成的几何)
+	void add_mesh(Mesh&& mesh) {
+		if (!mesh.indices.empty()) add_object(new TriangleMesh(std::move(mesh)));
+	}
+
+	// Bezier 曲面片：每个曲面片一个物体，直接求交，不细分
+	void add_patches(const std::vector<CubicPatch>& patches) {
+		for (const CubicPatch& p : patches) add_object(new BezierPatch(p));
+	}
+
+	// 压缩 Mesh：TriangleMesh 直接引用压缩顶点 (建树时解码位置，击中时解码法线 / UV)，Mesh 必须比 Scene 活得久
+	void add_quantized_mesh(const QuantizedMesh& mesh) {
+		if (!mesh.indices.empty()) add_object(new TriangleMesh(mesh));
+	}
+
+	// 接管一份压缩 Mesh
+	void add_quantized_mesh(QuantizedMesh&& mesh) {
+		if (!mesh.indices.empty()) add_object(new TriangleMesh(std::move(mesh)));
+	}
+
+	// 流式加入 (分块 BVH)：每块是一个自带 BVH 的 TriangleMesh，build() 再在这些块之上建顶层 BVH。
+	// 注意这不是 Out-of-core 追踪：每块都被 Scene 接管并常驻 (顶点 + 块内 BVH + 求交数据)，
+	// 最终整份网格都在内存里。流式读取只限制了加载过程中的峰值 (不会先拼出一份完整 Mesh 再复制)；
+	// 真正按预算常驻的只有光栅化那条 读取 -> 绘制 -> 丢弃 的路径。
+	void add_stream(MeshStream& stream) {
+		Mesh chunk;
+		while (stream.next(chunk)) add_mesh(std::move(chunk));
+	}
+
+	// 物体被移动 / 变形 (数量不变，例如改了 Sphere::center、Triangle 的顶点，或 TriangleMesh 改完顶点后 refit 过) 后调用，
+	// 下次 build 只重新拟合包围盒，不重建
+	void mark_moved() {
+		moved = true;
 	}
 
-	void build() {
+	enum class BuildKind { None, Full, Refit };
+
+	// 重新拟合后 SAH 代价超过上次完整构建时的这个倍数，就改为完整重建 (物体走得太远，树的质量已经变差)
+	float rebuild_cost_ratio = 1.5f;
+
+	// 有新物体：完整构建 (默认 Auto：图元很多时改用并行 HLBVH)
+	// 只有移动：重新拟合，代价退化太多再完整重建
+	void build(const BVHNode::Settings& settings = BVHNode::Settings(), LinearBVH::Builder builder = LinearBVH::Builder::Auto) {
+		auto t0 = std::chrono::high_resolution_clock::now();
+		last_build_kind = BuildKind::None;
 		if (dirty && !objects.empty()) {
-			// 注意：BVHNode 构造函数会重排 objects 向量，所以不要存外部索引
-			bvh_root = new BVHNode(objects);
-			dirty = false;
+			rebuild(settings, builder);
 		}
+		else if (moved && bvh_root) {
+			last_build_kind = BuildKind::Refit;
+			if (bvh_root->refit() > built_cost * rebuild_cost_ratio) rebuild(settings, builder);
+			else wide_root.refit(*bvh_root);
+		}
+		moved = false;
+		last_build_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
 	}
 
+	// 最近一次 build 做了什么、耗时多少 (秒)，与 RayTracer 的追踪时间分开统计
+	BuildKind build_kind() const { return last_build_kind; }
+	double build_seconds() const { return last_build_seconds; }
+
 	// 场景求交入口
 	bool intersect(const Ray& r, HitRecord& rec) const {
 		if (!bvh_root) return false;
-		// tmin 设为 0.001 防止自我遮挡
-		return bvh_root->intersect(r, 0.001f, std::numeric_limits<float>::max(), rec);
+		// tmin 设为 0.001 防止自我遮挡；遍历走收缩后的宽 BVH
+		return wide_root.intersect(r, 0.001f, std::numeric_limits<float>::max(), rec);
 	}
 
+	const LinearBVH* bvh() const { return bvh_root; }
+	const DefaultWideBVH& wide_bvh() const { return wide_root; }
+	const std::vector<Object*>& get_objects() const { return objects; }
+
 private:
+	void rebuild(const BVHNode::Settings& settings, LinearBVH::Builder builder) {
+		// 注意：构建会重排 objects 向量，所以不要存外部索引
+		delete bvh_root;
+		bvh_root = new LinearBVH(objects, settings, builder);
+		built_cost = bvh_root->sah_cost();
+		wide_root = DefaultWideBVH(*bvh_root);
+		dirty = false;
+		last_build_kind = BuildKind::Full;
+	}
+
 	std::vector<Object*> objects; // 所有的原始物体
-	Object* bvh_root = nullptr;   // 加速结构根节点
+	LinearBVH* bvh_root = nullptr; // 加速结构 (扁平数组)，负责构建和 refit
+	DefaultWideBVH wide_root;      // 由 bvh_root 收缩的 BVH4 / BVH8，求交用
 	bool dirty = false;
+	bool moved = false;
+	float built_cost = 0.0f;       // 上次完整构建后的 SAH 代价
+	BuildKind last_build_kind = BuildKind::None;
+	double last_build_seconds = 0.0;
 };
\ No newline at end of file